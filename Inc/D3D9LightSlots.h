@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Engine.h"
+
+#include "remixapi/bridge_remix_api.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Keeps each light actor in the same slot while it stays in the light list, so only changes are sent
+class LightSlots {
+public:
+	// Light actor properties that go into its D3D light
+	struct LightState {
+		FVector location;
+		BYTE brightness;
+		BYTE hue;
+		BYTE saturation;
+		BYTE radius;
+		BYTE effect;
+		BYTE type;
+		// Brightness multiplier and extra range of a merged cluster, 1 and 0 for a single light
+		FLOAT clusterScale;
+		FLOAT clusterExtent;
+
+		inline bool operator==(const LightState& other) const {
+			return location == other.location &&
+				brightness == other.brightness &&
+				hue == other.hue &&
+				saturation == other.saturation &&
+				radius == other.radius &&
+				effect == other.effect &&
+				type == other.type &&
+				clusterScale == other.clusterScale &&
+				clusterExtent == other.clusterExtent;
+		}
+		inline bool operator!=(const LightState& other) const {
+			return !(*this == other);
+		}
+	};
+
+	struct Slot {
+		AActor* actor;
+		// Last update the actor was in the light list
+		DWORD generation;
+		// What was last sent with SetLight, only meaningful if submitted is set
+		LightState state;
+		bool submitted;
+		bool enabled;
+		// Only used by the Remix API light path
+		remixapi_LightHandle remixHandle;
+	};
+
+private:
+	std::unordered_map<AActor*, int> actorSlots;
+	// Created on first use, up to maxSlots
+	std::vector<Slot> slots;
+	std::vector<int> freeSlots;
+	std::vector<int> usedSlots;
+	std::vector<int> releasedSlots;
+	std::vector<AActor*> newActors;
+	size_t maxSlots;
+	DWORD generation;
+
+	// Destroys the Remix light handles of the slots that were emptied by the last update
+	void destroyFreedRemixLights(const remixapi_Interface& remix);
+	// Whether the slot needs a new Remix light for the state, Remix lights can't be changed so a change means a new handle
+	bool needsNewRemixLight(const Slot& slotInfo, const LightState& state) const;
+	// Replaces the slot's Remix light with a new one for the state, the handle is left null if it can't be created
+	remixapi_ErrorCode replaceRemixLight(const remixapi_Interface& remix, Slot& slotInfo, const LightState& state, const remixapi_LightInfo& lightInfo);
+
+public:
+	LightSlots(DWORD numSlots) {
+		maxSlots = numSlots;
+		generation = 0;
+		actorSlots.reserve(Min(numSlots, 1024U));
+	}
+
+	// Updates which actors are in the slots, in time linear in the number of lights
+	void updateActors(const std::vector<AActor*>& actors);
+
+	// Slots that lost their actor in the last update, a slot given to a new actor in the same update is also listed
+	const std::vector<int>& freedSlots() const {
+		return releasedSlots;
+	}
+
+	// Slots with an actor, in no particular order
+	const std::vector<int>& activeSlots() const {
+		return usedSlots;
+	}
+
+	Slot& getSlot(int slot) {
+		return slots[slot];
+	}
+
+	bool hasActor(AActor* actor) const {
+		return actorSlots.count(actor) != 0;
+	}
+
+	size_t capacity() const {
+		return maxSlots;
+	}
+
+	// Makes every light get sent again, for when something outside the light actors changes
+	void invalidate() {
+		for (Slot& slot : slots) {
+			slot.submitted = false;
+		}
+	}
+
+	// Sends this frame's lights through the Remix API after updateActors, the handles of lights that are gone are destroyed
+	// getState returns an actor's current state, makeInfo fills in the sphere light of an actor whose light has to be created
+	// Returns the first error from creating a light, lights that couldn't be created are not drawn and are tried again next frame
+	template<class StateFunc, class InfoFunc>
+	remixapi_ErrorCode submitRemixLights(const remixapi_Interface& remix, StateFunc getState, InfoFunc makeInfo) {
+		destroyFreedRemixLights(remix);
+
+		remixapi_ErrorCode firstErr = REMIXAPI_ERROR_CODE_SUCCESS;
+		for (int slot : usedSlots) {
+			Slot& slotInfo = slots[slot];
+			const LightState state = getState(slotInfo.actor);
+
+			if (needsNewRemixLight(slotInfo, state)) {
+				remixapi_LightInfoSphereEXT sphereInfo = {};
+				sphereInfo.sType = REMIXAPI_STRUCT_TYPE_LIGHT_INFO_SPHERE_EXT;
+				remixapi_LightInfo lightInfo = {};
+				lightInfo.sType = REMIXAPI_STRUCT_TYPE_LIGHT_INFO;
+				lightInfo.pNext = &sphereInfo;
+				makeInfo(slotInfo.actor, state, sphereInfo, lightInfo);
+
+				remixapi_ErrorCode remixErr = replaceRemixLight(remix, slotInfo, state, lightInfo);
+				if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+					if (firstErr == REMIXAPI_ERROR_CODE_SUCCESS) {
+						firstErr = remixErr;
+					}
+					continue;
+				}
+			}
+
+			// Lights have to be drawn every frame to stay in the scene
+			remix.DrawLightInstance(slotInfo.remixHandle);
+		}
+		return firstErr;
+	}
+
+	// Empties every slot and destroys all the Remix light handles
+	void destroyRemixLights(const remixapi_Interface& remix);
+};
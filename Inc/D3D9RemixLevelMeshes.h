@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Engine.h"
+
+#include "remixapi/bridge_remix_api.h"
+
+#include <array>
+#include <vector>
+
+// How a texture is drawn, each gets its own Remix API material
+enum RemixMaterialClass {
+	REMIX_MATERIAL_OPAQUE,
+	REMIX_MATERIAL_MASKED,
+	REMIX_MATERIAL_TRANSLUCENT,
+	REMIX_MATERIAL_MODULATED,
+	REMIX_MATERIAL_UNLIT,
+	REMIX_MATERIAL_CLASS_MAX
+};
+
+// Level buckets registered once as static Remix API meshes, then drawn as instances of each visible zone every frame
+class RemixLevelMeshes {
+public:
+	// A registered bucket, and the material it holds
+	struct LevelMesh {
+		remixapi_MeshHandle mesh;
+		QWORD materialCacheID;
+		RemixMaterialClass materialClass;
+	};
+
+private:
+	std::array<std::vector<LevelMesh>, FBspNode::MAX_ZONES> zoneMeshes;
+
+public:
+	// Registers a bucket's triangles with its material, the mesh is only kept if Remix created it
+	remixapi_ErrorCode add(
+		const remixapi_Interface& remix,
+		BYTE zone,
+		QWORD hash,
+		const std::vector<remixapi_HardcodedVertex>& vertices,
+		const std::vector<uint32_t>& indices,
+		remixapi_MaterialHandle material,
+		QWORD materialCacheID,
+		RemixMaterialClass materialClass
+	);
+
+	bool empty(BYTE zone) const {
+		return zoneMeshes[zone].empty();
+	}
+
+	const std::vector<LevelMesh>& getMeshes(BYTE zone) const {
+		return zoneMeshes[zone];
+	}
+
+	// Draws an instance of each mesh registered for the zone
+	void draw(const remixapi_Interface& remix, BYTE zone) const;
+
+	// Destroys every mesh, then hands each one's material to releaseMaterial as the mesh no longer holds it
+	template<class ReleaseFunc>
+	void destroyAll(const remixapi_Interface& remix, ReleaseFunc releaseMaterial) {
+		for (std::vector<LevelMesh>& meshes : zoneMeshes) {
+			for (LevelMesh& levelMesh : meshes) {
+				remix.DestroyMesh(levelMesh.mesh);
+				releaseMaterial(levelMesh.materialCacheID, levelMesh.materialClass);
+			}
+			meshes.clear();
+		}
+	}
+};
@@ -49,6 +49,8 @@ private:
 	};
 	struct ModelFacets {
 		std::array<std::array<SurfKeyBucketVector<UTexture*, SurfaceData>, RPASS_MAX>, FBspNode::MAX_ZONES> facetPairs;
+		// Buckets registered as Remix API meshes, drawn by instancing their zone instead of through D3D
+		std::array<std::array<std::vector<bool>, RPASS_MAX>, FBspNode::MAX_ZONES> remixMeshBuckets;
 	};
 	static struct {
 		ULevel* currentLevel;
@@ -62,16 +64,24 @@ private:
 		std::vector<AActor*> actors;
 		std::vector<ABrush*> movers;
 		std::vector<AActor*> lights;
+		// Set for each light that can reach what any frame drawn this tick sees
+		std::vector<bool> lightVisible;
+		// Zones seen by any frame drawn this tick, including the sky box
+		QWORD visibleZones = 0;
 	};
 	struct ParentCoord {
 		FCoords worldCoord;
 		FCoords localCoord;
 	};
 	typedef SurfKeyBucketVector<FTextureInfo*, std::vector<FTransTexture>> DecalMap;
-	void onLevelChange(FSceneNode* frame);
+	void onLevelChange(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev);
+	// Registers the static buckets of every zone as Remix API meshes
+	void createRemixLevelMeshes(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, ModelFacets& modelFacets);
 	void getLevelModelFacets(FSceneNode* frame, ModelFacets& modelFacets);
+	void getLevelPrecacheTextures(FSceneNode* frame, const ModelFacets& modelFacets, std::vector<UD3D9RenderDevice::TexPrecacheEntry>& entries);
 	void drawActorSwitch(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, AActor* actor, RenderList& renderList, ParentCoord* parentCoord = nullptr);
 	void drawPawnExtras(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, APawn* pawn, RenderList& renderList, SpecialCoord& specialCoord);
+	void cullLights(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, FrameActors& objs, QWORD visibleZoneMask);
 	void getSurfaceDecals(FSceneNode* frame, const SurfaceData& surfaceData, DecalMap& decals, std::unordered_map<UTexture*, FTextureInfo>& lockedTextures);
 	void drawFrame(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, ModelFacets& modelFacets, FrameActors& objs, std::unordered_map<UTexture*, FTextureInfo>& lockedTextures, bool isSky = false);
 #if RUNE
@@ -21,6 +21,8 @@
 
 #include "D3D9DebugUtils.h"
 #include "RTXLevelProperties.h"
+#include "D3D9LightSlots.h"
+#include "D3D9RemixLevelMeshes.h"
 
 #include "remixapi/bridge_remix_api.h"
 
@@ -33,6 +35,10 @@
 #include <map>
 #include <deque>
 #include <vector>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "c_gclip.h"
 
@@ -81,7 +87,12 @@ typedef IDirect3D9 * (WINAPI * LPDIRECT3DCREATE9)(UINT SDKVersion);
 //#define UTGLR_DEBUG_ACTOR_WIREFRAME
 
 
-#include "c_rbtree.h"
+#include "c_ddsfile.h"
+#include "c_hashmap.h"
+#include "c_slaballoc.h"
+#include "c_texshare.h"
+#include "c_texconv.h"
+#include "c_texdiskcache.h"
 
 
 /*-----------------------------------------------------------------------------
@@ -93,6 +104,7 @@ typedef IDirect3D9 * (WINAPI * LPDIRECT3DCREATE9)(UINT SDKVersion);
 
 //Must be at least 2000
 #define VERTEX_BUFFER_SIZE	1000	// permanent small draw call buffer
+#define INDEX_BUFFER_SIZE	3000	// permanent small indexed draw call buffer
 
 
 /*-----------------------------------------------------------------------------
@@ -139,8 +151,23 @@ constexpr tex_params_t CT_DEFAULT_TEX_PARAMS = { CT_DEFAULT_TEX_FILTER_PARAMS, 0
 
 constexpr BYTE DT_NO_SMOOTH_BIT = 0x01;
 
+struct FCachedTexture;
+struct FTexConvertJob;
+struct FTexRealtimeShadow;
+
+struct FTexConvertCtx {
+	INT stepBits;
+	DWORD texWidthPow2;
+	DWORD texHeightPow2;
+	const FCachedTexture* pBind;
+	D3DLOCKED_RECT lockRect;
+};
+
 struct FCachedTexture {
+	QWORD CacheID;
 	IDirect3DTexture9 *pTexObj;
+	//Bytes held by pTexObj across all levels
+	DWORD texBytes;
 	DWORD LastUsedFrameCount;
 	BYTE BaseMip;
 	BYTE MaxLevel;
@@ -149,7 +176,6 @@ struct FCachedTexture {
 	FLOAT UMult, VMult;
 	BYTE texType;
 	BYTE bindType;
-	BYTE treeIndex;
 	BYTE dynamicTexBits;
 #if UNREAL_TOURNAMENT_OLDUNREAL
 	INT RealtimeChangeCount;
@@ -158,9 +184,13 @@ struct FCachedTexture {
 #endif
 	tex_params_t texParams;
 	D3DFORMAT texFormat;
-	void (FASTCALL UD3D9RenderDevice::*pConvertBGRA7777)(const FMipmapBase *, INT);
-	void (FASTCALL UD3D9RenderDevice::*pConvertBGRA8)(const FMipmapBase *, INT);
-	void (FASTCALL UD3D9RenderDevice::*pConvertRGBA8)(const FMipmapBase *, INT);
+	void (FASTCALL UD3D9RenderDevice::*pConvertBGRA7777)(const FTexConvertCtx &, const FMipmapBase *, INT);
+	void (FASTCALL UD3D9RenderDevice::*pConvertBGRA8)(const FTexConvertCtx &, const FMipmapBase *, INT);
+	void (FASTCALL UD3D9RenderDevice::*pConvertRGBA8)(const FTexConvertCtx &, const FMipmapBase *, INT);
+	FTexConvertJob *pConvertJob;
+	FTexRealtimeShadow *pRealtimeShadow;
+	//Hash of the source contents for sharing the texture object between identical textures, 0 if not shareable
+	QWORD contentHash;
 	FCachedTexture *pPrev;
 	FCachedTexture *pNext;
 };
@@ -201,6 +231,75 @@ private:
 	FCachedTexture m_tail;
 };
 
+//Singly linked list of cached textures through pNext
+class CCachedTexturePool {
+public:
+	CCachedTexturePool() {
+		m_pTail = 0;
+	}
+	~CCachedTexturePool() {
+	}
+
+	inline void mark_as_clear(void) {
+		m_pTail = 0;
+	}
+
+	inline void FASTCALL add(FCachedTexture *pCT) {
+		pCT->pNext = m_pTail;
+		m_pTail = pCT;
+	}
+
+	inline FCachedTexture *try_remove(void) {
+		FCachedTexture *pCT = m_pTail;
+		if (pCT != 0) {
+			m_pTail = pCT->pNext;
+		}
+		return pCT;
+	}
+
+private:
+	FCachedTexture *m_pTail;
+};
+
+//Conversion of a new texture on the background worker
+//The worker only sees the snapshot of the source mips and a copy of the bind, the render thread uploads the result
+struct FTexConvertJob {
+	struct level_t {
+		BYTE UBits, VBits;
+		INT USize, VSize;
+		DWORD srcOffset;
+		DWORD srcSize;
+		DWORD dstOffset;
+		DWORD dstPitch;
+		DWORD dstWidth;
+		DWORD dstHeight;
+	};
+
+	//Render thread only, cleared if the bind is dropped before the upload
+	FCachedTexture *pBind;
+	//Copy of the bind for the converters, which read its sizes, clamp values and convert procs
+	FCachedTexture bind;
+	INT format;
+	std::vector<level_t> levels;
+	std::vector<BYTE> srcData;
+	std::vector<FColor> palette;
+	std::vector<BYTE> dstData;
+	//Key to store the result under in the disk cache, 0 if it should not be stored
+	QWORD diskCacheKey;
+	//Guarded by the worker mutex
+	bool done;
+};
+
+//Source bits of a realtime texture as of its last upload
+//Later changes are found by comparing row blocks against it, and only the rows that differ are converted and uploaded
+struct FTexRealtimeShadow {
+	std::vector<FTexConvertJob::level_t> levels;
+	std::vector<BYTE> srcData;
+	FColor palette[256];
+	//Set once a change skipped the lower levels because they were not sampled
+	bool staleMips;
+};
+
 struct FTexInfo {
 	QWORD CurrentCacheID;
 	DWORD CurrentDynamicPolyFlags;
@@ -469,6 +568,11 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	IDirect3DVertexBuffer9* m_d3dQuadBuffer;
 	DWORD m_QuadBufferColor;
 
+	//Anchor buffers, static geometry for each anchor seen
+	IDirect3DVertexBuffer9* m_d3dAnchorVertexColorBuffer;
+	IDirect3DVertexBuffer9* m_d3dAnchorTexCoordBuffer;
+	UINT m_anchorBufferSize;
+
 	//Tex coords
 	IDirect3DVertexBuffer9 *m_d3dTexCoordBuffer[MAX_TMUNITS];
 	FGLTexCoord *m_pTexCoordArray[MAX_TMUNITS];
@@ -476,16 +580,25 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	IDirect3DVertexBuffer9* m_d3dTempTexCoordBuffer[MAX_TMUNITS];
 	IDirect3DVertexBuffer9* m_currentTexCoordBuffer[MAX_TMUNITS];
 
+	//Indices
+	IDirect3DIndexBuffer9 *m_d3dIndexBuffer;
+	WORD *m_pIndexArray;
+
 	//Vertex buffer state flags
 	UINT m_curVertexBufferPos;
 	bool m_vertexColorBufferNeedsDiscard;
 	bool m_texCoordBufferNeedsDiscard[MAX_TMUNITS];
+	UINT m_curIndexBufferPos;
+	bool m_indexBufferNeedsDiscard;
 
-	void (FASTCALL* m_pBuffer3BasicVertsProc)(UD3D9RenderDevice*, FTransTexture**);
-	void (FASTCALL* m_pBuffer3ColoredVertsProc)(UD3D9RenderDevice*, FTransTexture**);
-	void (FASTCALL* m_pBuffer3FoggedVertsProc)(UD3D9RenderDevice*, FTransTexture**);
-
-	void (FASTCALL* m_pBuffer3VertsProc)(UD3D9RenderDevice*, FTransTexture**);
+	//Gouraud vertex colour modes, each gets its own specialisation of the buffer verts proc
+	enum {
+		GCM_WHITE,
+		GCM_COLORED,
+		GCM_FOGGED,
+		GCM_ALPHA_BLENDED,
+	};
+	void (FASTCALL* m_pBufferGouraudVertsProc)(UD3D9RenderDevice*, FTransTexture**, INT, INT);
 
 	//Texture state cache information
 	BYTE m_texEnableBits;
@@ -530,13 +643,36 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	UBOOL EnableSkyBoxRendering;
 	UBOOL EnableSkyBoxAnchors;
 	UBOOL EnableHashTextures;
+	UBOOL AsyncTextureUpload;
+	FLOAT TexUploadBudgetMs;
+	UBOOL TexDiskCache;
+	INT TexDiskCacheMaxMB;
+	INT TexMemBudgetMB;
+	INT TexMemLowWaterPct;
+	UBOOL LevelTexturePrecache;
+	FLOAT TexPrecacheBudgetMs;
+	UBOOL TexDedup;
 	FLOAT LightMultiplier;
 	FLOAT LightRadiusDivisor;
 	FLOAT LightRadiusExponent;
+	INT LightBudget;
+	UBOOL LightClustering;
+	FLOAT LightClusterDistance;
+	INT LightClusterMaxRadius;
+	UBOOL LightCulling;
+	FLOAT LightCullMargin;
+	UBOOL UseRemixLights;
+	FLOAT RemixLightSphereScale;
+	FLOAT RemixLightIntensity;
+	UBOOL UseRemixLevelMeshes;
 
 	FColor SurfaceSelectionColor;
 
 	std::unordered_set<std::wstring> hashTexBlacklist;
+	//Blacklist result for each realtime texture seen, so the path name is only built once
+	std::unordered_map<UTexture*, bool> hashTexDecisions;
+	//Config generation hashTexBlacklist was loaded from
+	unsigned int hashTexBlacklistGeneration;
 
 	//Previous lock variables
 	//Used to detect changes in settings
@@ -604,36 +740,72 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 		} TMU[MAX_TMUNITS];
 	} MultiPass;				// vogel: MULTIPASS!!! ;)
 
-	typedef rbtree<DWORD, FCachedTexture> DWORD_CTTree_t;
-	typedef rbtree_allocator<DWORD_CTTree_t> DWORD_CTTree_Allocator_t;
-	typedef rbtree<QWORD, FCachedTexture> QWORD_CTTree_t;
-	typedef rbtree_allocator<QWORD_CTTree_t> QWORD_CTTree_Allocator_t;
-	typedef rbtree_node_pool<QWORD_CTTree_t> QWORD_CTTree_NodePool_t;
+	typedef ptr_hashmap<DWORD, FCachedTexture> DWORD_CTMap_t;
+	typedef ptr_hashmap<QWORD, FCachedTexture> QWORD_CTMap_t;
 	typedef DWORD TexPoolMapKey_t;
-	typedef rbtree<TexPoolMapKey_t, QWORD_CTTree_NodePool_t> TexPoolMap_t;
-	typedef rbtree_allocator<TexPoolMap_t> TexPoolMap_Allocator_t;
+	//Maps to the head of a list of pooled textures linked through pNext
+	typedef ptr_hashmap<TexPoolMapKey_t, FCachedTexture> TexPoolMap_t;
+	typedef slab_allocator<FCachedTexture> CT_Allocator_t;
 
-	enum { NUM_CTTree_TREES = 16 }; //Must be a power of 2
-	inline DWORD FASTCALL CTZeroPrefixCacheIDSuffixToTreeIndex(DWORD CacheIDSuffix) {
-		return ((CacheIDSuffix >> 12) & (NUM_CTTree_TREES - 1));
-	}
-	inline DWORD FASTCALL CTNonZeroPrefixCacheIDSuffixToTreeIndex(DWORD CacheIDSuffix) {
-		return ((CacheIDSuffix >> 20) & (NUM_CTTree_TREES - 1));
-	}
 	inline DWORD FASTCALL MakeTexPoolMapKey(DWORD UBits, DWORD VBits) {
 		return ((UBits << 16) | VBits);
 	}
 
-	DWORD_CTTree_t m_localZeroPrefixBindTrees[NUM_CTTree_TREES], * m_zeroPrefixBindTrees;
-	QWORD_CTTree_t m_localNonZeroPrefixBindTrees[NUM_CTTree_TREES], * m_nonZeroPrefixBindTrees;
+	DWORD_CTMap_t m_localZeroPrefixBindMap, * m_zeroPrefixBindMap;
+	QWORD_CTMap_t m_localNonZeroPrefixBindMap, * m_nonZeroPrefixBindMap;
 	CCachedTextureChain m_localNonZeroPrefixBindChain, * m_nonZeroPrefixBindChain;
 	TexPoolMap_t m_localRGBA8TexPool, * m_RGBA8TexPool;
 
-	DWORD_CTTree_Allocator_t m_DWORD_CTTree_Allocator;
-	QWORD_CTTree_Allocator_t m_QWORD_CTTree_Allocator;
-	TexPoolMap_Allocator_t m_TexPoolMap_Allocator;
+	//Every cached texture record in the bind maps, the tex pool and the node pool comes from here
+	CT_Allocator_t m_CT_Allocator;
+
+	//Records left without a texture object after handing it over from the tex pool
+	CCachedTexturePool m_nonZeroPrefixNodePool;
+
+	//Texture memory residency, counting every texture object in the bind maps and the tex pool
+	enum tex_res_format_t {
+		TEX_RES_FORMAT_RGBA8,
+		TEX_RES_FORMAT_16BIT,
+		TEX_RES_FORMAT_DXT1,
+		TEX_RES_FORMAT_DXT3,
+		TEX_RES_FORMAT_DXT5,
+		TEX_RES_FORMAT_OTHER,
+		TEX_RES_FORMAT_COUNT
+	};
+	QWORD m_texResidentBytes;
+	QWORD m_texResidentFormatBytes[TEX_RES_FORMAT_COUNT];
+	// Texture eviction stats, reset each frame
+	DWORD TexEvictions, TexBudgetEvictions;
+
+	static tex_res_format_t FASTCALL GetTexResFormat(D3DFORMAT texFormat);
+	static DWORD FASTCALL CalcTexBytes(D3DFORMAT texFormat, DWORD UBits, DWORD VBits, DWORD numLevels);
+
+	inline void FASTCALL AddTexResidency(const FCachedTexture *pCT) {
+		m_texResidentBytes += pCT->texBytes;
+		m_texResidentFormatBytes[GetTexResFormat(pCT->texFormat)] += pCT->texBytes;
+	}
+	inline void FASTCALL RemoveTexResidency(const FCachedTexture *pCT) {
+		m_texResidentBytes -= pCT->texBytes;
+		m_texResidentFormatBytes[GetTexResFormat(pCT->texFormat)] -= pCT->texBytes;
+	}
 
-	QWORD_CTTree_NodePool_t m_nonZeroPrefixNodePool;
+	//Texture objects of uploaded textures by content hash, binds with identical contents share one object
+	//Only the first bind using an object counts towards residency
+	tex_share_map<IDirect3DTexture9> m_texSharedObjs;
+	QWORD m_texDedupSavedBytes;
+	// Binds that took a shared texture object, reset each frame
+	DWORD TexDedupHits;
+
+	QWORD FASTCALL HashTexContent(const FCachedTexture *pBind, FTextureInfo &Info, DWORD PolyFlags);
+	bool FASTCALL TryShareTexObj(FCachedTexture *pBind, FTextureInfo &Info, DWORD PolyFlags);
+	void FASTCALL PublishSharedTexObj(FCachedTexture *pBind);
+	bool FASTCALL ReleaseSharedTexObj(FCachedTexture *pCT);
+	void FASTCALL CreateTexObj(FCachedTexture *pBind, const FTextureInfo &Info);
+
+	//True if other binds use the same texture object
+	inline bool FASTCALL IsTexObjShared(const FCachedTexture *pCT) const {
+		return pCT->contentHash && m_texSharedObjs.is_shared(pCT->contentHash, pCT->pTexObj);
+	}
 
 	//Fixed texture cache ids
 #define TEX_CACHE_ID_UNUSED		0xFFFFFFFFFFFFFFFFULL
@@ -656,58 +828,113 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	};
 #define TEX_FLAG_NO_CLAMP	0x00000001
 
-	struct FTexConvertCtx {
-		INT stepBits;
-		DWORD texWidthPow2;
-		DWORD texHeightPow2;
-		const FCachedTexture* pBind;
-		D3DLOCKED_RECT lockRect;
-	} m_texConvertCtx;
-
-	class LightSlots {
-	private:
-		std::unordered_map<AActor*, int> actorSlots;
-		std::deque<int> availableSlots;
-		ods_stream dout;
-
-	public:
-		LightSlots(int numSlots) {
-			actorSlots.reserve(numSlots);
-			for (int i = 0; i < numSlots; ++i) {
-				availableSlots.push_back(i);
-			}
-		}
+	FTexConvertCtx m_texConvertCtx;
 
-		// Updates which actors are in the slots, returns a set of slots that are no longer used
-		std::unordered_set<int> updateActors(const std::vector<AActor*>& actors);
-
-		const std::deque<int> unusedSlots() {
-			return availableSlots;
-		}
+	//Row converters for unstepped 32-bit uploads, using the best SIMD level the CPU has
+	CTexConv m_texConv;
 
-		const std::unordered_map<AActor*, int> slotMap() {
-			return actorSlots;
-		}
-	};
 	LightSlots* lightSlots;
-
-	struct TileFuncCall {
-		FSceneNode frame;
-		FTextureInfo texInfo;
-		FLOAT X, Y, XL, YL, U, V, UL, VL, Z;
-		FPlane Color;
-		FPlane Fog;
-		DWORD PolyFlags;
-
-		TileFuncCall() {}
-		TileFuncCall(const TileFuncCall& other) = default;
-
-		void operator()(UD3D9RenderDevice* device) {
-			device->DrawTile(&frame, texInfo, X, Y, XL, YL, U, V, UL, VL, nullptr, Z, Color, Fog, PolyFlags);
-		}
+	// Lights sent through the Remix API, each slot owns a light handle
+	LightSlots* remixLightSlots;
+	struct RemixMaterial {
+		remixapi_MaterialHandle handle = nullptr;
+		QWORD hash = 0;
+		std::wstring textureFile;
+		// Level meshes drawn with it, it can't be destroyed before them
+		DWORD meshRefs = 0;
+	};
+	// Materials of each texture by its cache id, kept until the texture is evicted
+	std::unordered_map<QWORD, std::array<RemixMaterial, REMIX_MATERIAL_CLASS_MAX>> remixMaterials;
+	// Anchor geometry lives in the anchor buffers, 12 vertices each
+	static constexpr UINT ANCHOR_VERTS = 12;
+	// First vertex of each anchor's geometry by its two hashes
+	std::unordered_map<QWORD, UINT> anchorGeometry;
+	std::vector<FGLVertexColor> anchorVerts;
+	std::vector<FGLTexCoord> anchorTexCoords;
+	// Set when anchorVerts has anchors the buffers don't
+	bool anchorBuffersDirty;
+	struct AnchorDraw {
+		D3DMATRIX matrix;
+		UINT firstVertex;
+	};
+	// Anchors to draw this frame
+	std::vector<AnchorDraw> anchorDraws;
+	// Static level meshes of each zone, drawn as instances while the zone is visible
+	RemixLevelMeshes remixLevelMeshes;
+	// Set when the level meshes were destroyed and have to be registered again
+	bool remixLevelMeshesDirty;
+	// DDS files written this session for Remix API materials, empty if the texture couldn't be written
+	std::unordered_map<UTexture*, std::wstring> remixTextureFiles;
+	// Settings the light range depends on, when they change every light is sent again
+	FLOAT lastLightSettings[6];
+	// Scratch space for picking the lights within the budget, kept between frames
+	std::vector<std::pair<FLOAT, AActor*>> lightScores;
+	std::vector<AActor*> budgetLights;
+
+	// Nearby small steady lights with the same colour merged into one, sent as the first light in the cluster
+	struct LightCluster {
+		AActor* representative;
+		FVector locationSum;
+		FLOAT brightnessSum;
+		INT count;
+		FVector centroid;
+		FLOAT extent;
+	};
+	std::vector<LightCluster> lightClusterList;
+	std::unordered_map<QWORD, INT> lightClusterCells;
+	std::unordered_map<AActor*, INT> lightClusterOfRep;
+	std::vector<INT> lightClusterIndex;
+	std::vector<AActor*> clusteredLights;
+	// Light clustering stats, reset each frame
+	DWORD LightClusters, LightsMerged;
+
+	// Compact record of a canvas tile, the frame and texture info are shared between tiles
+	struct BufferedTile {
+		FLOAT X, Y, XL, YL, U, V, UL, VL;
+		DWORD color;
+		DWORD polyFlags;
+		WORD frameIdx;
+		WORD texIdx;
 	};
 	bool bufferTileDraws;
-	std::vector<TileFuncCall> bufferedTileDraws;
+	std::vector<BufferedTile> bufferedTiles;
+	std::vector<FSceneNode> bufferedTileFrames;
+	std::vector<FTextureInfo> bufferedTileTextures;
+	std::unordered_map<QWORD, WORD> bufferedTileTexIndices;
+	// Tile stats, reset each frame
+	DWORD TileCount, TileBatches, TileBufferBytes;
+
+	//Background texture conversion
+	//Jobs in submission order, owned by the render thread
+	std::deque<FTexConvertJob*> m_texConvertJobs;
+	//Jobs waiting for the worker, guarded by m_texConvertMutex along with the rest of the worker state
+	std::deque<FTexConvertJob*> m_texConvertWorkQueue;
+	FTexConvertJob *m_pTexConvertActiveJob;
+	bool m_texConvertExit;
+	std::mutex m_texConvertMutex;
+	std::condition_variable m_texConvertWorkCV;
+	std::condition_variable m_texConvertDoneCV;
+	std::thread m_texConvertThread;
+	// Texture conversion stats, reset each frame
+	DWORD TexAsyncQueued, TexAsyncUploaded, TexStalls;
+
+	//Textures referenced by the current level, uploaded over the first frames after a level change
+	//Textures can be collected before the list is done, so each one is looked up again by its object index before use
+	struct TexPrecacheEntry {
+		INT textureIndex;
+		UTexture* texture;
+		DWORD polyFlags;
+	};
+	std::vector<TexPrecacheEntry> texPrecacheList;
+	size_t texPrecachePos;
+	DWORD texPrecacheFrames;
+	DOUBLE texPrecacheMs;
+
+	//Converted textures kept on disk between runs
+	CTexDiskCache m_texDiskCache;
+	DWORD TexDiskHits, TexDiskMisses;
+	// Rows uploaded for realtime textures through dirty row blocks, reset each frame
+	DWORD TexDirtyRows;
 
 	inline void FlushVertexBuffers(void) {
 		//dout << L"Vertex buffers flushed" << std::endl;
@@ -716,6 +943,8 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 		for (int u = 0; u < MAX_TMUNITS; u++) {
 			m_texCoordBufferNeedsDiscard[u] = true;
 		}
+		m_curIndexBufferPos = 0;
+		m_indexBufferNeedsDiscard = true;
 
 #ifdef D3D9_DEBUG
 		m_vbFlushCount++;
@@ -734,6 +963,13 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 		return bufferPos;
 	}
 
+	// Gets the current index buffer position and increments it by numIndices
+	inline UINT getIndexBufferPos(UINT numIndices) {
+		UINT bufferPos = m_curIndexBufferPos;
+		m_curIndexBufferPos += numIndices;
+		return bufferPos;
+	}
+
 	inline bool needsNewBuffer(DWORD polyFlags, UINT numVerts, FTextureInfo* info = nullptr) {
 		if (m_curPolyFlags != polyFlags) return true;
 		QWORD cacheId = info ? calcCacheID(*info, polyFlags) : TEX_CACHE_ID_NO_TEX;
@@ -805,6 +1041,36 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 		}
 	}
 
+	// Locks the index buffer at the current position, callers must make sure the indices fit
+	inline void LockIndexBuffer(void) {
+		guard(UD3D9RenderDevice::LockIndexBuffer);
+		DWORD lockFlags = D3DLOCK_NOSYSLOCK;
+		HRESULT hResult;
+
+		if (m_indexBufferNeedsDiscard) {
+			m_indexBufferNeedsDiscard = false;
+			lockFlags |= D3DLOCK_DISCARD;
+		} else {
+			lockFlags |= D3DLOCK_NOOVERWRITE;
+		}
+
+		BYTE* pData = nullptr;
+
+		hResult = m_d3dIndexBuffer->Lock(0, 0, (VOID**)&pData, lockFlags);
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Index buffer lock failed: %ls"), *ExplainResult(hResult));
+		}
+
+		m_pIndexArray = (WORD*)(pData + (m_curIndexBufferPos * sizeof(WORD)));
+		unguard;
+	}
+	inline void UnlockIndexBuffer(void) {
+		HRESULT hResult = m_d3dIndexBuffer->Unlock();
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Index buffer unlock failed: %ls"), *ExplainResult(hResult));
+		}
+	}
+
 	// Locks/Creates a UV buffer appropriate for the given number of points
 	inline void FASTCALL LockTexCoordBuffer(DWORD texUnit, UINT numPoints) {
 		guard(UD3D9RenderDevice::LockTexCoordBuffer);
@@ -875,11 +1141,31 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 		BV_TYPE_NONE			= 0x00,
 		BV_TYPE_GOURAUD_POLYS	= 0x01,
 		BV_TYPE_TILES			= 0x02,
-		BV_TYPE_LINES			= 0x03,
-		BV_TYPE_POINTS			= 0x04,
+		BV_TYPE_LINES_POINTS	= 0x03,
+		BV_TYPE_INDEXED_TRIS	= 0x05,
 	};
 	BYTE m_bufferedVertsType;
 	DWORD m_bufferedVerts;
+	DWORD m_bufferedIndices;
+	// Texture cache ID the open tile batch was started with, lets glyph runs skip calcCacheID
+	QWORD m_tileBatchInfoCacheID;
+	// Editor lines and points are kept on the CPU until the batch ends, so they don't break each other's batches
+	// Consecutive lines or points form a run, runs are drawn in the order they were buffered
+	struct LinePointRun {
+		D3DPRIMITIVETYPE primType;
+		UINT numVerts;
+	};
+	std::vector<FGLVertexColor> m_bufferedLinePointVerts;
+	std::vector<LinePointRun> m_bufferedLinePointRuns;
+
+	inline void BufferLinePointVerts(D3DPRIMITIVETYPE primType, std::initializer_list<FGLVertexColor> verts) {
+		if (m_bufferedLinePointRuns.empty() || m_bufferedLinePointRuns.back().primType != primType) {
+			m_bufferedLinePointRuns.push_back({ primType, 0 });
+		}
+		m_bufferedLinePointRuns.back().numVerts += static_cast<UINT>(verts.size());
+		m_bufferedLinePointVerts.insert(m_bufferedLinePointVerts.end(), verts);
+		m_bufferedVerts += static_cast<DWORD>(verts.size());
+	}
 
 	inline void FASTCALL StartBuffering(DWORD bvType) {
 		m_bufferedVertsType = bvType;
@@ -897,8 +1183,9 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	void EndBufferingNoCheck(void);
 	void EndGouraudPolygonBufferingNoCheck(void);
 	void EndTileBufferingNoCheck(void);
-	void EndLineBufferingNoCheck(void);
-	void EndPointBufferingNoCheck(void);
+	void EndLinePointBufferingNoCheck(void);
+	void FASTCALL DrawBufferedLinePointVerts(D3DPRIMITIVETYPE primType, const FGLVertexColor* verts, UINT totalVerts, UINT vertsPerPrim);
+	void EndIndexedTriBufferingNoCheck(void);
 
 
 	static const TCHAR* StaticConfigName() { return TEXT("D3D9DrvRTX"); }
@@ -983,11 +1270,12 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	void InitPermanentResourcesAndRenderingState(void);
 	void FreePermanentResources(void);
 
-	void DrawGouraudPolygonOld(FSceneNode* Frame, FTextureInfo& Info, FTransTexture** Pts, INT NumPts, DWORD PolyFlags, FSpanBuffer* Span);
-
 	void InitNoTextureSafe(void);
 
 	void ScanForOldTextures(void);
+	void KeepBoundTextures(void);
+	void FASTCALL DeleteCachedTexture(FCachedTexture *pCT);
+	void EnforceTexMemBudget(void);
 
 	inline void FASTCALL SetNoTexture(INT Multi) {
 		if (TexInfo[Multi].CurrentCacheID != TEX_CACHE_ID_NO_TEX) {
@@ -1065,22 +1353,45 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	bool FASTCALL BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& Info, DWORD PolyFlags, FCachedTexture*& Bind);
 	void FASTCALL SetTextureNoCheck(DWORD texNum, FTexInfo& Tex, FTextureInfo& Info, DWORD PolyFlags);
 	void FASTCALL CacheTextureInfo(FCachedTexture *pBind, const FTextureInfo &Info, DWORD PolyFlags);
-
-	void FASTCALL ConvertDXT1_DXT1(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertDXT1_DXT3(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertDXT35_DXT35(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertP8_RGBA8888(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertP8_RGBA8888_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertP8_RGB565(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertP8_RGB565_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertP8_RGBA5551(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertP8_RGBA5551_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level);
-	void FASTCALL ConvertBGRA7777_BGRA8888(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertBGRA7777_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertBGRA8_BGRA8888(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertBGRA8_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertRGBA8_BGRA8888(const FMipmapBase *Mip, INT Level);
-	void FASTCALL ConvertRGBA8_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertTextureMip(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Format, INT Level);
+	void FASTCALL ConvertTextureMip_NoGuard(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Format, INT Level);
+
+	bool FASTCALL GetTexConvertLayout(const FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel, std::vector<FTexConvertJob::level_t> &levels, DWORD &srcSize, DWORD &dstSize);
+	QWORD FASTCALL HashTexConvertSource(const FCachedTexture *pBind, const FTextureInfo &Info, const std::vector<FTexConvertJob::level_t> &levels);
+	void FASTCALL WriteTexLevels(FCachedTexture *pBind, const std::vector<FTexConvertJob::level_t> &levels, const BYTE *pData);
+	bool FASTCALL LoadTexFromDiskCache(FCachedTexture *pBind, const std::vector<FTexConvertJob::level_t> &levels, DWORD dstSize, QWORD key);
+	bool FASTCALL CaptureRealtimeShadow(FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel);
+	bool FASTCALL UpdateRealtimeTexture(FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel);
+	inline void FASTCALL FreeRealtimeShadow(FCachedTexture *pCT) {
+		if (pCT->pRealtimeShadow) {
+			delete pCT->pRealtimeShadow;
+			pCT->pRealtimeShadow = NULL;
+		}
+	}
+	void FASTCALL QueueTexConvertJob(FCachedTexture *pBind, const FTextureInfo &Info, std::vector<FTexConvertJob::level_t> &levels, DWORD srcSize, DWORD dstSize, QWORD diskCacheKey);
+	void FASTCALL RunTexConvertJob(FTexConvertJob *pJob);
+	void FASTCALL UploadTexConvertJob(FTexConvertJob *pJob);
+	void FASTCALL WaitForTexConvertJob(FCachedTexture *pBind);
+	void UploadConvertedTextures(void);
+	void CancelTexConvertJobs(void);
+	void StopTexConvertWorker(void);
+	void TexConvertWorkerMain(void);
+
+	void FASTCALL ConvertDXT1_DXT1(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertDXT1_DXT3(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertDXT35_DXT35(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertP8_RGBA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertP8_RGBA8888_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertP8_RGB565(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertP8_RGB565_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertP8_RGBA5551(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertP8_RGBA5551_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level);
+	void FASTCALL ConvertBGRA7777_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertBGRA7777_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertBGRA8_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertBGRA8_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertRGBA8_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
+	void FASTCALL ConvertRGBA8_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level);
 
 	inline void FASTCALL SetBlend(DWORD PolyFlags, bool isUI = false) {
 #if UTGLR_USES_ALPHABLEND
@@ -1234,8 +1545,6 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 	UINT FASTCALL BufferStaticComplexSurfaceGeometry(const FSurfaceFacet& Facet, const FGLMapDot& csDot, bool append = false);
 	UINT FASTCALL BufferTriangleSurfaceGeometry(const std::vector<FRenderVert>& vertices);
 
-	void FASTCALL BufferAdditionalClippedVerts(FTransTexture** Pts, INT NumPts);
-
 	// Takes a list of faces and draws them in batches
 	void drawLevelSurfaces(FSceneNode* frame, FSurfaceInfo& surface, std::vector<FSurfaceFacet*>& facets);
 
@@ -1262,27 +1571,64 @@ class UD3D9RenderDevice : public RENDERDEVICE_SUPER {
 #endif
 	// Renders a mover brush
 	void renderMover(FSceneNode* frame, ABrush* mover);
-	// Updates and sends the given lights to dx
-	void renderLights(FSceneNode* frame, std::vector<AActor*> lightActors);
-	// Renders a magic shape for anchoring stuff to the sky box
-	void renderAnchor(const D3DMATRIX* matrix, UTexture* texture, const uint32_t hash1, const uint32_t hash2);
-	void renderSkyZoneAnchor(ASkyZoneInfo* zone, const FVector* location);
-	void renderRTXAnchor(const RTXAnchor& anchor, UTexture* texture);
+	// Updates and sends the given lights to dx, keeping the most important ones when there are more than the budget
+	void renderLights(FSceneNode* frame, const std::vector<AActor*>& lightActors, QWORD visibleZones);
+	// Light properties of an actor, or of the cluster it represents
+	LightSlots::LightState getLightState(AActor* actor);
+	// Colour and range a light is sent with
+	void getLightColourRange(AActor* actor, const LightSlots::LightState& state, FLOAT brightnessSetting, FPlane& colour, FLOAT& range);
+	// Creates, replaces and draws the Remix API lights for the actors in remixLightSlots
+	void renderRemixLights(FLOAT brightnessSetting);
+	// Destroys every Remix API light handle
+	void destroyRemixLights();
+	// Whether level surfaces with these flags can be registered as a static Remix API mesh
+	bool canUseRemixLevelMesh(const FTextureInfo& texInfo, DWORD polyFlags);
+	// Registers the facets of one zone's texture bucket as a Remix API mesh, false if it has to be drawn through D3D
+	bool createRemixLevelMesh(BYTE zone, FTextureInfo& texInfo, DWORD polyFlags, const std::vector<FSurfaceFacet*>& facets, const TCHAR* levelName);
+	// Draws an instance of each mesh registered for the zone
+	void drawRemixLevelMeshes(BYTE zone);
+	// Destroys every Remix API level mesh and releases its material
+	void destroyRemixLevelMeshes();
+	static RemixMaterialClass getRemixMaterialClass(DWORD polyFlags);
+	// Finds or creates the material for a texture and its poly flags, counting a reference for a mesh
+	remixapi_MaterialHandle acquireRemixMaterial(FTextureInfo& texInfo, DWORD polyFlags);
+	void releaseRemixMaterial(QWORD cacheID, RemixMaterialClass materialClass);
+	// Destroys the materials of an evicted texture that no mesh is using
+	void evictRemixMaterials(QWORD cacheID);
+	void destroyRemixMaterials();
+	// Writes the base mip of a texture as a DDS file for a Remix API material, returns the file or an empty string
+	const std::wstring& getRemixTextureFile(FTextureInfo& texInfo, DWORD polyFlags);
+	// Merges nearby small lights of the same colour, into clusteredLights
+	void clusterLights(const std::vector<AActor*>& lightActors);
+	// Picks the lights to keep when there are more than fit, into budgetLights
+	void selectBudgetLights(FSceneNode* frame, const std::vector<AActor*>& lightActors, QWORD visibleZones, size_t budget);
+	// Adds a magic shape for anchoring stuff to this frame's anchors, its geometry is only built the first time its hashes are seen
+	void addAnchor(const D3DMATRIX& matrix, const uint32_t hash1, const uint32_t hash2);
+	void addSkyZoneAnchor(ASkyZoneInfo* zone, const FVector* location);
+	void addRTXAnchor(const RTXAnchors& anchors, size_t index);
+	// Draws all the anchors added this frame in one pass
+	void renderAnchors(UTexture* texture);
+	// Forgets the anchor geometry, for when the level's anchors change
+	void clearAnchorGeometry();
+	// Replaces the list of textures to precache, any unfinished list is dropped
+	void setTexturePrecacheList(std::vector<TexPrecacheEntry>&& entries);
+	// Uploads textures from the precache list until the time budget for this frame is spent
+	void precacheTextures(FSceneNode* frame);
 	// Given a set of verts and textures, render them with the actor matrix.
 	void renderSurfaceBuckets(const ActorRenderData& renderData, FTime currentTime);
 
 	void fillHashTexture(FTexConvertCtx convertContext, FTextureInfo& tex);
+	// Called on level change, reloads the hash texture blacklist if the config file has changed since it was loaded
+	// and forgets the blacklist result of each texture
+	void updateHashTexBlacklist();
 	bool shouldGenHashTexture(const FTextureInfo& tex);
 
-	void executeBufferedTileDraws() {
-		bool wasBuffered = bufferTileDraws;
-		bufferTileDraws = false;
-		for (TileFuncCall& call : bufferedTileDraws) {
-			call(this);
-		}
-		bufferedTileDraws.clear();
-		bufferTileDraws = wasBuffered;
-	}
+	// Draws all the buffered tiles in order, consecutive tiles sharing texture and flags are drawn together
+	void executeBufferedTileDraws();
+	// Buffers a run of tiles that all share the same frame, texture and poly flags
+	void DrawTileRun(FSceneNode* Frame, FTextureInfo& Info, const BufferedTile* tiles, UINT numTiles);
+	// Writes a single tile quad into the open tile batch
+	inline void FASTCALL BufferTileQuad(const BufferedTile& tile, FLOAT XB, FLOAT YB);
 
 	// Sets up the projections ready for drawing in the world
 	void startWorldDraw(FSceneNode* frame);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Engine.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// All the anchors of a level, with each property in its own array so ticking is a few tight loops
+// Vectors are stored as 3 floats per anchor
+class RTXAnchors {
+protected:
+	std::vector<uint32_t> hashes;
+	std::vector<float> locations;
+	std::vector<float> rotations;
+	std::vector<float> scales;
+	std::vector<float> angularVelocities;
+	std::vector<bool> pausable;
+
+	// Anchors moving along a path, pathAnchors is the index of each in the arrays above
+	std::vector<size_t> pathAnchors;
+	std::vector<float> pathStarts;
+	std::vector<float> pathDirections;
+	// Ping-pong paths are twice as long, going there and back
+	std::vector<float> pathLengths;
+	// Where ping-pong paths turn around, infinite for linear ones
+	std::vector<float> pathTurnPoints;
+	std::vector<float> pathSpeeds;
+	std::vector<float> pathLocations;
+
+	size_t add(
+		const std::string& name,
+		const FVector& location,
+		const FVector& startRot,
+		const FVector& scale,
+		const FVector& rotationRate,
+		bool pausable
+	);
+
+public:
+	// Spins in place
+	void addStatic(
+		const std::string& name,
+		const FVector& location,
+		const FVector& startRot,
+		const FVector& scale,
+		const FVector& rotationRate,
+		bool pausable
+	);
+	// Moves from start to end at speed, either jumping back to the start or turning around when ping-ponging
+	void addPath(
+		const std::string& name,
+		const FVector& startLoc,
+		const FVector& startRot,
+		const FVector& scale,
+		const FVector& rotationRate,
+		bool pausable,
+		const FVector& endLoc,
+		float speed,
+		bool pingPong
+	);
+
+	// Pausable anchors stay where they are while the game is paused
+	void tick(float deltaTime, bool paused);
+
+	void clear();
+	size_t size() const {
+		return hashes.size();
+	}
+
+	FVector getLocation(size_t index) const {
+		return FVector(locations[index * 3], locations[index * 3 + 1], locations[index * 3 + 2]);
+	}
+	FVector getRotation(size_t index) const {
+		return FVector(rotations[index * 3], rotations[index * 3 + 1], rotations[index * 3 + 2]);
+	}
+	FVector getScale(size_t index) const {
+		return FVector(scales[index * 3], scales[index * 3 + 1], scales[index * 3 + 2]);
+	}
+	uint32_t getHash(size_t index) const {
+		return hashes[index];
+	}
+};
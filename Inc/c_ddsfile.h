@@ -0,0 +1,54 @@
+
+#ifndef _C_DDSFILE_
+#define _C_DDSFILE_
+
+//Writes single level 2D textures as DDS files
+//Used for the texture paths Remix API materials are created with
+class CDDSFile {
+public:
+	enum format_t {
+		//32-bit texels, B G R A byte order
+		FORMAT_BGRA8,
+		//32-bit texels, R G B A byte order
+		FORMAT_RGBA8,
+		FORMAT_DXT1,
+		FORMAT_DXT3,
+		FORMAT_DXT5
+	};
+
+	//Bytes of texel data for one level, compressed formats are padded to whole 4x4 blocks
+	static unsigned int data_size(format_t format, unsigned int width, unsigned int height);
+
+	//Returns false if the file could not be written, a partly written file is removed
+	static bool write(const wchar_t *pFileName, format_t format, unsigned int width, unsigned int height, const void *pData);
+
+private:
+	struct pixel_format_t {
+		unsigned int size;
+		unsigned int flags;
+		unsigned int fourCC;
+		unsigned int rgbBitCount;
+		unsigned int rBitMask;
+		unsigned int gBitMask;
+		unsigned int bBitMask;
+		unsigned int aBitMask;
+	};
+	struct header_t {
+		unsigned int size;
+		unsigned int flags;
+		unsigned int height;
+		unsigned int width;
+		unsigned int pitchOrLinearSize;
+		unsigned int depth;
+		unsigned int mipMapCount;
+		unsigned int reserved1[11];
+		pixel_format_t pixelFormat;
+		unsigned int caps;
+		unsigned int caps2;
+		unsigned int caps3;
+		unsigned int caps4;
+		unsigned int reserved2;
+	};
+};
+
+#endif //_C_DDSFILE_
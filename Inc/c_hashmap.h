@@ -0,0 +1,190 @@
+
+#ifndef _C_HASHMAP_
+#define _C_HASHMAP_
+
+//Open addressing hash map from an integer key to a pointer
+//Linear probing in a power of 2 sized table, removal uses backward shift so no tombstones are left behind
+//A null pointer marks an empty slot, so null data pointers cannot be stored
+template <class KeyT, class DataT> class ptr_hashmap {
+public:
+	struct entry_t {
+		KeyT key;
+		DataT *pData;
+	};
+
+private:
+	static const unsigned int MIN_CAPACITY = 64;
+
+	ptr_hashmap(const ptr_hashmap &);
+	ptr_hashmap &operator=(const ptr_hashmap &);
+
+public:
+	ptr_hashmap() {
+		m_pEntries = 0;
+		m_capacity = 0;
+		m_mask = 0;
+		m_shift = 64;
+		m_size = 0;
+	}
+	~ptr_hashmap() {
+		delete [] m_pEntries;
+	}
+
+	DataT * FASTCALL find(KeyT key) const {
+		if (m_size == 0) {
+			return 0;
+		}
+
+		unsigned int i = hash(key);
+		for (;;) {
+			const entry_t &entry = m_pEntries[i];
+			if (entry.pData == 0) {
+				return 0;
+			}
+			if (entry.key == key) {
+				return entry.pData;
+			}
+			i = (i + 1) & m_mask;
+		}
+	}
+
+	//Returns false if the key was already present, in which case its data pointer is replaced
+	bool FASTCALL insert(KeyT key, DataT *pData) {
+		//Keep the load factor at or below 3/4
+		if (((m_size + 1) * 4) > (m_capacity * 3)) {
+			grow();
+		}
+
+		unsigned int i = hash(key);
+		for (;;) {
+			entry_t &entry = m_pEntries[i];
+			if (entry.pData == 0) {
+				entry.key = key;
+				entry.pData = pData;
+				m_size++;
+				return true;
+			}
+			if (entry.key == key) {
+				entry.pData = pData;
+				return false;
+			}
+			i = (i + 1) & m_mask;
+		}
+	}
+
+	//Returns the removed data pointer, or 0 if the key was not present
+	DataT * FASTCALL remove(KeyT key) {
+		if (m_size == 0) {
+			return 0;
+		}
+
+		unsigned int i = hash(key);
+		for (;;) {
+			const entry_t &entry = m_pEntries[i];
+			if (entry.pData == 0) {
+				return 0;
+			}
+			if (entry.key == key) {
+				break;
+			}
+			i = (i + 1) & m_mask;
+		}
+
+		DataT *pData = m_pEntries[i].pData;
+
+		//Shift following entries of the probe run back into the hole
+		//An entry can fill the hole if the hole lies cyclically between its home slot and its current slot
+		unsigned int j = i;
+		for (;;) {
+			j = (j + 1) & m_mask;
+			const entry_t &entry = m_pEntries[j];
+			if (entry.pData == 0) {
+				break;
+			}
+			unsigned int home = hash(entry.key);
+			if (((j - home) & m_mask) >= ((j - i) & m_mask)) {
+				m_pEntries[i] = entry;
+				i = j;
+			}
+		}
+		m_pEntries[i].pData = 0;
+		m_size--;
+
+		return pData;
+	}
+
+	//Removes all entries but keeps the table allocated
+	void clear(void) {
+		for (unsigned int i = 0; i < m_capacity; i++) {
+			m_pEntries[i].pData = 0;
+		}
+		m_size = 0;
+	}
+
+	//Calls func(key, pData) for every entry
+	//The map must not be modified during the walk
+	template <class FuncT> void for_each(FuncT func) const {
+		if (m_size == 0) {
+			return;
+		}
+		for (unsigned int i = 0; i < m_capacity; i++) {
+			const entry_t &entry = m_pEntries[i];
+			if (entry.pData != 0) {
+				func(entry.key, entry.pData);
+			}
+		}
+	}
+
+	inline unsigned int size(void) const {
+		return m_size;
+	}
+	inline unsigned int capacity(void) const {
+		return m_capacity;
+	}
+
+private:
+	//Fibonacci hashing, the top bits of the product index the table
+	inline unsigned int FASTCALL hash(KeyT key) const {
+		return (unsigned int)(((unsigned long long)key * 0x9E3779B97F4A7C15ULL) >> m_shift);
+	}
+
+	void grow(void) {
+		entry_t *pOldEntries = m_pEntries;
+		unsigned int oldCapacity = m_capacity;
+
+		m_capacity = (oldCapacity == 0) ? MIN_CAPACITY : (oldCapacity * 2);
+		m_mask = m_capacity - 1;
+		m_shift = 64;
+		for (unsigned int c = m_capacity; c > 1; c >>= 1) {
+			m_shift--;
+		}
+
+		m_pEntries = new entry_t[m_capacity];
+		for (unsigned int i = 0; i < m_capacity; i++) {
+			m_pEntries[i].pData = 0;
+		}
+
+		//Reinsert old entries, keys are unique so no key compares are needed
+		for (unsigned int i = 0; i < oldCapacity; i++) {
+			const entry_t &entry = pOldEntries[i];
+			if (entry.pData == 0) {
+				continue;
+			}
+			unsigned int j = hash(entry.key);
+			while (m_pEntries[j].pData != 0) {
+				j = (j + 1) & m_mask;
+			}
+			m_pEntries[j] = entry;
+		}
+
+		delete [] pOldEntries;
+	}
+
+	entry_t *m_pEntries;
+	unsigned int m_capacity;
+	unsigned int m_mask;
+	unsigned int m_shift;
+	unsigned int m_size;
+};
+
+#endif //_C_HASHMAP_
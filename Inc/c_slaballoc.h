@@ -0,0 +1,108 @@
+
+#ifndef _C_SLABALLOC_
+#define _C_SLABALLOC_
+
+#include <new>
+#include <type_traits>
+
+//Fixed size block allocator for small records
+//Records are carved out of slabs of BlockSize records and recycled through a free list
+//Slabs are only returned to the heap all at once by release_all
+template <class ClassT, unsigned int BlockSize = 256> class slab_allocator {
+	static_assert(std::is_trivially_destructible<ClassT>::value, "slab_allocator records are never destructed");
+
+private:
+	union slot_t {
+		slot_t *pNextFree;
+		alignas(ClassT) unsigned char data[sizeof(ClassT)];
+	};
+	struct slab_t {
+		slab_t *pNext;
+		slot_t slots[BlockSize];
+	};
+
+	slab_allocator(const slab_allocator &);
+	slab_allocator &operator=(const slab_allocator &);
+
+public:
+	slab_allocator() {
+		m_pSlabs = 0;
+		m_pFree = 0;
+		m_numNewInSlab = BlockSize;
+		m_numSlabs = 0;
+		m_used = 0;
+		m_peak = 0;
+	}
+	~slab_allocator() {
+		release_all();
+	}
+
+	ClassT *alloc(void) {
+		slot_t *pSlot = m_pFree;
+		if (pSlot != 0) {
+			m_pFree = pSlot->pNextFree;
+		}
+		else {
+			//Take the next never used slot, starting a new slab if the current one is full
+			if (m_numNewInSlab == BlockSize) {
+				slab_t *pSlab = new slab_t;
+				pSlab->pNext = m_pSlabs;
+				m_pSlabs = pSlab;
+				m_numNewInSlab = 0;
+				m_numSlabs++;
+			}
+			pSlot = &m_pSlabs->slots[m_numNewInSlab++];
+		}
+
+		m_used++;
+		if (m_used > m_peak) {
+			m_peak = m_used;
+		}
+
+		return new (pSlot->data) ClassT;
+	}
+
+	void FASTCALL free(ClassT *pRecord) {
+		slot_t *pSlot = reinterpret_cast<slot_t *>(pRecord);
+		pSlot->pNextFree = m_pFree;
+		m_pFree = pSlot;
+		m_used--;
+	}
+
+	//Frees every slab at once, all records handed out become invalid
+	//The peak count is kept
+	void release_all(void) {
+		while (m_pSlabs != 0) {
+			slab_t *pNext = m_pSlabs->pNext;
+			delete m_pSlabs;
+			m_pSlabs = pNext;
+		}
+		m_pFree = 0;
+		m_numNewInSlab = BlockSize;
+		m_numSlabs = 0;
+		m_used = 0;
+	}
+
+	//Number of records backed by slabs
+	inline unsigned int allocated(void) const {
+		return m_numSlabs * BlockSize;
+	}
+	//Number of records currently handed out
+	inline unsigned int used(void) const {
+		return m_used;
+	}
+	//Highest number of records handed out at once
+	inline unsigned int peak(void) const {
+		return m_peak;
+	}
+
+private:
+	slab_t *m_pSlabs;
+	slot_t *m_pFree;
+	unsigned int m_numNewInSlab;
+	unsigned int m_numSlabs;
+	unsigned int m_used;
+	unsigned int m_peak;
+};
+
+#endif //_C_SLABALLOC_
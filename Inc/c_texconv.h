@@ -0,0 +1,46 @@
+
+#ifndef _C_TEXCONV_
+#define _C_TEXCONV_
+
+//Row converters for 32-bit texture uploads
+//The fastest supported version of each is picked from CPUID when the object is constructed
+//Every version produces bit identical output to the scalar one
+class CTexConv {
+public:
+	enum simd_level_t {
+		SIMD_NONE,
+		SIMD_SSE2,
+		SIMD_SSSE3,
+		SIMD_AVX2
+	};
+
+	typedef void (*pixel_proc_t)(unsigned int *pDst, const unsigned int *pSrc, unsigned int count);
+	typedef void (*palette_proc_t)(unsigned int *pDst, const unsigned char *pSrc, const unsigned int *pPalette, unsigned int count);
+
+public:
+	CTexConv();
+	~CTexConv();
+
+	//Selects the procs for a SIMD level, capped to what the CPU supports
+	void set_simd_level(simd_level_t level);
+
+	inline simd_level_t get_simd_level(void) const {
+		return m_simdLevel;
+	}
+	static simd_level_t detect_simd_level(void);
+	static const char *simd_level_name(simd_level_t level);
+
+	//Plain copy
+	pixel_proc_t pCopy;
+	//Each 32-bit texel times 2, for BGRA7777 to BGRA8888
+	pixel_proc_t pShl1;
+	//Swaps bytes 0 and 2 of each 32-bit texel, for RGBA8 to BGRA8
+	pixel_proc_t pSwapRB;
+	//Looks up each 8-bit index in a 256 entry 32-bit palette
+	palette_proc_t pPalette;
+
+private:
+	simd_level_t m_simdLevel;
+};
+
+#endif //_C_TEXCONV_
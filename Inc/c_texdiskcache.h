@@ -0,0 +1,104 @@
+
+#ifndef _C_TEXDISKCACHE_
+#define _C_TEXDISKCACHE_
+
+#include <unordered_map>
+
+//Pack file of converted texture data, keyed by a 64-bit content hash
+//Records are appended to the end of the file and never rewritten
+//The index is rebuilt from the record headers when the file is opened
+//Each header has a magic and its own checksum, the file is cut off at the first header that fails them
+//Record data is read through a mapped view, so a hit only costs the checksum and the copy out
+class CTexDiskCache {
+public:
+	CTexDiskCache();
+	~CTexDiskCache();
+
+	//Opens or creates the pack file, a file with a bad header is started over
+	//No more records are written once the file would grow past maxFileSize bytes
+	bool open(const char *pFileName, unsigned long long maxFileSize);
+	void close(void);
+
+	inline bool is_open(void) const {
+		return m_isOpen;
+	}
+
+	inline bool contains(unsigned long long key) const {
+		return m_index.find(key) != m_index.end();
+	}
+
+	//Returns the record data for a key, or 0 if there is no record of exactly size bytes with a valid checksum
+	//The data stays valid until unlock is called, only one record can be locked at a time
+	const unsigned char *lock(unsigned long long key, unsigned int size);
+	void unlock(void);
+
+	//Returns false if the record was not written, an existing key counts as written
+	bool write(unsigned long long key, const void *pData, unsigned int size);
+
+	inline unsigned int num_records(void) const {
+		return (unsigned int)m_index.size();
+	}
+	inline unsigned long long file_size(void) const {
+		return m_endOffset;
+	}
+
+private:
+	enum {
+		PACK_MAGIC = 0x43543944, //'D9TC'
+		PACK_VERSION = 2,
+		RECORD_MAGIC = 0x52435444, //'DTCR'
+
+		RECORD_ALIGN = 16
+	};
+
+	struct pack_header_t {
+		unsigned int magic;
+		unsigned int version;
+		unsigned int reserved[2];
+	};
+	struct record_header_t {
+		unsigned int magic;
+		//Checksum of the fields after it
+		unsigned int headerChecksum;
+		unsigned long long key;
+		unsigned int size;
+		//Checksum of the record data
+		unsigned int checksum;
+	};
+	struct entry_t {
+		unsigned long long offset;
+		unsigned int size;
+		unsigned int checksum;
+	};
+
+	CTexDiskCache(const CTexDiskCache &);
+	CTexDiskCache &operator=(const CTexDiskCache &);
+
+	static unsigned int calc_header_checksum(const record_header_t &recHeader);
+
+	bool read_at(unsigned long long offset, void *pData, unsigned int size);
+	bool write_at(unsigned long long offset, const void *pData, unsigned int size);
+	bool truncate(unsigned long long size);
+	unsigned long long query_file_size(void);
+	const unsigned char *map_view(unsigned long long offset, unsigned int size);
+	void unmap_view(void);
+
+	bool m_isOpen;
+	unsigned long long m_endOffset;
+	unsigned long long m_maxFileSize;
+	std::unordered_map<unsigned long long, entry_t> m_index;
+
+	//Platform file state
+#ifdef _WIN32
+	void *m_hFile;
+	void *m_hMapping;
+	unsigned long long m_mappingSize;
+#else
+	int m_fd;
+#endif
+	unsigned long long m_viewGranularity;
+	void *m_pView;
+	unsigned long long m_viewSize;
+};
+
+#endif //_C_TEXDISKCACHE_
@@ -0,0 +1,83 @@
+#ifndef _C_TEXSHARE_
+#define _C_TEXSHARE_
+
+#include <unordered_map>
+
+//Texture objects of uploaded textures by content hash, so binds with identical contents can share one object
+//Each sharing bind holds its own reference on the object, taken by acquire and dropped by release
+//Only objects whose contents are in place are published, and an object must leave the map before anyone writes to it
+template <class TexObjT> class tex_share_map {
+private:
+	struct entry_t {
+		TexObjT *pTexObj;
+		unsigned int refCount;
+	};
+
+	tex_share_map(const tex_share_map &);
+	tex_share_map &operator=(const tex_share_map &);
+
+public:
+	tex_share_map() {
+	}
+
+	//Takes a reference on the object published for the hash, null if there is none
+	TexObjT *acquire(unsigned long long hash) {
+		typename std::unordered_map<unsigned long long, entry_t>::iterator it = m_map.find(hash);
+		if (it == m_map.end()) {
+			return 0;
+		}
+		it->second.pTexObj->AddRef();
+		it->second.refCount++;
+		return it->second.pTexObj;
+	}
+
+	//Makes an object with finished contents available to identical textures
+	//Returns false if a different object was published for the hash first, the caller then keeps its object to itself
+	bool publish(unsigned long long hash, TexObjT *pTexObj) {
+		typename std::unordered_map<unsigned long long, entry_t>::iterator it = m_map.find(hash);
+		if (it == m_map.end()) {
+			entry_t entry;
+			entry.pTexObj = pTexObj;
+			entry.refCount = 1;
+			m_map.insert(std::make_pair(hash, entry));
+			return true;
+		}
+		return it->second.pTexObj == pTexObj;
+	}
+
+	//True if other users hold the same object
+	bool is_shared(unsigned long long hash, const TexObjT *pTexObj) const {
+		typename std::unordered_map<unsigned long long, entry_t>::const_iterator it = m_map.find(hash);
+		return (it != m_map.end()) && (it->second.pTexObj == pTexObj) && (it->second.refCount > 1);
+	}
+
+	//Drops one user of the object, before it is freed or written to
+	//Returns true if other users still hold it, the caller's reference is then already released and the caller needs a new object to write to
+	//Returns false if the caller was the last user or the object was not published, the caller keeps its reference and the hash no longer finds the object
+	bool release(unsigned long long hash, TexObjT *pTexObj) {
+		typename std::unordered_map<unsigned long long, entry_t>::iterator it = m_map.find(hash);
+		if ((it == m_map.end()) || (it->second.pTexObj != pTexObj)) {
+			return false;
+		}
+		if (--it->second.refCount == 0) {
+			m_map.erase(it);
+			return false;
+		}
+		pTexObj->Release();
+		return true;
+	}
+
+	//Forgets every object, for when every reference was already released with the binds
+	void clear(void) {
+		m_map.clear();
+	}
+
+	unsigned int size(void) const {
+		return (unsigned int)m_map.size();
+	}
+
+private:
+	std::unordered_map<unsigned long long, entry_t> m_map;
+};
+
+#endif //_C_TEXSHARE_
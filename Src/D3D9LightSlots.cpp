@@ -0,0 +1,116 @@
+#include "D3D9LightSlots.h"
+#include "D3D9DrvRTX.h"
+
+#include <set>
+
+void LightSlots::updateActors(const std::vector<AActor*>& actors) {
+	generation++;
+	releasedSlots.clear();
+	newActors.clear();
+
+	// Stamp the slots of actors that are still here and collect the new ones
+	for (AActor* actor : actors) {
+		auto it = actorSlots.find(actor);
+		if (it != actorSlots.end()) {
+			slots[it->second].generation = generation;
+		}
+		else {
+			newActors.push_back(actor);
+		}
+	}
+
+	// Free the slots of any actors that have been removed
+	for (size_t i = 0; i < usedSlots.size(); ) {
+		const int slot = usedSlots[i];
+		Slot& slotInfo = slots[slot];
+		if (slotInfo.generation != generation) {
+			//dout << L"Slot " << slot << L" actor deleted" << std::endl;
+			actorSlots.erase(slotInfo.actor);
+			slotInfo.actor = nullptr;
+			freeSlots.push_back(slot);
+			releasedSlots.push_back(slot);
+			usedSlots[i] = usedSlots.back();
+			usedSlots.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+
+	// Now, add any new actors
+	for (AActor* actor : newActors) {
+		if (actorSlots.count(actor)) {
+			// Listed twice
+			continue;
+		}
+		int slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else if (slots.size() < maxSlots) {
+			slot = (int)slots.size();
+			Slot newSlot{};
+			slots.push_back(newSlot);
+		}
+		else {
+			static std::set<size_t> loggedLightOversizes;
+			if (loggedLightOversizes.insert(actors.size()).second) {
+				debugf(NAME_D3D9DrvRTX, TEXT("No light slots left! Needed %d lights"), actors.size());
+			}
+			break;
+		}
+		Slot& slotInfo = slots[slot];
+		slotInfo.actor = actor;
+		slotInfo.generation = generation;
+		slotInfo.submitted = false;
+		actorSlots.emplace(actor, slot);
+		usedSlots.push_back(slot);
+		//dout << L"Slot " << slot << L" actor added " << actor->GetName() << std::endl;
+	}
+}
+
+void LightSlots::destroyFreedRemixLights(const remixapi_Interface& remix) {
+	for (int slot : releasedSlots) {
+		Slot& slotInfo = slots[slot];
+		if (slotInfo.actor || !slotInfo.remixHandle) {
+			// Taken by a new light, its handle is replaced when it is drawn
+			continue;
+		}
+		remix.DestroyLight(slotInfo.remixHandle);
+		slotInfo.remixHandle = nullptr;
+	}
+}
+
+bool LightSlots::needsNewRemixLight(const Slot& slotInfo, const LightState& state) const {
+	// Anything but a steady light is animated by GlobalLighting, so it changes every frame
+	return !slotInfo.remixHandle || !slotInfo.submitted || state.type != LT_Steady || state != slotInfo.state;
+}
+
+remixapi_ErrorCode LightSlots::replaceRemixLight(const remixapi_Interface& remix, Slot& slotInfo, const LightState& state, const remixapi_LightInfo& lightInfo) {
+	slotInfo.state = state;
+	slotInfo.submitted = true;
+
+	if (slotInfo.remixHandle) {
+		remix.DestroyLight(slotInfo.remixHandle);
+		slotInfo.remixHandle = nullptr;
+	}
+
+	remixapi_ErrorCode remixErr = remix.CreateLight(&lightInfo, &slotInfo.remixHandle);
+	if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+		slotInfo.remixHandle = nullptr;
+	}
+	return remixErr;
+}
+
+void LightSlots::destroyRemixLights(const remixapi_Interface& remix) {
+	static const std::vector<AActor*> noLights;
+	updateActors(noLights);
+	for (int slot : releasedSlots) {
+		Slot& slotInfo = slots[slot];
+		if (slotInfo.remixHandle) {
+			remix.DestroyLight(slotInfo.remixHandle);
+			slotInfo.remixHandle = nullptr;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#include "D3D9RemixLevelMeshes.h"
+
+remixapi_ErrorCode RemixLevelMeshes::add(
+	const remixapi_Interface& remix,
+	BYTE zone,
+	QWORD hash,
+	const std::vector<remixapi_HardcodedVertex>& vertices,
+	const std::vector<uint32_t>& indices,
+	remixapi_MaterialHandle material,
+	QWORD materialCacheID,
+	RemixMaterialClass materialClass
+) {
+	remixapi_MeshInfoSurfaceTriangles surfaceInfo = {};
+	surfaceInfo.vertices_values = vertices.data();
+	surfaceInfo.vertices_count = vertices.size();
+	surfaceInfo.indices_values = indices.data();
+	surfaceInfo.indices_count = indices.size();
+	surfaceInfo.skinning_hasvalue = false;
+	surfaceInfo.material = material;
+
+	remixapi_MeshInfo meshInfo = {};
+	meshInfo.sType = REMIXAPI_STRUCT_TYPE_MESH_INFO;
+	meshInfo.hash = hash;
+	meshInfo.surfaces_values = &surfaceInfo;
+	meshInfo.surfaces_count = 1;
+
+	LevelMesh levelMesh{};
+	remixapi_ErrorCode remixErr = remix.CreateMesh(&meshInfo, &levelMesh.mesh);
+	if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+		return remixErr;
+	}
+	levelMesh.materialCacheID = materialCacheID;
+	levelMesh.materialClass = materialClass;
+	zoneMeshes[zone].push_back(levelMesh);
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+void RemixLevelMeshes::draw(const remixapi_Interface& remix, BYTE zone) const {
+	remixapi_InstanceInfo instanceInfo = {};
+	instanceInfo.sType = REMIXAPI_STRUCT_TYPE_INSTANCE_INFO;
+	// Level geometry is already in world space
+	instanceInfo.transform = { {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+	} };
+	// D3D doesn't cull level surfaces from either side, so neither should Remix
+	instanceInfo.doubleSided = true;
+
+	for (const LevelMesh& levelMesh : zoneMeshes[zone]) {
+		instanceInfo.mesh = levelMesh.mesh;
+		remix.DrawInstance(&instanceInfo);
+	}
+}
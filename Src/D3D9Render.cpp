@@ -215,13 +215,106 @@ static bool getRenderInterfaceActors(AActor* actor, FSceneNode* frame, std::vect
 }
 #endif  // UTGLR_NO_RENDERITERATOR
 
-void UD3D9Render::onLevelChange(FSceneNode* frame) {
+void UD3D9Render::getLevelPrecacheTextures(FSceneNode* frame, const ModelFacets& modelFacets, std::vector<UD3D9RenderDevice::TexPrecacheEntry>& entries) {
+	std::unordered_set<UTexture*> seenTextures;
+	auto addTexture = [&](UTexture* texture, DWORD flags) {
+		if (!texture || !seenTextures.insert(texture).second) {
+			return;
+		}
+		entries.push_back({ texture->GetIndex(), texture, flags | texture->PolyFlags });
+		// Animated textures cycle through every frame soon enough
+		for (UTexture* next = texture->AnimNext; next && next != texture; next = next->AnimNext) {
+			if (!seenTextures.insert(next).second) {
+				break;
+			}
+			entries.push_back({ next->GetIndex(), next, flags | next->PolyFlags });
+		}
+	};
+
+	// Level surfaces, including the sky zones as they're part of the same model
+	for (const auto& zonePasses : modelFacets.facetPairs) {
+		for (const auto& passFacets : zonePasses) {
+			for (const auto& facetPair : passFacets) {
+				addTexture(facetPair.tex, facetPair.flags);
+			}
+		}
+	}
+
+	// Actor skins and mesh textures
+	for (INT iActor = 0; iActor < frame->Level->Actors.Num(); iActor++) {
+		AActor* actor = frame->Level->Actors(iActor);
+		if (!actor) continue;
+		DWORD flags = getBasePolyFlags(actor);
+		addTexture(actor->Texture, flags);
+		addTexture(actor->Skin, flags);
+#if !KLINGON_HONOR_GUARD
+		for (UTexture* skin : actor->MultiSkins) {
+			addTexture(skin, flags);
+		}
+#endif
+		if (actor->Mesh) {
+			for (INT i = 0; i < actor->Mesh->Textures.Num(); i++) {
+				addTexture(actor->Mesh->GetTexture(i, actor), flags);
+			}
+		}
+		if (actor->IsA(AZoneInfo::StaticClass())) {
+			addTexture(((AZoneInfo*)actor)->EnvironmentMap, 0);
+		}
+	}
+}
+
+void UD3D9Render::createRemixLevelMeshes(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, ModelFacets& modelFacets) {
+	guard(UD3D9Render::createRemixLevelMeshes);
+	int numMeshes = 0;
+	for (int zone = 0; zone < FBspNode::MAX_ZONES; zone++) {
+		for (RPASS pass : {SOLID, NONSOLID}) {
+			SurfKeyBucketVector<UTexture*, SurfaceData>& buckets = modelFacets.facetPairs[zone][pass];
+			std::vector<bool>& remixBuckets = modelFacets.remixMeshBuckets[zone][pass];
+			remixBuckets.assign(buckets.size(), false);
+			for (size_t i = 0; i < buckets.size(); i++) {
+				UTexture* texture = buckets[i].tex;
+				FTextureInfo texInfo;
+#if UNREAL_GOLD_OLDUNREAL
+				texInfo = *texture->GetTexture(-1, d3d9Dev);
+#elif KLINGON_HONOR_GUARD
+				texture->GetInfo(texInfo, frame->Viewport->CurrentTime);
+#else
+				texture->Lock(texInfo, frame->Viewport->CurrentTime, -1, d3d9Dev);
+#endif
+				std::vector<FSurfaceFacet*> facets;
+				facets.reserve(buckets[i].bucket.size());
+				for (const SurfaceData& surface : buckets[i].bucket) {
+					facets.push_back(surface.facet);
+				}
+				remixBuckets[i] = d3d9Dev->createRemixLevelMesh(zone, texInfo, buckets[i].flags, facets, *frame->Level->URL.Map);
+				numMeshes += remixBuckets[i];
+#if !UTGLR_NO_TEXTURE_UNLOCK
+				texture->Unlock(texInfo);
+#endif
+			}
+		}
+	}
+	debugf(NAME_D3D9DrvRTX, TEXT("Registered %d level meshes with RTX Remix"), numMeshes);
+	unguard;
+}
+
+void UD3D9Render::onLevelChange(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev) {
 	currentLevelData.currentLevel = frame->Level;
 	currentLevelData.facetsMemMark.Pop();
 	currentLevelData.facets = ModelFacets();
 	getLevelModelFacets(frame, currentLevelData.facets);
+
+	// Meshes of the last level go first, even if this one doesn't use them
+	d3d9Dev->destroyRemixLevelMeshes();
+
+	if (d3d9Dev->LevelTexturePrecache && !GIsEditor) {
+		std::vector<UD3D9RenderDevice::TexPrecacheEntry> precacheEntries;
+		getLevelPrecacheTextures(frame, currentLevelData.facets, precacheEntries);
+		d3d9Dev->setTexturePrecacheList(std::move(precacheEntries));
+	}
 	currentLevelData.lastLevelTime = frame->Level->TimeSeconds;
 	currentLevelData.anchors.clear();
+	d3d9Dev->clearAnchorGeometry();
 
 	RTXConfigVars remixConfigVars;
 
@@ -230,6 +323,7 @@ void UD3D9Render::onLevelChange(FSceneNode* frame) {
 		currentLevelData.anchors,
 		remixConfigVars
 	);
+	d3d9Dev->updateHashTexBlacklist();
 
 	if (UD3D9RenderDevice::remixInterfaceInitialized) {
 		for (const auto& [key, value] : remixConfigVars) {
@@ -360,9 +454,23 @@ void UD3D9Render::DrawWorld(FSceneNode* frame) {
 #endif
 
 	if (currentLevelData.currentLevel != frame->Level) {
-		onLevelChange(frame);
+		onLevelChange(frame, d3d9Dev);
+	}
+
+	// Level meshes are registered after a level change, and again after a device reset destroyed them
+	if (d3d9Dev->remixLevelMeshesDirty) {
+		d3d9Dev->remixLevelMeshesDirty = false;
+		if (d3d9Dev->UseRemixLevelMeshes && !GIsEditor && UD3D9RenderDevice::remixInterfaceInitialized && UD3D9RenderDevice::remixInterface.CreateMesh) {
+			createRemixLevelMeshes(frame, d3d9Dev, currentLevelData.facets);
+		}
 	}
 
+	// Spread the level's texture uploads over the first frames
+	d3d9Dev->precacheTextures(frame);
+
+	// Each drawn frame marks the lights it can see
+	objs.lightVisible.assign(objs.lights.size(), !d3d9Dev->LightCulling);
+
 	ModelFacets& modelFacets = currentLevelData.facets;
 
 	std::unordered_map<UTexture*, FTextureInfo> lockedTextures;
@@ -391,18 +499,28 @@ void UD3D9Render::DrawWorld(FSceneNode* frame) {
 
 	FLOAT deltaTime = frame->Level->TimeSeconds - currentLevelData.lastLevelTime;
 	currentLevelData.lastLevelTime = frame->Level->TimeSeconds;
-	for (std::unique_ptr<RTXAnchor>& anchor : currentLevelData.anchors) {
-		if (!anchor->isPausable() || FString(frame->Level->GetLevelInfo()->Pauser) == TEXT("")) {
-			anchor->Tick(deltaTime);
-		}
-		d3d9Dev->renderRTXAnchor(*anchor, viewport->Actor->Level->DefaultTexture);
+	bool paused = FString(frame->Level->GetLevelInfo()->Pauser) != TEXT("");
+	currentLevelData.anchors.tick(deltaTime, paused);
+	for (size_t i = 0; i < currentLevelData.anchors.size(); i++) {
+		d3d9Dev->addRTXAnchor(currentLevelData.anchors, i);
 	}
 
 	for (ASkyZoneInfo* zone : skyZones) {
-		d3d9Dev->renderSkyZoneAnchor(zone, &frame->Coords.Origin);
+		d3d9Dev->addSkyZoneAnchor(zone, &frame->Coords.Origin);
+	}
+	d3d9Dev->renderAnchors(viewport->Actor->Level->DefaultTexture);
+
+	if (d3d9Dev->LightCulling) {
+		size_t numVisible = 0;
+		for (size_t i = 0; i < objs.lights.size(); i++) {
+			if (objs.lightVisible[i]) {
+				objs.lights[numVisible++] = objs.lights[i];
+			}
+		}
+		objs.lights.resize(numVisible);
 	}
 
-	d3d9Dev->renderLights(frame, objs.lights);
+	d3d9Dev->renderLights(frame, objs.lights, objs.visibleZones);
 
 	d3d9Dev->endWorldDraw(frame);
 
@@ -435,6 +553,51 @@ void UD3D9Render::DrawWorld(FSceneNode* frame) {
 	unguard;
 }
 
+void UD3D9Render::cullLights(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, FrameActors& objs, QWORD visibleZoneMask) {
+	guard(UD3D9Render::cullLights);
+	// View space side planes of the frustum, a point is inside when it is in front of all of them
+	bool testFrustum = !frame->Viewport->IsOrtho();
+	FVector sidePlanes[4];
+	if (testFrustum) {
+		sidePlanes[0] = (FVector(-frame->FX2 * frame->RProj.Z, 0, 1) ^ FVector(0, -1, 0)).SafeNormal();
+		sidePlanes[1] = (FVector(frame->FX2 * frame->RProj.Z, 0, 1) ^ FVector(0, +1, 0)).SafeNormal();
+		sidePlanes[2] = (FVector(0, -frame->FY2 * frame->RProj.Z, 1) ^ FVector(+1, 0, 0)).SafeNormal();
+		sidePlanes[3] = (FVector(0, frame->FY2 * frame->RProj.Z, 1) ^ FVector(-1, 0, 0)).SafeNormal();
+	}
+
+	for (size_t i = 0; i < objs.lights.size(); i++) {
+		if (objs.lightVisible[i]) {
+			continue;
+		}
+		AActor* light = objs.lights[i];
+		// Lights outside any zone are never culled by zone
+		BYTE zone = light->Region.ZoneNumber;
+		if (zone != 0 && !((visibleZoneMask >> zone) & 1)) {
+			continue;
+		}
+		if (testFrustum) {
+			// The margin lets lights just off screen still bounce light into view
+			FLOAT reach = 25.0f * (light->LightRadius + 1) + d3d9Dev->LightCullMargin;
+			FVector viewPos = light->Location.TransformPointBy(frame->Coords);
+			if (viewPos.Z < -reach) {
+				continue;
+			}
+			bool inside = true;
+			for (const FVector& plane : sidePlanes) {
+				if ((plane | viewPos) < -reach) {
+					inside = false;
+					break;
+				}
+			}
+			if (!inside) {
+				continue;
+			}
+		}
+		objs.lightVisible[i] = true;
+	}
+	unguard;
+}
+
 void UD3D9Render::drawFrame(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, ModelFacets& modelFacets, FrameActors& objs, std::unordered_map<UTexture*, FTextureInfo>& lockedTextures, bool isSky) {
 	guard(UD3D9Render::drawFrame);
 	// Add all actors in view and also any in zones that are visible
@@ -488,16 +651,32 @@ void UD3D9Render::drawFrame(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, Model
 	// Add the zones as a set to easily iterate on it
 	std::unordered_set<INT> visibleZones;
 	visibleZoneMask = visibleZoneBits.to_ullong();
+	objs.visibleZones |= visibleZoneMask;
+	if (d3d9Dev->LightCulling) {
+		cullLights(frame, d3d9Dev, objs, visibleZoneMask);
+	}
 	while (visibleZoneMask) {
 		DWORD zone = std::countr_zero(visibleZoneMask);
 		visibleZones.insert(zone);
 		visibleZoneMask &= (visibleZoneMask - 1);
 	}
 
+	// Sky zones are drawn from another view, so they always go through D3D
+	if (!isSky) {
+		for (int zone : visibleZones) {
+			if (!d3d9Dev->remixLevelMeshes.empty(zone)) {
+				d3d9Dev->drawRemixLevelMeshes(zone);
+			}
+		}
+	}
+
 	for (RPASS pass : {SOLID, NONSOLID}) {
 		DecalMap decalMap;
 		for (int zone : visibleZones) {
-			for (auto& facetPair : modelFacets.facetPairs[zone][pass]) {
+			const bool remixZone = !isSky && !d3d9Dev->remixLevelMeshes.empty(zone);
+			SurfKeyBucketVector<UTexture*, SurfaceData>& buckets = modelFacets.facetPairs[zone][pass];
+			for (size_t bucketIndex = 0; bucketIndex < buckets.size(); bucketIndex++) {
+				auto& facetPair = buckets[bucketIndex];
 				UTexture* texture = facetPair.tex;
 				DWORD flags = facetPair.flags;
 				std::vector<SurfaceData>& surfaces = facetPair.bucket;
@@ -528,7 +707,9 @@ void UD3D9Render::drawFrame(FSceneNode* frame, UD3D9RenderDevice* d3d9Dev, Model
 					facets.push_back(surface.facet);
 				}
 
-				d3d9Dev->drawLevelSurfaces(frame, surfaceInfo, facets);
+				if (!remixZone || !modelFacets.remixMeshBuckets[zone][pass][bucketIndex]) {
+					d3d9Dev->drawLevelSurfaces(frame, surfaceInfo, facets);
+				}
 #if !UTGLR_NO_DECALS
 				if (frame->Viewport->GetOuterUClient()->Decals) {
 					for (const SurfaceData& surface : surfaces) {
@@ -62,6 +62,8 @@ TODO:
 
 #include <fstream>
 #include <set>
+#include <chrono>
+#include <algorithm>
 
 #pragma warning(disable : 4018)
 #pragma warning(disable : 4245)
@@ -76,6 +78,9 @@ static const char *g_d3d9DllName = "d3d9d.dll";
 static const char *g_d3d9DllName = "d3d9.dll";
 #endif
 
+//Pack file of converted textures, in the working directory
+static const char *g_texDiskCacheFileName = "D3D9DrvRTX_TexCache.bin";
+
 //#define UTGLR_DEBUG_SHOW_CALL_COUNTS
 
 static const TCHAR *g_pSection = TEXT("D3D9DrvRTX.D3D9RenderDevice");
@@ -304,14 +309,33 @@ void UD3D9RenderDevice::StaticConstructor() {
 	SC_AddIntConfigParam(TEXT("DynamicTexIdRecycleLevel"), CPP_PROPERTY_LOCAL(DynamicTexIdRecycleLevel), 100);
 	SC_AddBoolConfigParam(0,  TEXT("TexDXT1ToDXT3"), CPP_PROPERTY_LOCAL(TexDXT1ToDXT3), 0);
 	SC_AddIntConfigParam(TEXT("FrameRateLimit"), CPP_PROPERTY_LOCAL(FrameRateLimit), 0);
-	SC_AddBoolConfigParam(4, TEXT("SmoothMaskedTextures"), CPP_PROPERTY_LOCAL(SmoothMaskedTextures), 0);
-	SC_AddBoolConfigParam(3, TEXT("NonSolidTranslucentHack"), CPP_PROPERTY_LOCAL(NonSolidTranslucentHack), 1);
-	SC_AddBoolConfigParam(2, TEXT("EnableSkyBoxRendering"), CPP_PROPERTY_LOCAL(EnableSkyBoxRendering), 1);
-	SC_AddBoolConfigParam(1, TEXT("EnableSkyBoxAnchors"), CPP_PROPERTY_LOCAL(EnableSkyBoxAnchors), 0);
-	SC_AddBoolConfigParam(0, TEXT("EnableHashTextures"), CPP_PROPERTY_LOCAL(EnableHashTextures), 0);
+	SC_AddBoolConfigParam(5, TEXT("SmoothMaskedTextures"), CPP_PROPERTY_LOCAL(SmoothMaskedTextures), 0);
+	SC_AddBoolConfigParam(4, TEXT("NonSolidTranslucentHack"), CPP_PROPERTY_LOCAL(NonSolidTranslucentHack), 1);
+	SC_AddBoolConfigParam(3, TEXT("EnableSkyBoxRendering"), CPP_PROPERTY_LOCAL(EnableSkyBoxRendering), 1);
+	SC_AddBoolConfigParam(2, TEXT("EnableSkyBoxAnchors"), CPP_PROPERTY_LOCAL(EnableSkyBoxAnchors), 0);
+	SC_AddBoolConfigParam(1, TEXT("EnableHashTextures"), CPP_PROPERTY_LOCAL(EnableHashTextures), 0);
+	SC_AddBoolConfigParam(0, TEXT("AsyncTextureUpload"), CPP_PROPERTY_LOCAL(AsyncTextureUpload), 0);
+	SC_AddFloatConfigParam(TEXT("TexUploadBudgetMs"), CPP_PROPERTY_LOCAL(TexUploadBudgetMs), 2.0f);
+	SC_AddBoolConfigParam(0, TEXT("TexDiskCache"), CPP_PROPERTY_LOCAL(TexDiskCache), 0);
+	SC_AddIntConfigParam(TEXT("TexDiskCacheMaxMB"), CPP_PROPERTY_LOCAL(TexDiskCacheMaxMB), 1024);
+	SC_AddIntConfigParam(TEXT("TexMemBudgetMB"), CPP_PROPERTY_LOCAL(TexMemBudgetMB), 0);
+	SC_AddIntConfigParam(TEXT("TexMemLowWaterPct"), CPP_PROPERTY_LOCAL(TexMemLowWaterPct), 85);
+	SC_AddBoolConfigParam(0, TEXT("LevelTexturePrecache"), CPP_PROPERTY_LOCAL(LevelTexturePrecache), 1);
+	SC_AddFloatConfigParam(TEXT("TexPrecacheBudgetMs"), CPP_PROPERTY_LOCAL(TexPrecacheBudgetMs), 4.0f);
+	SC_AddBoolConfigParam(0, TEXT("TexDedup"), CPP_PROPERTY_LOCAL(TexDedup), 1);
 	SC_AddFloatConfigParam(TEXT("LightMultiplier"), CPP_PROPERTY_LOCAL(LightMultiplier), 4000.0f);
 	SC_AddFloatConfigParam(TEXT("LightRadiusDivisor"), CPP_PROPERTY_LOCAL(LightRadiusDivisor), 70.0f);
 	SC_AddFloatConfigParam(TEXT("LightRadiusExponent"), CPP_PROPERTY_LOCAL(LightRadiusExponent), 0.55f);
+	SC_AddIntConfigParam(TEXT("LightBudget"), CPP_PROPERTY_LOCAL(LightBudget), 0);
+	SC_AddBoolConfigParam(0, TEXT("LightClustering"), CPP_PROPERTY_LOCAL(LightClustering), 0);
+	SC_AddFloatConfigParam(TEXT("LightClusterDistance"), CPP_PROPERTY_LOCAL(LightClusterDistance), 256.0f);
+	SC_AddIntConfigParam(TEXT("LightClusterMaxRadius"), CPP_PROPERTY_LOCAL(LightClusterMaxRadius), 16);
+	SC_AddBoolConfigParam(0, TEXT("LightCulling"), CPP_PROPERTY_LOCAL(LightCulling), 1);
+	SC_AddFloatConfigParam(TEXT("LightCullMargin"), CPP_PROPERTY_LOCAL(LightCullMargin), 512.0f);
+	SC_AddBoolConfigParam(0, TEXT("UseRemixLights"), CPP_PROPERTY_LOCAL(UseRemixLights), 0);
+	SC_AddFloatConfigParam(TEXT("RemixLightSphereScale"), CPP_PROPERTY_LOCAL(RemixLightSphereScale), 0.25f);
+	SC_AddFloatConfigParam(TEXT("RemixLightIntensity"), CPP_PROPERTY_LOCAL(RemixLightIntensity), 0.01f);
+	SC_AddBoolConfigParam(0, TEXT("UseRemixLevelMeshes"), CPP_PROPERTY_LOCAL(UseRemixLevelMeshes), 0);
 
 	SurfaceSelectionColor = FColor(0, 0, 31, 31);
 	//new(GetClass(), TEXT("SurfaceSelectionColor"), RF_Public)UStructProperty(CPP_PROPERTY(SurfaceSelectionColor), TEXT("Options"), CPF_Config, FindObjectChecked<UStruct>(NULL, TEXT("Core.Object.Color"), 1));
@@ -348,6 +372,12 @@ void UD3D9RenderDevice::StaticConstructor() {
 	for (u = 0; u < MAX_TMUNITS; u++) {
 		m_d3dTexCoordBuffer[u] = NULL;
 	}
+	m_d3dIndexBuffer = NULL;
+	m_d3dAnchorVertexColorBuffer = NULL;
+	m_d3dAnchorTexCoordBuffer = NULL;
+	m_anchorBufferSize = 0;
+	anchorBuffersDirty = false;
+	remixLevelMeshesDirty = false;
 
 	//Mark all vertex declarations as not created
 	m_oneColorVertexDecl = NULL;
@@ -445,188 +475,72 @@ void UD3D9RenderDevice::ShutdownFrameRateLimitTimer(void) {
 	return;
 }
 
+//Computes the vertex color for the gouraud colour mode, resolved at compile time
+template <int ColorMode>
+static inline DWORD FASTCALL GouraudVertColor(const UD3D9RenderDevice *pRD, const FTransTexture* P) {
+	if constexpr (ColorMode == UD3D9RenderDevice::GCM_FOGGED) {
+		FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
+		return FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
+	}
+	else if constexpr (ColorMode == UD3D9RenderDevice::GCM_COLORED) {
+		// stijn: needed clamping in 64-bit because Actors with AmbientGlow==0 often had RGBA values above 1
+		return FPlaneTo_BGRClamped_A255(&P->Light);
+	}
 #if UTGLR_USES_ALPHABLEND
-static void FASTCALL Buffer3Verts(UD3D9RenderDevice *pRD, FTransTexture** Pts) {
-	FGLTexCoord *pTexCoordArray = &pRD->m_pTexCoordArray[0][pRD->m_bufferedVerts];
-	FGLVertexColor *pVertexColorArray = &pRD->m_pVertexColorArray[pRD->m_bufferedVerts];
-	pRD->m_bufferedVerts += 3;
-	for (INT i = 0; i < 3; i++) {
-		const FTransTexture* P = *Pts++;
-
-		pTexCoordArray->u = P->U * pRD->TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * pRD->TexInfo[0].VMult;
-		pTexCoordArray++;
-
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		if (pRD->m_requestedColorFlags & UD3D9RenderDevice::CF_FOG_MODE) {
-			FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-
-			pVertexColorArray->color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		}
-		else if (pRD->m_requestedColorFlags & UD3D9RenderDevice::CF_COLOR_ARRAY) {
-			if (pRD->m_gpAlpha > 0)
-				pVertexColorArray->color = FPlaneTo_BGR_Aub(&P->Light, pRD->m_gpAlpha);
-			else
-				pVertexColorArray->color = FPlaneTo_BGR_A255(&P->Light);
-		}
-		else {
-			pVertexColorArray->color = 0xFFFFFFFF;
-		}
-		pVertexColorArray++;
+	else if constexpr (ColorMode == UD3D9RenderDevice::GCM_ALPHA_BLENDED) {
+		if (pRD->m_gpAlpha > 0)
+			return FPlaneTo_BGR_Aub(&P->Light, pRD->m_gpAlpha);
+		else
+			return FPlaneTo_BGR_A255(&P->Light);
 	}
-}
 #endif
+	else {
+		return 0xFFFFFFFF;
+	}
+}
 
-static void FASTCALL Buffer3BasicVerts(UD3D9RenderDevice *pRD, FTransTexture** Pts) {
+//Buffers the fan triangles (0, i - 1, i) for i in [iStart, iEnd) as a triangle list
+//Each point is only converted once, the fan centre and previous point are kept in locals
+template <int ColorMode>
+static void FASTCALL BufferGouraudPolyVerts(UD3D9RenderDevice *pRD, FTransTexture** Pts, INT iStart, INT iEnd) {
 	FGLTexCoord *pTexCoordArray = &pRD->m_pTexCoordArray[0][pRD->m_bufferedVerts];
 	FGLVertexColor *pVertexColorArray = &pRD->m_pVertexColorArray[pRD->m_bufferedVerts];
-	pRD->m_bufferedVerts += 3;
+	pRD->m_bufferedVerts += (iEnd - iStart) * 3;
 	FLOAT UMult = pRD->TexInfo[0].UMult;
 	FLOAT VMult = pRD->TexInfo[0].VMult;
-	for (INT i = 0; i < 3; i++) {
-		const FTransTexture* P = *Pts++;
-
-		pTexCoordArray->u = P->U * UMult;
-		pTexCoordArray->v = P->V * VMult;
-		pTexCoordArray++;
-
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		pVertexColorArray->color = 0xFFFFFFFF;
-		pVertexColorArray++;
-	}
-}
 
-static void FASTCALL Buffer3ColoredVerts(UD3D9RenderDevice *pRD, FTransTexture** Pts) {
-	FGLTexCoord *pTexCoordArray = &pRD->m_pTexCoordArray[0][pRD->m_bufferedVerts];
-	FGLVertexColor *pVertexColorArray = &pRD->m_pVertexColorArray[pRD->m_bufferedVerts];
-	pRD->m_bufferedVerts += 3;
-	for (INT i = 0; i < 3; i++) {
-		const FTransTexture* P = *Pts++;
+	auto convert = [&](const FTransTexture* P, FGLVertexColor& vert, FGLTexCoord& tex) {
+		tex.u = P->U * UMult;
+		tex.v = P->V * VMult;
+		vert.x = P->Point.X;
+		vert.y = P->Point.Y;
+		vert.z = P->Point.Z;
+		vert.color = GouraudVertColor<ColorMode>(pRD, P);
+	};
 
-		pTexCoordArray->u = P->U * pRD->TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * pRD->TexInfo[0].VMult;
-		pTexCoordArray++;
+	FGLVertexColor firstVert, prevVert, curVert;
+	FGLTexCoord firstTex, prevTex, curTex;
+	convert(Pts[0], firstVert, firstTex);
+	convert(Pts[iStart - 1], prevVert, prevTex);
 
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		// stijn: needed clamping in 64-bit because Actors with AmbientGlow==0 often had RGBA values above 1
-		pVertexColorArray->color = FPlaneTo_BGRClamped_A255(&P->Light);
-		//pVertexColorArray->color = UD3D9RenderDevice::FPlaneTo_BGR_A255(&P->Light);
-		pVertexColorArray++;
-	}
-}
+	for (INT i = iStart; i < iEnd; i++) {
+		convert(Pts[i], curVert, curTex);
 
-static void FASTCALL Buffer3FoggedVerts(UD3D9RenderDevice *pRD, FTransTexture** Pts) {
-	FGLTexCoord *pTexCoordArray = &pRD->m_pTexCoordArray[0][pRD->m_bufferedVerts];
-	FGLVertexColor *pVertexColorArray = &pRD->m_pVertexColorArray[pRD->m_bufferedVerts];
-	pRD->m_bufferedVerts += 3;
-	for (INT i = 0; i < 3; i++) {
-		const FTransTexture* P = *Pts++;
+		pVertexColorArray[0] = firstVert;
+		pVertexColorArray[1] = prevVert;
+		pVertexColorArray[2] = curVert;
+		pVertexColorArray += 3;
 
-		pTexCoordArray->u = P->U * pRD->TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * pRD->TexInfo[0].VMult;
-		pTexCoordArray++;
+		pTexCoordArray[0] = firstTex;
+		pTexCoordArray[1] = prevTex;
+		pTexCoordArray[2] = curTex;
+		pTexCoordArray += 3;
 
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-		pVertexColorArray->color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		pVertexColorArray++;
+		prevVert = curVert;
+		prevTex = curTex;
 	}
 }
 
-//Must be called with (NumPts > 3)
-void UD3D9RenderDevice::BufferAdditionalClippedVerts(FTransTexture** Pts, INT NumPts) {
-	INT i;
-
-	i = 3;
-	do {
-		const FTransTexture* P;
-		FGLTexCoord *pTexCoordArray;
-		FGLVertexColor *pVertexColorArray;
-
-		P = Pts[0];
-		pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-		pTexCoordArray->u = P->U * TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * TexInfo[0].VMult;
-		pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		if (m_requestedColorFlags & CF_FOG_MODE) {
-			FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-			pVertexColorArray->color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		}
-		else if (m_requestedColorFlags & CF_COLOR_ARRAY) {
-#ifdef RUNE
-			pVertexColorArray->color = FPlaneTo_BGR_Aub(&P->Light, m_gpAlpha);
-#else
-			pVertexColorArray->color = FPlaneTo_BGRClamped_A255(&P->Light);
-#endif
-		}
-		else {
-			pVertexColorArray->color = 0xFFFFFFFF;
-		}
-		m_bufferedVerts++;
-
-		P = Pts[i - 1];
-		pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-		pTexCoordArray->u = P->U * TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * TexInfo[0].VMult;
-		pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		if (m_requestedColorFlags & CF_FOG_MODE) {
-			FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-			pVertexColorArray->color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		}
-		else if (m_requestedColorFlags & CF_COLOR_ARRAY) {
-#ifdef RUNE
-			pVertexColorArray->color = FPlaneTo_BGR_Aub(&P->Light, m_gpAlpha);
-#else
-			pVertexColorArray->color = FPlaneTo_BGRClamped_A255(&P->Light);
-#endif
-		}
-		else {
-			pVertexColorArray->color = 0xFFFFFFFF;
-		}
-		m_bufferedVerts++;
-
-		P = Pts[i];
-		pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-		pTexCoordArray->u = P->U * TexInfo[0].UMult;
-		pTexCoordArray->v = P->V * TexInfo[0].VMult;
-		pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-		pVertexColorArray->x = P->Point.X;
-		pVertexColorArray->y = P->Point.Y;
-		pVertexColorArray->z = P->Point.Z;
-		if (m_requestedColorFlags & CF_FOG_MODE) {
-			FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-			pVertexColorArray->color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		}
-		else if (m_requestedColorFlags & CF_COLOR_ARRAY) {
-#ifdef RUNE
-			pVertexColorArray->color = FPlaneTo_BGR_Aub(&P->Light, m_gpAlpha);
-#else
-			pVertexColorArray->color = FPlaneTo_BGRClamped_A255(&P->Light);
-#endif
-		}
-		else {
-			pVertexColorArray->color = 0xFFFFFFFF;
-		}
-		m_bufferedVerts++;
-	} while (++i < NumPts);
-
-	return;
-}
-
 
 UBOOL UD3D9RenderDevice::FailedInitf(const TCHAR* Fmt, ...) {
 	TCHAR TempStr[4096];
@@ -645,6 +559,11 @@ void UD3D9RenderDevice::Exit() {
 		UnsetRes();
 	}
 
+	//Make sure the texture conversion worker is gone
+	StopTexConvertWorker();
+
+	m_texDiskCache.close();
+
 	//Timer shutdown
 	ShutdownFrameRateLimitTimer();
 
@@ -1067,6 +986,9 @@ void UD3D9RenderDevice::UnsetRes() {
 	Flush(1);
 #endif
 
+	//Stop the texture conversion worker
+	StopTexConvertWorker();
+
 	//Free fixed textures if they were allocated
 	if (m_pNoTexObj) {
 		m_pNoTexObj->Release();
@@ -1185,6 +1107,16 @@ void UD3D9RenderDevice::InitPermanentResourcesAndRenderingState(void) {
 		m_texTempBufferSize[u] = 0;
 	}
 
+	//Indices
+	hResult = m_d3dDevice->CreateIndexBuffer(sizeof(WORD) * INDEX_BUFFER_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, vertexBufferPool, &m_d3dIndexBuffer, NULL);
+	if (FAILED(hResult)) {
+		appErrorf(vertexBufferFailMessage, TEXT("Index"), *ExplainResult(hResult));
+	}
+	hResult = m_d3dDevice->SetIndices(m_d3dIndexBuffer);
+	if (FAILED(hResult)) {
+		appErrorf(TEXT("SetIndices failed: %ls"), *ExplainResult(hResult));
+	}
+
 	//For sprite quad
 	hResult = m_d3dDevice->CreateVertexBuffer(sizeof(FGLVertexColorTex) * 4, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0, vertexBufferPool, &m_d3dQuadBuffer, NULL);
 	if (FAILED(hResult)) {
@@ -1222,6 +1154,8 @@ void UD3D9RenderDevice::InitPermanentResourcesAndRenderingState(void) {
 	for (u = 0; u < MAX_TMUNITS; u++) {
 		m_texCoordBufferNeedsDiscard[u] = false;
 	}
+	m_curIndexBufferPos = 0;
+	m_indexBufferNeedsDiscard = false;
 
 
 	//Set default stream definition
@@ -1236,7 +1170,9 @@ void UD3D9RenderDevice::InitPermanentResourcesAndRenderingState(void) {
 
 	// Init variables.
 	m_bufferedVertsType = BV_TYPE_NONE;
+	m_tileBatchInfoCacheID = 0;
 	m_bufferedVerts = 0;
+	m_bufferedIndices = 0;
 
 	m_curBlendFlags = PF_Occlude;
 	m_smoothMaskedTexturesBit = 0;
@@ -1246,6 +1182,8 @@ void UD3D9RenderDevice::InitPermanentResourcesAndRenderingState(void) {
 	m_requestedColorFlags = 0;
 
 	lightSlots = new LightSlots(m_d3dCaps.MaxActiveLights);
+	remixLightSlots = new LightSlots(0xFFFFFFFF);
+	appMemzero(lastLightSettings, sizeof(lastLightSettings));
 
 	unguard;
 }
@@ -1255,6 +1193,11 @@ void UD3D9RenderDevice::FreePermanentResources(void) {
 
 	delete lightSlots;
 	lightSlots = nullptr;
+	destroyRemixLights();
+	delete remixLightSlots;
+	remixLightSlots = nullptr;
+	destroyRemixLevelMeshes();
+	destroyRemixMaterials();
 
 	unsigned int u;
 	HRESULT hResult;
@@ -1305,6 +1248,24 @@ void UD3D9RenderDevice::FreePermanentResources(void) {
 		m_d3dQuadBuffer->Release();
 		m_d3dQuadBuffer = NULL;
 	}
+	if (m_d3dAnchorVertexColorBuffer) {
+		m_d3dAnchorVertexColorBuffer->Release();
+		m_d3dAnchorVertexColorBuffer = NULL;
+	}
+	if (m_d3dAnchorTexCoordBuffer) {
+		m_d3dAnchorTexCoordBuffer->Release();
+		m_d3dAnchorTexCoordBuffer = NULL;
+	}
+	m_anchorBufferSize = 0;
+	//Written again into the new buffers
+	anchorBuffersDirty = !anchorVerts.empty();
+
+	//Free index buffer
+	m_d3dDevice->SetIndices(NULL);
+	if (m_d3dIndexBuffer) {
+		m_d3dIndexBuffer->Release();
+		m_d3dIndexBuffer = NULL;
+	}
 
 
 	//Set vertex declaration to something else so that it isn't using a current vertex declaration
@@ -1365,10 +1326,28 @@ UBOOL UD3D9RenderDevice::Init(UViewport* InViewport, INT NewX, INT NewY, INT New
 	NumDevices++;
 
 	// Init this rendering context.
-	m_zeroPrefixBindTrees = m_localZeroPrefixBindTrees;
-	m_nonZeroPrefixBindTrees = m_localNonZeroPrefixBindTrees;
+	m_zeroPrefixBindMap = &m_localZeroPrefixBindMap;
+	m_nonZeroPrefixBindMap = &m_localNonZeroPrefixBindMap;
 	m_nonZeroPrefixBindChain = &m_localNonZeroPrefixBindChain;
 	m_RGBA8TexPool = &m_localRGBA8TexPool;
+	m_pTexConvertActiveJob = NULL;
+	m_texConvertExit = false;
+	m_texResidentBytes = 0;
+	appMemzero(m_texResidentFormatBytes, sizeof(m_texResidentFormatBytes));
+	m_texDedupSavedBytes = 0;
+	texPrecachePos = 0;
+	texPrecacheFrames = 0;
+	texPrecacheMs = 0.0;
+
+	//Open the converted texture cache kept between runs
+	if (TexDiskCache && !m_texDiskCache.is_open()) {
+		if (m_texDiskCache.open(g_texDiskCacheFileName, (unsigned long long)Max(TexDiskCacheMaxMB, 0) << 20)) {
+			debugf(NAME_D3D9DrvRTX, TEXT("Texture disk cache opened with %d records"), m_texDiskCache.num_records());
+		}
+		else {
+			debugf(NAME_D3D9DrvRTX, TEXT("Could not open texture disk cache '%s'"), appFromAnsi(g_texDiskCacheFileName));
+		}
+	}
 
 	Viewport = InViewport;
 
@@ -1389,7 +1368,8 @@ UBOOL UD3D9RenderDevice::Init(UViewport* InViewport, INT NewX, INT NewY, INT New
 	// Default to a state for drawing ui
 	endWorldDraw(nullptr);
 
-	hashTexBlacklist = getHashTexBlacklist();
+	hashTexBlacklistGeneration = 0;
+	updateHashTexBlacklist();
 
 	return 1;
 	unguard;
@@ -1442,6 +1422,13 @@ void UD3D9RenderDevice::Lock(FPlane InFlashScale, FPlane InFlashFog, FPlane Scre
 
 	//Reset stats
 	BindCycles = ImageCycles = ComplexCycles = GouraudCycles = TileCycles = 0;
+	TileCount = TileBatches = TileBufferBytes = 0;
+	TexAsyncQueued = TexAsyncUploaded = TexStalls = 0;
+	TexDiskHits = TexDiskMisses = 0;
+	TexEvictions = TexBudgetEvictions = 0;
+	TexDirtyRows = 0;
+	TexDedupHits = 0;
+	LightClusters = LightsMerged = 0;
 
 #ifdef D3D9_DEBUG
 	m_vbFlushCount = 0;
@@ -1563,12 +1550,8 @@ void UD3D9RenderDevice::Lock(FPlane InFlashScale, FPlane InFlashFog, FPlane Scre
 		m_smoothMaskedTexturesBit = PF_Masked;
 	}
 
-	//Initialize buffer verts proc pointers
-	m_pBuffer3BasicVertsProc = Buffer3BasicVerts;
-	m_pBuffer3ColoredVertsProc = Buffer3ColoredVerts;
-	m_pBuffer3FoggedVertsProc = Buffer3FoggedVerts;
-
-	m_pBuffer3VertsProc = NULL;
+	//Initialize buffer verts proc pointer
+	m_pBufferGouraudVertsProc = NULL;
 
 	// Remember stuff.
 	FlashScale = InFlashScale;
@@ -1711,11 +1694,11 @@ void UD3D9RenderDevice::Unlock(UBOOL Blit) {
 #endif
 	guard(UD3D9RenderDevice::Unlock);
 
-	EndBuffering();
-
 	executeBufferedTileDraws();
 	bufferTileDraws = false;
 
+	EndBuffering();
+
 	SetDefaultStreamState();
 	SetDefaultTextureState();
 
@@ -1761,12 +1744,18 @@ void UD3D9RenderDevice::Unlock(UBOOL Blit) {
 		}
 	}
 
+	//Upload textures converted in the background
+	UploadConvertedTextures();
+
 	//Scan for old textures
 	if (UseTexIdPool) {
 		//Scan for old textures
 		ScanForOldTextures();
 	}
 
+	//Evict least recently used textures if over the memory budget
+	EnforceTexMemBudget();
+
 	//Increment current frame count
 	m_currentFrameCount++;
 
@@ -1814,6 +1803,9 @@ void UD3D9RenderDevice::Flush(UBOOL AllowPrecache) {
 	guard(UD3D9RenderDevice::Flush);
 	unsigned int u;
 
+	//Drop background conversions before the binds they target go away
+	CancelTexConvertJobs();
+
 	if (!m_d3dDevice) {
 		return;
 	}
@@ -1822,35 +1814,41 @@ void UD3D9RenderDevice::Flush(UBOOL AllowPrecache) {
 		m_d3dDevice->SetTexture(u, NULL);
 	}
 
-	for (u = 0; u < NUM_CTTree_TREES; u++) {
-		DWORD_CTTree_t *zeroPrefixBindTree = &m_zeroPrefixBindTrees[u];
-		for (DWORD_CTTree_t::node_t *zpbmPtr = zeroPrefixBindTree->begin(); zpbmPtr != zeroPrefixBindTree->end(); zpbmPtr = zeroPrefixBindTree->next_node(zpbmPtr)) {
-			zpbmPtr->data.pTexObj->Release();
-		}
-		zeroPrefixBindTree->clear(&m_DWORD_CTTree_Allocator);
-	}
+	m_zeroPrefixBindMap->for_each([](DWORD, FCachedTexture *pCT) {
+		delete pCT->pRealtimeShadow;
+		pCT->pTexObj->Release();
+	});
+	m_zeroPrefixBindMap->clear();
 
-	for (u = 0; u < NUM_CTTree_TREES; u++) {
-		QWORD_CTTree_t *nonZeroPrefixBindTree = &m_nonZeroPrefixBindTrees[u];
-		for (QWORD_CTTree_t::node_t *nzpbmPtr = nonZeroPrefixBindTree->begin(); nzpbmPtr != nonZeroPrefixBindTree->end(); nzpbmPtr = nonZeroPrefixBindTree->next_node(nzpbmPtr)) {
-			nzpbmPtr->data.pTexObj->Release();
-		}
-		nonZeroPrefixBindTree->clear(&m_QWORD_CTTree_Allocator);
-	}
+	m_nonZeroPrefixBindMap->for_each([](QWORD, FCachedTexture *pCT) {
+		delete pCT->pRealtimeShadow;
+		pCT->pTexObj->Release();
+	});
+	m_nonZeroPrefixBindMap->clear();
 
 	m_nonZeroPrefixBindChain->mark_as_clear();
 
-	for (TexPoolMap_t::node_t *RGBA8TpPtr = m_RGBA8TexPool->begin(); RGBA8TpPtr != m_RGBA8TexPool->end(); RGBA8TpPtr = m_RGBA8TexPool->next_node(RGBA8TpPtr)) {
-		while (QWORD_CTTree_NodePool_t::node_t *texPoolNodePtr = RGBA8TpPtr->data.try_remove()) {
-			texPoolNodePtr->data.pTexObj->Release();
-			m_QWORD_CTTree_Allocator.free_node(texPoolNodePtr);
+	//Texture objects can be freed and reused after a flush
+	hashTexDecisions.clear();
+
+	m_RGBA8TexPool->for_each([](TexPoolMapKey_t, FCachedTexture *pCT) {
+		for (; pCT != 0; pCT = pCT->pNext) {
+			pCT->pTexObj->Release();
 		}
-	}
-	m_RGBA8TexPool->clear(&m_TexPoolMap_Allocator);
+	});
+	m_RGBA8TexPool->clear();
 
-	while (QWORD_CTTree_NodePool_t::node_t *nzpnpPtr = m_nonZeroPrefixNodePool.try_remove()) {
-		m_QWORD_CTTree_Allocator.free_node(nzpnpPtr);
-	}
+	m_nonZeroPrefixNodePool.mark_as_clear();
+
+	//All records are now unreferenced, return them in one go
+	m_CT_Allocator.release_all();
+
+	m_texResidentBytes = 0;
+	appMemzero(m_texResidentFormatBytes, sizeof(m_texResidentFormatBytes));
+
+	//Every reference on the shared objects was released with the binds above
+	m_texSharedObjs.clear();
+	m_texDedupSavedBytes = 0;
 
 	//Reset current texture ids to hopefully unused values
 	for (u = 0; u < MAX_TMUNITS; u++) {
@@ -2179,49 +2177,82 @@ void UD3D9RenderDevice::DrawFogSurface(FSceneNode* Frame, FFogSurf &FogSurf) {
 	//Set stream state
 	SetDefaultStreamState();
 
-	for (FSavedPoly* Poly = FogSurf.Polys; Poly; Poly = Poly->Next) {
-		INT NumPts = Poly->NumPts;
+	FSavedPoly* Poly = FogSurf.Polys;
+	while (Poly) {
+		//Gather as many polys as will fit in the buffers into one triangle list
+		INT NumPts = 0;
+		INT NumIdx = 0;
+		FSavedPoly* BatchEnd = Poly;
+		for (; BatchEnd; BatchEnd = BatchEnd->Next) {
+			if (BatchEnd->NumPts < 3) continue;
+			INT PolyIdx = (BatchEnd->NumPts - 2) * 3;
+			if (NumPts > 0 && ((NumPts + BatchEnd->NumPts) >= VERTEX_BUFFER_SIZE || (NumIdx + PolyIdx) >= INDEX_BUFFER_SIZE)) {
+				break;
+			}
+			NumPts += BatchEnd->NumPts;
+			NumIdx += PolyIdx;
+		}
+		if (!NumIdx) {
+			break;
+		}
 
-		//Make sure at least NumPts entries are left in the vertex buffers
-		if ((m_curVertexBufferPos + NumPts) >= VERTEX_BUFFER_SIZE) {
+		//Make sure the batch fits in what's left of the vertex and index buffers
+		if ((m_curVertexBufferPos + NumPts) >= VERTEX_BUFFER_SIZE || (m_curIndexBufferPos + NumIdx) >= INDEX_BUFFER_SIZE) {
 			FlushVertexBuffers();
 		}
 
-		//Lock vertexColor and texCoord0 buffers
+		//Lock vertexColor, texCoord0 and index buffers
 		LockVertexColorBuffer(NumPts);
 		LockTexCoordBuffer(0, NumPts);
+		LockIndexBuffer();
 
 		INT Index = 0;
-		for (INT i = 0; i < NumPts; i++) {
-			FTransform* P = Poly->Pts[i];
-
-			Modulate.W = P->Point.Z * RFogDistance;
-			if (Modulate.W > 1.0f) {
-				Modulate.W = 1.0f;
-			}
-			else if (Modulate.W < 0.0f) {
-				Modulate.W = 0.0f;
+		WORD* pIndex = m_pIndexArray;
+		for (; Poly != BatchEnd; Poly = Poly->Next) {
+			INT PolyPts = Poly->NumPts;
+			if (PolyPts < 3) continue;
+
+			//Fan triangulation of the poly
+			for (INT i = 2; i < PolyPts; i++) {
+				*pIndex++ = Index;
+				*pIndex++ = Index + i - 1;
+				*pIndex++ = Index + i;
 			}
 
-			FGLVertexColor &destVertexColor = m_pVertexColorArray[Index];
-			destVertexColor.x = P->Point.X;
-			destVertexColor.y = P->Point.Y;
-			destVertexColor.z = P->Point.Z;
-			destVertexColor.color = FPlaneTo_BGRA(&Modulate);
+			for (INT i = 0; i < PolyPts; i++) {
+				FTransform* P = Poly->Pts[i];
+
+				Modulate.W = P->Point.Z * RFogDistance;
+				if (Modulate.W > 1.0f) {
+					Modulate.W = 1.0f;
+				}
+				else if (Modulate.W < 0.0f) {
+					Modulate.W = 0.0f;
+				}
+
+				FGLVertexColor &destVertexColor = m_pVertexColorArray[Index];
+				destVertexColor.x = P->Point.X;
+				destVertexColor.y = P->Point.Y;
+				destVertexColor.z = P->Point.Z;
+				destVertexColor.color = FPlaneTo_BGRA(&Modulate);
 
-			FGLTexCoord &destTexCoord = m_pTexCoordArray[0][Index];
-			destTexCoord.u = 0.0f;
-			destTexCoord.v = 0.0f;
+				FGLTexCoord &destTexCoord = m_pTexCoordArray[0][Index];
+				destTexCoord.u = 0.0f;
+				destTexCoord.v = 0.0f;
 
-			Index++;
+				Index++;
+			}
 		}
 
-		//Unlock vertexColor and texCoord0 buffers
+		//Unlock vertexColor, texCoord0 and index buffers
 		UnlockVertexColorBuffer();
 		UnlockTexCoordBuffer(0);
+		UnlockIndexBuffer();
 
 		//Draw the triangles
-		m_d3dDevice->DrawPrimitive(D3DPT_TRIANGLEFAN, getVertBufferPos(NumPts), NumPts - 2);
+		UINT baseVertex = getVertBufferPos(NumPts);
+		UINT startIndex = getIndexBufferPos(NumIdx);
+		m_d3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, baseVertex, 0, NumPts, startIndex, NumIdx / 3);
 	}
 
 	if (FogSurf.PolyFlags & PF_Masked) {
@@ -2290,6 +2321,76 @@ void UD3D9RenderDevice::DrawTriangles(FSceneNode* Frame, FTextureInfo& Info, FTr
 		return;
 	}
 	
+	//Submit the unique vertices once along with the indices when they fit in the shared buffers
+	if (NumPts < VERTEX_BUFFER_SIZE && NumIdx < INDEX_BUFFER_SIZE) {
+		EndBufferingExcept(BV_TYPE_INDEXED_TRIS);
+
+		if (needsNewBuffer(PolyFlags, NumPts, &Info) || (m_curIndexBufferPos + m_bufferedIndices + NumIdx) >= INDEX_BUFFER_SIZE) {
+			EndBuffering();
+
+			//Check if vertex buffer flush is required
+			if ((m_curVertexBufferPos + NumPts) >= VERTEX_BUFFER_SIZE || (m_curIndexBufferPos + NumIdx) >= INDEX_BUFFER_SIZE) {
+				FlushVertexBuffers();
+			}
+			//Start indexed triangle buffering
+			StartBuffering(BV_TYPE_INDEXED_TRIS);
+
+			//Update current poly flags
+			m_curPolyFlags = PolyFlags;
+
+			//Set default texture state
+			SetDefaultTextureState();
+
+			SetBlend(PolyFlags);
+			SetTextureNoPanBias(0, Info, PolyFlags);
+
+			if (PolyFlags & PF_Modulated) {
+				m_requestedColorFlags = 0;
+			}
+			else {
+				m_requestedColorFlags = CF_COLOR_ARRAY;
+			}
+
+			//Lock vertexColor, texCoord0 and index buffers
+			LockVertexColorBuffer(NumPts);
+			LockTexCoordBuffer(0, NumPts);
+			LockIndexBuffer();
+
+			//Set stream state
+			SetDefaultStreamState();
+		}
+
+		FGLTexCoord* pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
+		FGLVertexColor* pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
+		for (int i = 0; i < NumPts; i++) {
+			FTransTexture* point = Pts[i];
+
+			pTexCoordArray->u = point->U * TexInfo[0].UMult;
+			pTexCoordArray->v = point->V * TexInfo[0].VMult;
+			pTexCoordArray++;
+
+			pVertexColorArray->x = point->Point.X;
+			pVertexColorArray->y = point->Point.Y;
+			pVertexColorArray->z = point->Point.Z;
+			if (m_requestedColorFlags & CF_COLOR_ARRAY) {
+				pVertexColorArray->color = FPlaneTo_BGRClamped_A255(&point->Light);
+			}
+			pVertexColorArray++;
+		}
+
+		WORD* pIndexArray = &m_pIndexArray[m_bufferedIndices];
+		const WORD indexOffset = static_cast<WORD>(m_bufferedVerts);
+		for (int i = 0; i < NumIdx; i++) {
+			assert(Indices[i] < NumPts);
+			pIndexArray[i] = Indices[i] + indexOffset;
+		}
+
+		m_bufferedVerts += NumPts;
+		m_bufferedIndices += NumIdx;
+		return;
+	}
+
+	//Too big for the shared buffers, expand the indices into the gouraud buffer instead
 	EndBufferingExcept(BV_TYPE_GOURAUD_POLYS);
 
 	if (needsNewBuffer(PolyFlags, NumIdx + 14, &Info)) {
@@ -2352,96 +2453,6 @@ void UD3D9RenderDevice::DrawTriangles(FSceneNode* Frame, FTextureInfo& Info, FTr
 }
 #endif
 
-void UD3D9RenderDevice::DrawGouraudPolygonOld(FSceneNode* Frame, FTextureInfo& Info, FTransTexture** Pts, INT NumPts, DWORD PolyFlags, FSpanBuffer* Span) {
-#ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
-{
-	static int si;
-	dout << L"utd3d9r: DrawGouraudPolygonOld = " << si++ << std::endl;
-}
-#endif
-	guard(UD3D9RenderDevice::DrawGouraudPolygonOld);
-	clockFast(GouraudCycles);
-
-	//Check if should render fog and if vertex specular is supported
-	bool drawFog = (((PolyFlags & (PF_RenderFog | PF_Translucent | PF_Modulated | PF_AlphaBlend)) == PF_RenderFog)) ? true : false;
-
-	//If not drawing fog, disable the PF_RenderFog flag
-	if (!drawFog) {
-		PolyFlags &= ~PF_RenderFog;
-	}
-
-	SetBlend(PolyFlags);
-	SetTextureNoPanBias(0, Info, PolyFlags);
-
-#if UTGLR_USES_ALPHABLEND
-	BYTE alpha = 255;
-	if (PolyFlags & PF_AlphaBlend) {
-		alpha = appRound(Info.Texture->Alpha * 255.0f);
-	}
-#endif
-
-	//Set stream state
-	SetStreamState(m_standardNTextureVertexDecl[0]);
-
-	//Make sure at least NumPts entries are left in the vertex buffers
-	if ((m_curVertexBufferPos + NumPts) >= VERTEX_BUFFER_SIZE) {
-		FlushVertexBuffers();
-	}
-
-	//Lock vertexColor and texCoord0 buffers
-	LockVertexColorBuffer(NumPts);
-	LockTexCoordBuffer(0, NumPts);
-
-	INT Index = 0;
-	for (INT i = 0; i < NumPts; i++) {
-		FTransTexture* P = Pts[i];
-
-		FGLTexCoord &destTexCoord = m_pTexCoordArray[0][Index];
-		destTexCoord.u = P->U * TexInfo[0].UMult;
-		destTexCoord.v = P->V * TexInfo[0].VMult;
-
-		FGLVertexColor &destVertexColor = m_pVertexColorArray[Index];
-		destVertexColor.x = P->Point.X;
-		destVertexColor.y = P->Point.Y;
-		destVertexColor.z = P->Point.Z;
-
-		if (PolyFlags & PF_Modulated) {
-			destVertexColor.color = 0xFFFFFFFF;
-		}
-		else if (drawFog) {
-			FLOAT f255_Times_One_Minus_FogW = 255.0f * (1.0f - P->Fog.W);
-			destVertexColor.color = FPlaneTo_BGRScaled_A255(&P->Light, f255_Times_One_Minus_FogW);
-		}
-		else {
-#ifdef RUNE
-			destVertexColor.color = FPlaneTo_BGR_Aub(&P->Light, alpha);
-#else
-			destVertexColor.color = FPlaneTo_BGRClamped_A255(&P->Light);
-#endif
-		}
-
-		Index++;
-	}
-
-	//Unlock vertexColor and texCoord0 buffers
-	UnlockVertexColorBuffer();
-	UnlockTexCoordBuffer(0);
-
-#ifdef UTGLR_DEBUG_ACTOR_WIREFRAME
-	m_d3dDevice->SetRenderState(D3DRS_FILLMODE, D3DFILL_WIREFRAME);
-#endif
-
-	//Draw the triangles
-	m_d3dDevice->DrawPrimitive(D3DPT_TRIANGLEFAN, getVertBufferPos(NumPts), NumPts - 2);
-
-#ifdef UTGLR_DEBUG_ACTOR_WIREFRAME
-	m_d3dDevice->SetRenderState(D3DRS_FILLMODE, D3DFILL_SOLID);
-#endif
-
-	unclockFast(GouraudCycles);
-	unguard;
-}
-
 void UD3D9RenderDevice::DrawGouraudPolygon(FSceneNode* Frame, FTextureInfo& Info, FTransTexture** Pts, INT NumPts, DWORD PolyFlags, FSpanBuffer* Span) {
 #ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
 {
@@ -2486,233 +2497,112 @@ void UD3D9RenderDevice::DrawGouraudPolygon(FSceneNode* Frame, FTextureInfo& Info
 		return;
 	}
 
-	if (NumPts > 10) {
-		EndBuffering();
-
-		//No need to set default projection state here as DrawGouraudPolygonOld will set its own projection state
-		//No need to set default stream state here as DrawGouraudPolygonOld will set its own stream state
-		SetDefaultTextureState();
-
-		DrawGouraudPolygonOld(Frame, Info, Pts, NumPts, PolyFlags, Span);
-
-		return;
+	//Check if should render fog and if vertex specular is supported
+	//Also set other color flags
+	BYTE colorFlags;
+	if (PolyFlags & PF_Modulated) {
+		colorFlags = 0;
 	}
+	else {
+		colorFlags = CF_COLOR_ARRAY;
 
-	//Check if need to start new poly buffering
-	//Make sure enough entries are left in the vertex buffers
-	//based on the current position when it was locked
-	if (needsNewBuffer(PolyFlags, 14, &Info)) {
-		//Flush any previously buffered gouraud polys
-		EndBuffering();
-
-		//Check if vertex buffer flush is required
-		if ((m_curVertexBufferPos + m_bufferedVerts + NumPts) >= (VERTEX_BUFFER_SIZE - 14)) {
-			FlushVertexBuffers();
+		if (((PolyFlags & (PF_RenderFog | PF_Translucent | PF_Modulated | PF_AlphaBlend)) == PF_RenderFog)) {
+			colorFlags = CF_COLOR_ARRAY | CF_FOG_MODE;
 		}
+	}
 
-		//Start gouraud polygon buffering
-		StartBuffering(BV_TYPE_GOURAUD_POLYS);
+	//If not drawing fog, disable the PF_RenderFog flag
+	if (!(colorFlags & CF_FOG_MODE)) {
+		PolyFlags &= ~PF_RenderFog;
+	}
 
-		//Check if should render fog and if vertex specular is supported
-		//Also set other color flags
-		if (PolyFlags & PF_Modulated) {
-			m_requestedColorFlags = 0;
-		}
-		else {
-			m_requestedColorFlags = CF_COLOR_ARRAY;
+	//Triangles of the fan are appended to the shared triangle list batch,
+	//polys too big for what's left of the vertex buffer get split across batches
+	INT i = 2;
+	while (i < NumPts) {
+		//Check if need to start new poly buffering
+		if (needsNewBuffer(PolyFlags, 3, &Info)) {
+			//Flush any previously buffered gouraud polys
+			EndBuffering();
 
-			if (((PolyFlags & (PF_RenderFog | PF_Translucent | PF_Modulated | PF_AlphaBlend)) == PF_RenderFog)) {
-				m_requestedColorFlags = CF_COLOR_ARRAY | CF_FOG_MODE;
+			//Check if vertex buffer flush is required
+			if ((m_curVertexBufferPos + (NumPts - i) * 3) >= VERTEX_BUFFER_SIZE) {
+				FlushVertexBuffers();
 			}
-		}
 
-		//If not drawing fog, disable the PF_RenderFog flag
-		if (!(m_requestedColorFlags & CF_FOG_MODE)) {
-			PolyFlags &= ~PF_RenderFog;
-		}
+			//Start gouraud polygon buffering
+			StartBuffering(BV_TYPE_GOURAUD_POLYS);
 
-		//Update current poly flags
-		m_curPolyFlags = PolyFlags;
+			m_requestedColorFlags = colorFlags;
 
+			//Update current poly flags
+			m_curPolyFlags = PolyFlags;
 
-		//Set default texture state
-		SetDefaultTextureState();
 
-		SetBlend(PolyFlags);
+			//Set default texture state
+			SetDefaultTextureState();
+
+			SetBlend(PolyFlags);
 
-		// stijn: Support alphablended decal drawing. This is a backport from 227
+			// stijn: Support alphablended decal drawing. This is a backport from 227
 #if UTGLR_USES_ALPHABLEND
-		if ((PolyFlags & (PF_AlphaBlend)) && (Info.Texture->PolyFlags & PF_Modulated))
-			SetBlend(Info.Texture->PolyFlags);
+			if ((PolyFlags & (PF_AlphaBlend)) && (Info.Texture->PolyFlags & PF_Modulated))
+				SetBlend(Info.Texture->PolyFlags);
 #endif
-		
-		SetTextureNoPanBias(0, Info, PolyFlags);
 
-		//Lock vertexColor and texCoord0 buffers
-		//Lock secondary color buffer if fog
-		LockVertexColorBuffer(NumPts);
-		LockTexCoordBuffer(0, NumPts);
+			SetTextureNoPanBias(0, Info, PolyFlags);
 
-		//Set stream state
-		SetStreamState(m_standardNTextureVertexDecl[0]);
+			//Lock vertexColor and texCoord0 buffers
+			LockVertexColorBuffer(3);
+			LockTexCoordBuffer(0, 3);
 
-		//Select a buffer verts proc
-		if (m_requestedColorFlags & CF_FOG_MODE) {
-			m_pBuffer3VertsProc = m_pBuffer3FoggedVertsProc;
-		}
-		else if (m_requestedColorFlags & CF_COLOR_ARRAY) {
-			m_pBuffer3VertsProc = m_pBuffer3ColoredVertsProc;
-		}
-		else {
-			m_pBuffer3VertsProc = m_pBuffer3BasicVertsProc;
-		}
-#if UTGLR_USES_ALPHABLEND
-		m_gpAlpha = 255;
-		if (PolyFlags & PF_AlphaBlend) {
-			m_gpAlpha = appRound(Info.Texture->Alpha * 255.0f);
-			m_pBuffer3VertsProc = Buffer3Verts;
-		}
-#endif
-	}
-
-	//Buffer 3 vertices from the first (and perhaps only) triangle
-	(m_pBuffer3VertsProc)(this, Pts);
-
-	if (NumPts > 3) {
-		//Buffer additional vertices from a clipped triangle
-		BufferAdditionalClippedVerts(Pts, NumPts);
-	}
-
-	unguard;
-}
+			//Set stream state
+			SetStreamState(m_standardNTextureVertexDecl[0]);
 
-void UD3D9RenderDevice::DrawTile(FSceneNode* Frame, FTextureInfo& Info, FLOAT X, FLOAT Y, FLOAT XL, FLOAT YL, FLOAT U, FLOAT V, FLOAT UL, FLOAT VL, FSpanBuffer* Span, FLOAT Z, FPlane Color, FPlane Fog, DWORD PolyFlags) {
-#ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
-{
-	static int si;
-	if (bufferTileDraws) {
-		dout << L"utd3d9r: DrawTile = " << si++ << L"; buffererd " << bufferedTileDraws.size() << std::endl;
-	} else {
-		dout << L"utd3d9r: DrawTile = " << si++ << std::endl;
-	}
-}
+			//Select a buffer verts proc
+			if (m_requestedColorFlags & CF_FOG_MODE) {
+				m_pBufferGouraudVertsProc = BufferGouraudPolyVerts<GCM_FOGGED>;
+			}
+			else if (m_requestedColorFlags & CF_COLOR_ARRAY) {
+				m_pBufferGouraudVertsProc = BufferGouraudPolyVerts<GCM_COLORED>;
+			}
+			else {
+				m_pBufferGouraudVertsProc = BufferGouraudPolyVerts<GCM_WHITE>;
+			}
+#if UTGLR_USES_ALPHABLEND
+			m_gpAlpha = 255;
+			if (PolyFlags & PF_AlphaBlend) {
+				m_gpAlpha = appRound(Info.Texture->Alpha * 255.0f);
+				if (m_requestedColorFlags & CF_COLOR_ARRAY) {
+					m_pBufferGouraudVertsProc = BufferGouraudPolyVerts<GCM_ALPHA_BLENDED>;
+				}
+			}
 #endif
-	guard(UD3D9RenderDevice::DrawTile);
-
-	if (bufferTileDraws) {
-		TileFuncCall& call = bufferedTileDraws.emplace_back();
-		// And we pray that the pointers in here don't go stale!
-		call.frame = *Frame;
-		call.texInfo = Info;
-		call.X = X;
-		call.Y = Y;
-		call.XL = XL;
-		call.YL = YL;
-		call.U = U;
-		call.V = V;
-		call.UL = UL;
-		call.VL = VL;
-		call.Z = Z;
-		call.Color = Color;
-		call.Fog = Fog;
-		call.PolyFlags = PolyFlags;
-		return;
-	}
-
-	EndBufferingExcept(BV_TYPE_TILES);
-
-	FLOAT RPX1 = X + Frame->XB;
-	FLOAT RPX2 = RPX1 + XL;
-	FLOAT RPY1 = Y + Frame->YB;
-	FLOAT RPY2 = RPY1 + YL;
-
-	Z = 0.5f;
-
-	//Hit select path
-	if (m_HitData) {
-		CGClip::vec3_t triPts[3];
-
-		triPts[0].x = RPX1;
-		triPts[0].y = RPY1;
-		triPts[0].z = Z;
-
-		triPts[1].x = RPX2;
-		triPts[1].y = RPY1;
-		triPts[1].z = Z;
-
-		triPts[2].x = RPX2;
-		triPts[2].y = RPY2;
-		triPts[2].z = Z;
-
-		m_gclip.SelectDrawTri(Frame, triPts);
-
-		triPts[1].y = RPY2;
-		triPts[2].x = RPX1;
-		m_gclip.SelectDrawTri(Frame, triPts);
-
-		return;
-	}
-
-
-	//Check if need to start new tile buffering
-	if (needsNewBuffer(PolyFlags, 6, &Info)) {
-		//Flush any previously buffered tiles
-		EndBuffering();
-
-		//Check if vertex buffer flush is required
-		if ((m_curVertexBufferPos + m_bufferedVerts) >= (VERTEX_BUFFER_SIZE - 6)) {
-			FlushVertexBuffers();
 		}
 
-		//Start tile buffering
-		StartBuffering(BV_TYPE_TILES);
-
-		//Update current poly flags (before possible local modification)
-		m_curPolyFlags = PolyFlags;
-
-		//Set default texture state
-		SetDefaultTextureState();
-
-		SetBlend(PolyFlags, true);
-		SetTextureNoPanBias(0, Info, PolyFlags);
-
-		if (PolyFlags & PF_Modulated) {
-			m_requestedColorFlags = 0;
-		}
-		else {
-			m_requestedColorFlags = CF_COLOR_ARRAY;
+		//Buffer as many of the triangles as will fit
+		INT trisToBuffer = (VERTEX_BUFFER_SIZE - 1 - m_curVertexBufferPos - m_bufferedVerts) / 3;
+		if (trisToBuffer > NumPts - i) {
+			trisToBuffer = NumPts - i;
 		}
-
-		//Lock vertexColor and texCoord0 buffers
-		LockVertexColorBuffer(6);
-		LockTexCoordBuffer(0, 6);
-
-		//Set stream state
-		SetDefaultStreamState();
+		(m_pBufferGouraudVertsProc)(this, Pts, i, i + trisToBuffer);
+		i += trisToBuffer;
 	}
 
-	//Get tile color
-	DWORD tileColor;
-	tileColor = 0xFFFFFFFF;
-	if (!(PolyFlags & PF_Modulated)) {
-#if UTGLR_USES_ALPHABLEND
-		if (PolyFlags & PF_AlphaBlend) {
-			if (Info.Texture->Alpha > 0.f)
-				Color.W = Info.Texture->Alpha;
-			tileColor = FPlaneTo_BGRAClamped(&Color);
-		}
-		else {
-			tileColor = FPlaneTo_BGRClamped_A255(&Color);
-		}
-#else
-		tileColor = FPlaneTo_BGRClamped_A255(&Color);
-#endif
-	}
+	unguard;
+}
 
-	//Buffer the tile
+inline void FASTCALL UD3D9RenderDevice::BufferTileQuad(const BufferedTile& tile, FLOAT XB, FLOAT YB) {
 	FGLVertexColor *pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
 	FGLTexCoord *pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
 
+	const FLOAT Z = 0.5f;
+	FLOAT RPX1 = tile.X + XB;
+	FLOAT RPX2 = RPX1 + tile.XL;
+	FLOAT RPY1 = tile.Y + YB;
+	FLOAT RPY2 = RPY1 + tile.YL;
+	DWORD tileColor = tile.color;
+
 	pVertexColorArray[0].x = RPX1;
 	pVertexColorArray[0].y = RPY1;
 	pVertexColorArray[0].z = Z;
@@ -2746,10 +2636,10 @@ void UD3D9RenderDevice::DrawTile(FSceneNode* Frame, FTextureInfo& Info, FLOAT X,
 	FLOAT TexInfoUMult = TexInfo[0].UMult;
 	FLOAT TexInfoVMult = TexInfo[0].VMult;
 
-	FLOAT SU1 = (U) * TexInfoUMult;
-	FLOAT SU2 = (U + UL) * TexInfoUMult;
-	FLOAT SV1 = (V) * TexInfoVMult;
-	FLOAT SV2 = (V + VL) * TexInfoVMult;
+	FLOAT SU1 = (tile.U) * TexInfoUMult;
+	FLOAT SU2 = (tile.U + tile.UL) * TexInfoUMult;
+	FLOAT SV1 = (tile.V) * TexInfoVMult;
+	FLOAT SV2 = (tile.V + tile.VL) * TexInfoVMult;
 
 	pTexCoordArray[0].u = SU1;
 	pTexCoordArray[0].v = SV1;
@@ -2770,6 +2660,240 @@ void UD3D9RenderDevice::DrawTile(FSceneNode* Frame, FTextureInfo& Info, FLOAT X,
 	pTexCoordArray[5].v = SV2;
 
 	m_bufferedVerts += 6;
+}
+
+void UD3D9RenderDevice::DrawTile(FSceneNode* Frame, FTextureInfo& Info, FLOAT X, FLOAT Y, FLOAT XL, FLOAT YL, FLOAT U, FLOAT V, FLOAT UL, FLOAT VL, FSpanBuffer* Span, FLOAT Z, FPlane Color, FPlane Fog, DWORD PolyFlags) {
+#ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
+{
+	static int si;
+	if (bufferTileDraws) {
+		dout << L"utd3d9r: DrawTile = " << si++ << L"; buffererd " << bufferedTiles.size() << std::endl;
+	} else {
+		dout << L"utd3d9r: DrawTile = " << si++ << std::endl;
+	}
+}
+#endif
+	guard(UD3D9RenderDevice::DrawTile);
+
+	//Get tile color
+	DWORD tileColor;
+	tileColor = 0xFFFFFFFF;
+	if (!(PolyFlags & PF_Modulated)) {
+#if UTGLR_USES_ALPHABLEND
+		if (PolyFlags & PF_AlphaBlend) {
+			if (Info.Texture->Alpha > 0.f)
+				Color.W = Info.Texture->Alpha;
+			tileColor = FPlaneTo_BGRAClamped(&Color);
+		}
+		else {
+			tileColor = FPlaneTo_BGRClamped_A255(&Color);
+		}
+#else
+		tileColor = FPlaneTo_BGRClamped_A255(&Color);
+#endif
+	}
+
+	BufferedTile tile;
+	tile.X = X;
+	tile.Y = Y;
+	tile.XL = XL;
+	tile.YL = YL;
+	tile.U = U;
+	tile.V = V;
+	tile.UL = UL;
+	tile.VL = VL;
+	tile.color = tileColor;
+	tile.polyFlags = PolyFlags;
+
+	if (!bufferTileDraws) {
+		// Glyph run fast path, text draws one tile per character from the same font page.
+		// If the tile carries on the open tile batch then append it without redoing the state setup.
+		// The batch's texture was checked when it was started, so only the raw cache ID needs comparing.
+		// A realtime texture that changed has to go through SetTexture to be uploaded again.
+		if (m_bufferedVertsType == BV_TYPE_TILES && m_bufferedVerts > 0 && !m_HitData
+			&& Info.CacheID == m_tileBatchInfoCacheID && !Info.bRealtimeChanged && PolyFlags == m_curPolyFlags
+			&& (m_curVertexBufferPos + m_bufferedVerts + 6) < VERTEX_BUFFER_SIZE) {
+			BufferTileQuad(tile, Frame->XB, Frame->YB);
+			TileCount++;
+			return;
+		}
+		tile.frameIdx = 0;
+		tile.texIdx = 0;
+		DrawTileRun(Frame, Info, &tile, 1);
+		return;
+	}
+
+	// Flush if the shared frame or texture indices would overflow
+	if (bufferedTileFrames.size() >= MAXWORD || bufferedTileTextures.size() >= MAXWORD) {
+		executeBufferedTileDraws();
+	}
+
+	// Frames are shared between consecutive tiles, only copy when it changes
+	// And we pray that the pointers in here don't go stale!
+	if (bufferedTileFrames.empty()
+		|| bufferedTileFrames.back().XB != Frame->XB || bufferedTileFrames.back().YB != Frame->YB
+		|| bufferedTileFrames.back().X != Frame->X || bufferedTileFrames.back().Y != Frame->Y) {
+		bufferedTileFrames.push_back(*Frame);
+	}
+	tile.frameIdx = static_cast<WORD>(bufferedTileFrames.size() - 1);
+
+	// Texture infos are shared between all tiles using the same texture.
+	// Runs of glyphs from the same font page reuse the previous tile's index without the lookup.
+	// A realtime texture that changed gets an entry of its own, so it is uploaded again where it was drawn.
+	if (!Info.bRealtimeChanged && !bufferedTiles.empty() && bufferedTileTextures[bufferedTiles.back().texIdx].CacheID == Info.CacheID) {
+		tile.texIdx = bufferedTiles.back().texIdx;
+	}
+	else {
+		auto texIdxIt = bufferedTileTexIndices.find(Info.CacheID);
+		if (texIdxIt == bufferedTileTexIndices.end() || Info.bRealtimeChanged) {
+			const WORD texIdx = static_cast<WORD>(bufferedTileTextures.size());
+			texIdxIt = bufferedTileTexIndices.insert_or_assign(Info.CacheID, texIdx).first;
+			bufferedTileTextures.push_back(Info);
+			// The buffered copy does the upload, as SetTexture would have cleared it
+			Info.bRealtimeChanged = 0;
+		}
+		tile.texIdx = texIdxIt->second;
+	}
+
+	bufferedTiles.push_back(tile);
+
+	unguard;
+}
+
+void UD3D9RenderDevice::executeBufferedTileDraws() {
+	guard(UD3D9RenderDevice::executeBufferedTileDraws);
+	if (bufferedTiles.empty()) {
+		return;
+	}
+	bool wasBuffered = bufferTileDraws;
+	bufferTileDraws = false;
+
+	TileBufferBytes += static_cast<DWORD>(
+		bufferedTiles.size() * sizeof(BufferedTile) +
+		bufferedTileFrames.size() * sizeof(FSceneNode) +
+		bufferedTileTextures.size() * sizeof(FTextureInfo)
+	);
+
+	// Find runs of tiles with matching state, painter order is kept
+	const size_t numTiles = bufferedTiles.size();
+	size_t runStart = 0;
+	while (runStart < numTiles) {
+		const BufferedTile& first = bufferedTiles[runStart];
+		size_t runEnd = runStart + 1;
+		while (runEnd < numTiles) {
+			const BufferedTile& tile = bufferedTiles[runEnd];
+			if (tile.texIdx != first.texIdx || tile.polyFlags != first.polyFlags || tile.frameIdx != first.frameIdx) {
+				break;
+			}
+			runEnd++;
+		}
+		DrawTileRun(&bufferedTileFrames[first.frameIdx], bufferedTileTextures[first.texIdx], &first, static_cast<UINT>(runEnd - runStart));
+		runStart = runEnd;
+	}
+
+	bufferedTiles.clear();
+	bufferedTileFrames.clear();
+	bufferedTileTextures.clear();
+	bufferedTileTexIndices.clear();
+	bufferTileDraws = wasBuffered;
+	unguard;
+}
+
+void UD3D9RenderDevice::DrawTileRun(FSceneNode* Frame, FTextureInfo& Info, const BufferedTile* tiles, UINT numTiles) {
+	guard(UD3D9RenderDevice::DrawTileRun);
+
+	EndBufferingExcept(BV_TYPE_TILES);
+
+	const DWORD PolyFlags = tiles[0].polyFlags;
+	const FLOAT Z = 0.5f;
+
+	TileCount += numTiles;
+
+	//Hit select path
+	if (m_HitData) {
+		for (UINT i = 0; i < numTiles; i++) {
+			const BufferedTile& tile = tiles[i];
+			FLOAT RPX1 = tile.X + Frame->XB;
+			FLOAT RPX2 = RPX1 + tile.XL;
+			FLOAT RPY1 = tile.Y + Frame->YB;
+			FLOAT RPY2 = RPY1 + tile.YL;
+
+			CGClip::vec3_t triPts[3];
+
+			triPts[0].x = RPX1;
+			triPts[0].y = RPY1;
+			triPts[0].z = Z;
+
+			triPts[1].x = RPX2;
+			triPts[1].y = RPY1;
+			triPts[1].z = Z;
+
+			triPts[2].x = RPX2;
+			triPts[2].y = RPY2;
+			triPts[2].z = Z;
+
+			m_gclip.SelectDrawTri(Frame, triPts);
+
+			triPts[1].y = RPY2;
+			triPts[2].x = RPX1;
+			m_gclip.SelectDrawTri(Frame, triPts);
+		}
+
+		return;
+	}
+
+	while (numTiles > 0) {
+		//Check if need to start new tile buffering
+		if (needsNewBuffer(PolyFlags, 6, &Info)) {
+			//Flush any previously buffered tiles
+			EndBuffering();
+
+			//Check if vertex buffer flush is required
+			if ((m_curVertexBufferPos + m_bufferedVerts) >= (VERTEX_BUFFER_SIZE - 6)) {
+				FlushVertexBuffers();
+			}
+
+			//Start tile buffering
+			StartBuffering(BV_TYPE_TILES);
+
+			//Update current poly flags (before possible local modification)
+			m_curPolyFlags = PolyFlags;
+
+			//Set default texture state
+			SetDefaultTextureState();
+
+			SetBlend(PolyFlags, true);
+			SetTextureNoPanBias(0, Info, PolyFlags);
+			m_tileBatchInfoCacheID = Info.CacheID;
+
+			if (PolyFlags & PF_Modulated) {
+				m_requestedColorFlags = 0;
+			}
+			else {
+				m_requestedColorFlags = CF_COLOR_ARRAY;
+			}
+
+			//Lock vertexColor and texCoord0 buffers
+			LockVertexColorBuffer(6);
+			LockTexCoordBuffer(0, 6);
+
+			//Set stream state
+			SetDefaultStreamState();
+		}
+
+		//Buffer as many of the tiles as will fit in the vertex buffer
+		UINT tilesToBuffer = (VERTEX_BUFFER_SIZE - 1 - m_curVertexBufferPos - m_bufferedVerts) / 6;
+		if (tilesToBuffer > numTiles) {
+			tilesToBuffer = numTiles;
+		}
+
+		for (UINT i = 0; i < tilesToBuffer; i++) {
+			BufferTileQuad(tiles[i], Frame->XB, Frame->YB);
+		}
+
+		tiles += tilesToBuffer;
+		numTiles -= tilesToBuffer;
+	}
 
 	unguard;
 }
@@ -2803,7 +2927,7 @@ void UD3D9RenderDevice::Draw3DLine(FSceneNode* Frame, FPlane Color, DWORD LineFl
 		}
 	}
 	else {
-		EndBufferingExcept(BV_TYPE_LINES);
+		EndBufferingExcept(BV_TYPE_LINES_POINTS);
 
 		//Hit select path
 		if (m_HitData) {
@@ -2822,61 +2946,17 @@ void UD3D9RenderDevice::Draw3DLine(FSceneNode* Frame, FPlane Color, DWORD LineFl
 			return;
 		}
 
-		//Draw3DLine does not use PolyFlags2
-		const DWORD PolyFlags = PF_Highlighted | PF_Occlude;
-
-		//Check if need to start new line buffering
-		if (needsNewBuffer(PolyFlags, 2)) {
-			//Flush any previously buffered lines
-			EndBuffering();
-
-			//Check if vertex buffer flush is required
-			if ((m_curVertexBufferPos + m_bufferedVerts) >= (VERTEX_BUFFER_SIZE - 2)) {
-				FlushVertexBuffers();
-			}
-
-			//Start line buffering
-			StartBuffering(BV_TYPE_LINES);
-
-			SetDefaultStreamState();
-			SetDefaultTextureState();
-
-			//Update current poly flags
-			m_curPolyFlags = PolyFlags;
-
-			//Set blending and no texture for lines
-			SetBlend(PolyFlags);
-			SetNoTexture(0);
-
-			//Lock vertexColor and texCoord0 buffers
-			LockVertexColorBuffer(2);
-			LockTexCoordBuffer(0, 2);
-		}
+		//Start line and point buffering
+		StartBuffering(BV_TYPE_LINES_POINTS);
 
 		//Get line color
 		DWORD lineColor = FPlaneTo_BGRClamped_A255(&Color);
 
 		//Buffer the line
-		FGLVertexColor *pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-		FGLTexCoord *pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-
-		pVertexColorArray[0].x = P1.X;
-		pVertexColorArray[0].y = P1.Y;
-		pVertexColorArray[0].z = P1.Z;
-		pVertexColorArray[0].color = lineColor;
-
-		pVertexColorArray[1].x = P2.X;
-		pVertexColorArray[1].y = P2.Y;
-		pVertexColorArray[1].z = P2.Z;
-		pVertexColorArray[1].color = lineColor;
-
-		pTexCoordArray[0].u = 0.0f;
-		pTexCoordArray[0].v = 0.0f;
-
-		pTexCoordArray[1].u = 1.0f;
-		pTexCoordArray[1].v = 0.0f;
-
-		m_bufferedVerts += 2;
+		BufferLinePointVerts(D3DPT_LINELIST, {
+			{ P1.X, P1.Y, P1.Z, FGLNormal(), lineColor },
+			{ P2.X, P2.Y, P2.Z, FGLNormal(), lineColor }
+		});
 	}
 	unguard;
 }
@@ -2890,7 +2970,7 @@ void UD3D9RenderDevice::Draw2DLine(FSceneNode* Frame, FPlane Color, DWORD LineFl
 #endif
 	guard(UD3D9RenderDevice::Draw2DLine);
 
-	EndBufferingExcept(BV_TYPE_LINES);
+	EndBufferingExcept(BV_TYPE_LINES_POINTS);
 
 	//Get line coordinates back in 3D
 	FLOAT X1Pos = m_RFX2 * (P1.X - Frame->FX2);
@@ -2921,61 +3001,17 @@ void UD3D9RenderDevice::Draw2DLine(FSceneNode* Frame, FPlane Color, DWORD LineFl
 		return;
 	}
 
-	//Draw2DLine does not use PolyFlags2
-	const DWORD PolyFlags = PF_Highlighted | PF_Occlude;
-
-	//Check if need to start new line buffering
-	if (needsNewBuffer(PolyFlags, 2)) {
-		//Flush any previously buffered lines
-		EndBuffering();
-
-		//Check if vertex buffer flush is required
-		if ((m_curVertexBufferPos + m_bufferedVerts) >= (VERTEX_BUFFER_SIZE - 2)) {
-			FlushVertexBuffers();
-		}
-
-		//Start line buffering
-		StartBuffering(BV_TYPE_LINES);
-
-		SetDefaultStreamState();
-		SetDefaultTextureState();
-
-		//Update current poly flags
-		m_curPolyFlags = PolyFlags;
-
-		//Set blending and no texture for lines
-		SetBlend(PolyFlags);
-		SetNoTexture(0);
-
-		//Lock vertexColor and texCoord0 buffers
-		LockVertexColorBuffer(2);
-		LockTexCoordBuffer(0, 2);
-	}
+	//Start line and point buffering
+	StartBuffering(BV_TYPE_LINES_POINTS);
 
 	//Get line color
 	DWORD lineColor = FPlaneTo_BGRClamped_A255(&Color);
 
 	//Buffer the line
-	FGLVertexColor* pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-	FGLTexCoord* pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-
-	pVertexColorArray[0].x = X1Pos;
-	pVertexColorArray[0].y = Y1Pos;
-	pVertexColorArray[0].z = P1.Z;
-	pVertexColorArray[0].color = lineColor;
-
-	pVertexColorArray[1].x = X2Pos;
-	pVertexColorArray[1].y = Y2Pos;
-	pVertexColorArray[1].z = P2.Z;
-	pVertexColorArray[1].color = lineColor;
-
-	pTexCoordArray[0].u = 0.0f;
-	pTexCoordArray[0].v = 0.0f;
-
-	pTexCoordArray[1].u = 1.0f;
-	pTexCoordArray[1].v = 0.0f;
-
-	m_bufferedVerts += 2;
+	BufferLinePointVerts(D3DPT_LINELIST, {
+		{ X1Pos, Y1Pos, P1.Z, FGLNormal(), lineColor },
+		{ X2Pos, Y2Pos, P2.Z, FGLNormal(), lineColor }
+	});
 
 	unguard;
 }
@@ -2989,7 +3025,7 @@ void UD3D9RenderDevice::Draw2DPoint(FSceneNode* Frame, FPlane Color, DWORD LineF
 #endif
 	guard(UD3D9RenderDevice::Draw2DPoint);
 
-	EndBufferingExcept(BV_TYPE_POINTS);
+	EndBufferingExcept(BV_TYPE_LINES_POINTS);
 
 	// Hack to fix UED selection problem with selection brush
 	if (GIsEditor) {
@@ -3043,98 +3079,21 @@ void UD3D9RenderDevice::Draw2DPoint(FSceneNode* Frame, FPlane Color, DWORD LineF
 		return;
 	}
 
-	//Draw2DPoint does not use PolyFlags2
-	const DWORD PolyFlags = PF_Highlighted | PF_Occlude;
-
-	//Check if need to start new point buffering
-	if (needsNewBuffer(PolyFlags, 6)) {
-		//Flush any previously buffered points
-		EndBuffering();
-
-		//Check if vertex buffer flush is required
-		if ((m_curVertexBufferPos + m_bufferedVerts) >= (VERTEX_BUFFER_SIZE - 6)) {
-			FlushVertexBuffers();
-		}
-
-		//Start point buffering
-		StartBuffering(BV_TYPE_POINTS);
-
-		SetDefaultStreamState();
-		SetDefaultTextureState();
-
-		//Update current poly flags
-		m_curPolyFlags = PolyFlags;
-
-		//Set blending and no texture for points
-		SetBlend(PolyFlags);
-		SetNoTexture(0);
-
-		//Lock vertexColor and texCoord0 buffers
-		LockVertexColorBuffer(6);
-		LockTexCoordBuffer(0, 6);
-	}
+	//Start line and point buffering
+	StartBuffering(BV_TYPE_LINES_POINTS);
 
 	//Get point color
 	DWORD pointColor = FPlaneTo_BGRClamped_A255(&Color);
 
-	//Buffer the point
-	FGLVertexColor* pVertexColorArray = &m_pVertexColorArray[m_bufferedVerts];
-	FGLTexCoord* pTexCoordArray = &m_pTexCoordArray[0][m_bufferedVerts];
-
-	pVertexColorArray[0].x = X1Pos;
-	pVertexColorArray[0].y = Y1Pos;
-	pVertexColorArray[0].z = Z;
-	pVertexColorArray[0].color = pointColor;
-
-	pVertexColorArray[1].x = X2Pos;
-	pVertexColorArray[1].y = Y1Pos;
-	pVertexColorArray[1].z = Z;
-	pVertexColorArray[1].color = pointColor;
-
-	pVertexColorArray[2].x = X2Pos;
-	pVertexColorArray[2].y = Y2Pos;
-	pVertexColorArray[2].z = Z;
-	pVertexColorArray[2].color = pointColor;
-
-	pVertexColorArray[3].x = X1Pos;
-	pVertexColorArray[3].y = Y1Pos;
-	pVertexColorArray[3].z = Z;
-	pVertexColorArray[3].color = pointColor;
-
-	pVertexColorArray[4].x = X2Pos;
-	pVertexColorArray[4].y = Y2Pos;
-	pVertexColorArray[4].z = Z;
-	pVertexColorArray[4].color = pointColor;
-
-	pVertexColorArray[5].x = X1Pos;
-	pVertexColorArray[5].y = Y2Pos;
-	pVertexColorArray[5].z = Z;
-	pVertexColorArray[5].color = pointColor;
-
-	FLOAT SU1 = 0.0f;
-	FLOAT SU2 = 1.0f;
-	FLOAT SV1 = 0.0f;
-	FLOAT SV2 = 1.0f;
-
-	pTexCoordArray[0].u = SU1;
-	pTexCoordArray[0].v = SV1;
-
-	pTexCoordArray[1].u = SU2;
-	pTexCoordArray[1].v = SV1;
-
-	pTexCoordArray[2].u = SU2;
-	pTexCoordArray[2].v = SV2;
-
-	pTexCoordArray[3].u = SU1;
-	pTexCoordArray[3].v = SV1;
-
-	pTexCoordArray[4].u = SU2;
-	pTexCoordArray[4].v = SV2;
-
-	pTexCoordArray[5].u = SU1;
-	pTexCoordArray[5].v = SV2;
-
-	m_bufferedVerts += 6;
+	//Buffer the point (stored as triangles)
+	BufferLinePointVerts(D3DPT_TRIANGLELIST, {
+		{ X1Pos, Y1Pos, Z, FGLNormal(), pointColor },
+		{ X2Pos, Y1Pos, Z, FGLNormal(), pointColor },
+		{ X2Pos, Y2Pos, Z, FGLNormal(), pointColor },
+		{ X1Pos, Y1Pos, Z, FGLNormal(), pointColor },
+		{ X2Pos, Y2Pos, Z, FGLNormal(), pointColor },
+		{ X1Pos, Y2Pos, Z, FGLNormal(), pointColor }
+	});
 
 	unguard;
 }
@@ -3549,91 +3508,570 @@ void UD3D9RenderDevice::renderMover(FSceneNode* frame, ABrush* mover) {
 	unguard;
 }
 
-std::unordered_set<int> UD3D9RenderDevice::LightSlots::updateActors(const std::vector<AActor*>& actors) {
-	std::unordered_set<int> unsetSlots;
-	// First, deactivate the slots of any actors that have been removed
-	for (auto it = actorSlots.begin(); it != actorSlots.end(); ) {
-		if (!std::count(actors.begin(), actors.end(), it->first)) {
-			// This actor has been removed
-			const int slot = it->second;
-			availableSlots.push_front(slot);
-			unsetSlots.insert(slot);
-			//dout << L"Slot " << slot << L" actor deleted" << std::endl;
-			it = actorSlots.erase(it);
-		} else {
-			++it;
+void UD3D9RenderDevice::clusterLights(const std::vector<AActor*>& lightActors) {
+	guard(UD3D9RenderDevice::clusterLights);
+
+	const FLOAT cellSize = Max(LightClusterDistance, 1.0f);
+
+	lightClusterList.clear();
+	lightClusterCells.clear();
+	lightClusterOfRep.clear();
+	lightClusterIndex.clear();
+	clusteredLights.clear();
+
+	// Lights in the same grid cell with the same look go into one cluster
+	for (AActor* actor : lightActors) {
+		INT clusterIndex = -1;
+		if (actor->LightType == LT_Steady && actor->LightRadius <= LightClusterMaxRadius) {
+			struct {
+				INT cellX, cellY, cellZ;
+				BYTE hue, saturation, effect, pad;
+			} cellKey;
+			appMemzero(&cellKey, sizeof(cellKey));
+			cellKey.cellX = appFloor(actor->Location.X / cellSize);
+			cellKey.cellY = appFloor(actor->Location.Y / cellSize);
+			cellKey.cellZ = appFloor(actor->Location.Z / cellSize);
+			cellKey.hue = actor->LightHue;
+			cellKey.saturation = actor->LightSaturation;
+			cellKey.effect = actor->LightEffect;
+			QWORD key = XXH64(&cellKey, sizeof(cellKey), 0);
+
+			auto it = lightClusterCells.find(key);
+			if (it != lightClusterCells.end()) {
+				clusterIndex = it->second;
+			}
+			else {
+				clusterIndex = (INT)lightClusterList.size();
+				LightCluster cluster;
+				cluster.representative = actor;
+				cluster.locationSum = FVector(0, 0, 0);
+				cluster.brightnessSum = 0.0f;
+				cluster.count = 0;
+				cluster.extent = 0.0f;
+				lightClusterList.push_back(cluster);
+				lightClusterCells.emplace(key, clusterIndex);
+				clusteredLights.push_back(actor);
+			}
+			LightCluster& cluster = lightClusterList[clusterIndex];
+			cluster.locationSum += actor->Location;
+			cluster.brightnessSum += actor->LightBrightness;
+			cluster.count++;
+		}
+		else {
+			clusteredLights.push_back(actor);
 		}
+		lightClusterIndex.push_back(clusterIndex);
 	}
 
-	// Now, add any new actors
-	for (AActor* actor : actors) {
-		if (!actorSlots.count(actor)) {
-			// This is a new actor
-			if (availableSlots.empty()) {
-				static std::set<size_t> loggedLightOversizes;
-				if (loggedLightOversizes.insert(actors.size()).second) {
-					debugf(NAME_D3D9DrvRTX, TEXT("No light slots left! Needed %d lights"), actors.size());
-					dout << "No light slots left! Needed " << actors.size() << " lights" << std::endl;
-				}
-				break;
-				//throw std::runtime_error("No available slots");
-			}
-			int slot = availableSlots.front();
-			availableSlots.pop_front();
-			actorSlots[actor] = slot;
-			unsetSlots.erase(slot);
-			//dout << L"Slot " << slot << L" actor added " << actor->GetName() << std::endl;
+	for (LightCluster& cluster : lightClusterList) {
+		cluster.centroid = cluster.locationSum / (FLOAT)cluster.count;
+	}
+
+	// The merged light reaches as far as its furthest member
+	for (size_t i = 0; i < lightActors.size(); i++) {
+		if (lightClusterIndex[i] >= 0) {
+			LightCluster& cluster = lightClusterList[lightClusterIndex[i]];
+			cluster.extent = Max(cluster.extent, (lightActors[i]->Location - cluster.centroid).Size());
+		}
+	}
+
+	for (INT i = 0; i < (INT)lightClusterList.size(); i++) {
+		const LightCluster& cluster = lightClusterList[i];
+		if (cluster.count > 1) {
+			lightClusterOfRep.emplace(cluster.representative, i);
+			LightClusters++;
+			LightsMerged += cluster.count - 1;
+		}
+	}
+
+	unguard;
+}
+
+void UD3D9RenderDevice::selectBudgetLights(FSceneNode* frame, const std::vector<AActor*>& lightActors, QWORD visibleZones, size_t budget) {
+	guard(UD3D9RenderDevice::selectBudgetLights);
+
+	// Lights already in a slot need to be clearly beaten before they are swapped out
+	const FLOAT keepBonus = 1.25f;
+	// Lights in zones that can't be seen still bounce light in, but count for less
+	const FLOAT hiddenZoneScale = 0.25f;
+
+	const FVector& viewLocation = frame->Coords.Origin;
+	lightScores.clear();
+	for (AActor* actor : lightActors) {
+		// Same scale the engine uses for LightRadius in world units
+		FLOAT worldRadius = 25.0f * (actor->LightRadius + 1);
+		FLOAT dist = (actor->Location - viewLocation).Size();
+		FLOAT score = (actor->LightBrightness / 255.0f) * worldRadius / (worldRadius + dist);
+		if (!((visibleZones >> actor->Region.ZoneNumber) & 1)) {
+			score *= hiddenZoneScale;
+		}
+		if (lightSlots->hasActor(actor) || remixLightSlots->hasActor(actor)) {
+			score *= keepBonus;
+		}
+		lightScores.emplace_back(score, actor);
+	}
+
+	std::nth_element(lightScores.begin(), lightScores.begin() + (budget - 1), lightScores.end(),
+		[](const std::pair<FLOAT, AActor*>& a, const std::pair<FLOAT, AActor*>& b) {
+			return a.first > b.first;
 		}
+	);
+
+	budgetLights.clear();
+	for (size_t i = 0; i < budget; i++) {
+		budgetLights.push_back(lightScores[i].second);
 	}
-	return unsetSlots;
+
+	unguard;
 }
 
-void UD3D9RenderDevice::renderLights(FSceneNode* frame, std::vector<AActor*> lightActors) {
+UD3D9RenderDevice::LightSlots::LightState UD3D9RenderDevice::getLightState(AActor* actor) {
+	LightSlots::LightState state;
+	state.location = actor->Location;
+	state.brightness = actor->LightBrightness;
+	state.hue = actor->LightHue;
+	state.saturation = actor->LightSaturation;
+	state.radius = actor->LightRadius;
+	state.effect = actor->LightEffect;
+	state.type = actor->LightType;
+	state.clusterScale = 1.0f;
+	state.clusterExtent = 0.0f;
+
+	// A merged cluster is sent from its centre with the combined brightness of its members
+	auto clusterIt = lightClusterOfRep.find(actor);
+	if (clusterIt != lightClusterOfRep.end()) {
+		const LightCluster& cluster = lightClusterList[clusterIt->second];
+		state.location = cluster.centroid;
+		state.clusterScale = actor->LightBrightness ? cluster.brightnessSum / actor->LightBrightness : 1.0f;
+		state.clusterExtent = cluster.extent;
+	}
+	return state;
+}
+
+void UD3D9RenderDevice::getLightColourRange(AActor* actor, const LightSlots::LightState& state, FLOAT brightnessSetting, FPlane& colour, FLOAT& range) {
+	FLOAT brightness = actor->LightBrightness / 255.0f;
+	GRender->GlobalLighting(true, actor, brightness, colour);
+	colour.X *= state.clusterScale;
+	colour.Y *= state.clusterScale;
+	colour.Z *= state.clusterScale;
+	// Some math bollocks that looks ok
+	range = brightness * pow((actor->LightRadius / LightRadiusDivisor), LightRadiusExponent) * LightMultiplier * brightnessSetting;
+	range += state.clusterExtent;
+}
+
+void UD3D9RenderDevice::renderLights(FSceneNode* frame, const std::vector<AActor*>& lightActors, QWORD visibleZones) {
 	guard(UD3D9RenderDevice::renderLights);
 
 	EndBuffering();
 
 	//m_d3dDevice->SetRenderState(D3DRS_LIGHTING, TRUE);
 
-	std::unordered_set<int> nowEmptySlots = lightSlots->updateActors(lightActors);
+	const std::vector<AActor*>* lights = &lightActors;
+	if (LightClustering) {
+		clusterLights(lightActors);
+		lights = &clusteredLights;
+	}
+	else {
+		lightClusterOfRep.clear();
+	}
+
+	// The Remix API path has no slot limit, the fixed function lights are all turned off while it is used
+	const bool useRemixLights = UseRemixLights && remixInterfaceInitialized && remixInterface.CreateLight;
+	static const std::vector<AActor*> noLights;
+
+	// Only score the lights when they don't all fit
+	size_t budget = useRemixLights ? remixLightSlots->capacity() : lightSlots->capacity();
+	if (LightBudget > 0) {
+		budget = Min(budget, (size_t)LightBudget);
+	}
+	if (lights->size() > budget && budget > 0) {
+		selectBudgetLights(frame, *lights, visibleZones, budget);
+		lights = &budgetLights;
+	}
+
+	lightSlots->updateActors(useRemixLights ? noLights : *lights);
 
 	// Disable lights that no longer exist
-	for (int slot : nowEmptySlots) {
+	for (int slot : lightSlots->freedSlots()) {
+		LightSlots::Slot& slotInfo = lightSlots->getSlot(slot);
+		if (slotInfo.actor || !slotInfo.enabled) {
+			// Taken by a new light, or never sent
+			continue;
+		}
 		//dout << L"Disabling slot " << slot << std::endl;
 		D3DLIGHT9 lightInfo{ D3DLIGHT_POINT };
 		HRESULT res = m_d3dDevice->SetLight(slot, &lightInfo);
 		assert(res == D3D_OK);
 		res = m_d3dDevice->LightEnable(slot, false);
 		assert(res == D3D_OK);
+		slotInfo.enabled = false;
+	}
+
+	float brightnessSetting = frame->Viewport->GetOuterUClient()->Brightness * 2.0f;  // 0.5 is "normal"
+	const FLOAT lightSettings[6] = { brightnessSetting, LightMultiplier, LightRadiusDivisor, LightRadiusExponent, RemixLightSphereScale, RemixLightIntensity };
+	if (appMemcmp(lightSettings, lastLightSettings, sizeof(lightSettings))) {
+		appMemcpy(lastLightSettings, lightSettings, sizeof(lightSettings));
+		lightSlots->invalidate();
+		remixLightSlots->invalidate();
 	}
 
-	for (auto& pair : lightSlots->slotMap()) {
-		AActor* const& actor = pair.first;
-		const int& slot = pair.second;
-		FLOAT brightness = actor->LightBrightness / 255.0f;
+	for (int slot : lightSlots->activeSlots()) {
+		LightSlots::Slot& slotInfo = lightSlots->getSlot(slot);
+		AActor* actor = slotInfo.actor;
+
+		LightSlots::LightState state = getLightState(actor);
+
+		// Anything but a steady light is animated by GlobalLighting, so it changes every frame
+		if (slotInfo.submitted && state.type == LT_Steady && state == slotInfo.state) {
+			continue;
+		}
+		slotInfo.state = state;
+		slotInfo.submitted = true;
+
 		FPlane colour;
-		GRender->GlobalLighting(true, actor, brightness, colour);
+		FLOAT range;
+		getLightColourRange(actor, state, brightnessSetting, colour, range);
 		D3DLIGHT9 lightInfo = D3DLIGHT9();
 		lightInfo.Type = D3DLIGHT_POINT;
-		lightInfo.Position = D3DVECTOR{ actor->Location.X, actor->Location.Y, actor->Location.Z };
+		lightInfo.Position = D3DVECTOR{ state.location.X, state.location.Y, state.location.Z };
 		lightInfo.Diffuse.r = colour.X;
 		lightInfo.Diffuse.g = colour.Y;
 		lightInfo.Diffuse.b = colour.Z;
 		lightInfo.Diffuse.a = 1.0f;
 		lightInfo.Specular = lightInfo.Diffuse;
-		float brightnessSetting = frame->Viewport->GetOuterUClient()->Brightness * 2.0f;  // 0.5 is "normal"
-		// Some math bollocks that looks ok
-		lightInfo.Range = brightness * pow((actor->LightRadius / LightRadiusDivisor), LightRadiusExponent) * LightMultiplier * brightnessSetting;
+		lightInfo.Range = range;
 		HRESULT res = m_d3dDevice->SetLight(slot, &lightInfo);
 		assert(res == D3D_OK);
-		res = m_d3dDevice->LightEnable(slot, true);
-		assert(res == D3D_OK);
+		if (!slotInfo.enabled) {
+			res = m_d3dDevice->LightEnable(slot, true);
+			assert(res == D3D_OK);
+			slotInfo.enabled = true;
+		}
+	}
+
+	if (useRemixLights || !remixLightSlots->activeSlots().empty()) {
+		remixLightSlots->updateActors(useRemixLights ? *lights : noLights);
+		renderRemixLights(brightnessSetting);
 	}
 
 	//m_d3dDevice->SetRenderState(D3DRS_LIGHTING, FALSE);
 	unguard;
 }
 
+void UD3D9RenderDevice::renderRemixLights(FLOAT brightnessSetting) {
+	guard(UD3D9RenderDevice::renderRemixLights);
+
+	remixapi_ErrorCode remixErr = remixLightSlots->submitRemixLights(remixInterface,
+		[this](AActor* actor) {
+			return getLightState(actor);
+		},
+		[this, brightnessSetting](AActor* actor, const LightSlots::LightState& state, remixapi_LightInfoSphereEXT& sphereInfo, remixapi_LightInfo& lightInfo) {
+			FPlane colour;
+			FLOAT range;
+			getLightColourRange(actor, state, brightnessSetting, colour, range);
+
+			// The emitter is sized from LightRadius, the D3D range sets how bright it is so it reaches as far
+			sphereInfo.position = remixapi_Float3D{ state.location.X, state.location.Y, state.location.Z };
+			sphereInfo.radius = Max(actor->LightRadius * RemixLightSphereScale, 1.0f);
+			sphereInfo.shaping_hasvalue = false;
+			sphereInfo.volumetricRadianceScale = 1.0f;
+
+			FLOAT intensity = range * range * RemixLightIntensity / (sphereInfo.radius * sphereInfo.radius);
+			// Stable between runs so lights can be replaced in the toolkit
+			const TCHAR* pathName = actor->GetPathName();
+			lightInfo.hash = XXH64(pathName, appStrlen(pathName) * sizeof(TCHAR), 0);
+			lightInfo.radiance = remixapi_Float3D{ colour.X * intensity, colour.Y * intensity, colour.Z * intensity };
+		}
+	);
+	if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+		static bool loggedCreateLightError = false;
+		if (!loggedCreateLightError) {
+			loggedCreateLightError = true;
+			debugf(NAME_D3D9DrvRTX, TEXT("Failed to create RTX Remix light! Error: %d"), remixErr);
+		}
+	}
+
+	unguard;
+}
+
+void UD3D9RenderDevice::destroyRemixLights() {
+	if (!remixLightSlots) {
+		return;
+	}
+	remixLightSlots->destroyRemixLights(remixInterface);
+}
+
+// Remix alpha test compare functions, same order as D3DCMPFUNC starting from 0
+static const int REMIX_ALPHA_TEST_GREATER_OR_EQUAL = 6;
+static const int REMIX_ALPHA_TEST_ALWAYS = 7;
+// Remix blend types
+static const int REMIX_BLEND_COLOR = 3;
+static const int REMIX_BLEND_DOUBLE_MULTIPLICATIVE = 8;
+
+RemixMaterialClass UD3D9RenderDevice::getRemixMaterialClass(DWORD polyFlags) {
+	if (polyFlags & PF_Translucent) {
+		return REMIX_MATERIAL_TRANSLUCENT;
+	}
+	if (polyFlags & PF_Modulated) {
+		return REMIX_MATERIAL_MODULATED;
+	}
+	if (polyFlags & PF_Masked) {
+		return REMIX_MATERIAL_MASKED;
+	}
+	if (polyFlags & PF_Unlit) {
+		return REMIX_MATERIAL_UNLIT;
+	}
+	return REMIX_MATERIAL_OPAQUE;
+}
+
+remixapi_MaterialHandle UD3D9RenderDevice::acquireRemixMaterial(FTextureInfo& texInfo, DWORD polyFlags) {
+	guard(UD3D9RenderDevice::acquireRemixMaterial);
+
+	RemixMaterialClass materialClass = getRemixMaterialClass(polyFlags);
+	// Same key as the texture's bind, so evicting the bind finds its materials
+	QWORD cacheID = calcCacheID(texInfo, (materialClass == REMIX_MATERIAL_MASKED) ? PF_Masked : 0);
+
+	// Materials only take textures from files
+	const std::wstring& textureFile = getRemixTextureFile(texInfo, polyFlags);
+	if (textureFile.empty()) {
+		return nullptr;
+	}
+
+	RemixMaterial& material = remixMaterials[cacheID][materialClass];
+	if (material.handle) {
+		// Ids are reused for new textures after garbage collection, the file name has the contents in it
+		if (material.textureFile == textureFile) {
+			material.meshRefs++;
+			return material.handle;
+		}
+		if (material.meshRefs == 0) {
+			remixInterface.DestroyMaterial(material.handle);
+			material.handle = nullptr;
+		}
+		else {
+			// Still drawn by a mesh of the old texture, this one has to wait for it to go
+			return nullptr;
+		}
+	}
+
+	remixapi_MaterialInfoOpaqueEXT opaqueInfo = {};
+	opaqueInfo.sType = REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_OPAQUE_EXT;
+	opaqueInfo.roughnessTexture = L"";
+	opaqueInfo.metallicTexture = L"";
+	opaqueInfo.heightTexture = L"";
+	opaqueInfo.albedoConstant = remixapi_Float3D{ 1.0f, 1.0f, 1.0f };
+	opaqueInfo.opacityConstant = 1.0f;
+	opaqueInfo.roughnessConstant = 0.7f;
+	opaqueInfo.metallicConstant = 0.0f;
+	opaqueInfo.useDrawCallAlphaState = false;
+	opaqueInfo.alphaTestType = REMIX_ALPHA_TEST_ALWAYS;
+
+	remixapi_MaterialInfo materialInfo = {};
+	materialInfo.sType = REMIXAPI_STRUCT_TYPE_MATERIAL_INFO;
+	materialInfo.pNext = &opaqueInfo;
+	// The file name holds the texture's path and content hash, so it's stable between runs
+	materialInfo.hash = XXH64(textureFile.c_str(), textureFile.size() * sizeof(wchar_t), materialClass);
+	materialInfo.albedoTexture = textureFile.c_str();
+	materialInfo.normalTexture = L"";
+	materialInfo.tangentTexture = L"";
+	materialInfo.emissiveTexture = L"";
+	materialInfo.filterMode = (polyFlags & PF_NoSmooth) ? 0 : 1;
+	materialInfo.wrapModeU = 1;
+	materialInfo.wrapModeV = 1;
+
+	switch (materialClass) {
+	case REMIX_MATERIAL_MASKED:
+		opaqueInfo.alphaTestType = REMIX_ALPHA_TEST_GREATER_OR_EQUAL;
+		opaqueInfo.alphaReferenceValue = 127;
+		break;
+	case REMIX_MATERIAL_TRANSLUCENT:
+		// src + dst * (1 - src)
+		opaqueInfo.blendType_hasvalue = true;
+		opaqueInfo.blendType_value = REMIX_BLEND_COLOR;
+		break;
+	case REMIX_MATERIAL_MODULATED:
+		// src * dst * 2
+		opaqueInfo.blendType_hasvalue = true;
+		opaqueInfo.blendType_value = REMIX_BLEND_DOUBLE_MULTIPLICATIVE;
+		break;
+	case REMIX_MATERIAL_UNLIT:
+		// Fullbright, so it lights itself with its own texture
+		materialInfo.emissiveTexture = textureFile.c_str();
+		materialInfo.emissiveIntensity = 1.0f;
+		materialInfo.emissiveColorConstant = remixapi_Float3D{ 1.0f, 1.0f, 1.0f };
+		break;
+	default:
+		;
+	}
+
+	remixapi_ErrorCode remixErr = remixInterface.CreateMaterial(&materialInfo, &material.handle);
+	if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+		material.handle = nullptr;
+		static bool loggedCreateMaterialError = false;
+		if (!loggedCreateMaterialError) {
+			loggedCreateMaterialError = true;
+			debugf(NAME_D3D9DrvRTX, TEXT("Failed to create RTX Remix material! Error: %d"), remixErr);
+		}
+		return nullptr;
+	}
+	material.textureFile = textureFile;
+	material.hash = materialInfo.hash;
+	material.meshRefs = 1;
+	return material.handle;
+
+	unguard;
+}
+
+void UD3D9RenderDevice::releaseRemixMaterial(QWORD cacheID, RemixMaterialClass materialClass) {
+	auto it = remixMaterials.find(cacheID);
+	if (it != remixMaterials.end() && it->second[materialClass].meshRefs > 0) {
+		it->second[materialClass].meshRefs--;
+	}
+}
+
+void UD3D9RenderDevice::evictRemixMaterials(QWORD cacheID) {
+	auto it = remixMaterials.find(cacheID);
+	if (it == remixMaterials.end()) {
+		return;
+	}
+	bool inUse = false;
+	for (RemixMaterial& material : it->second) {
+		// Meshes keep theirs until the level changes
+		if (material.meshRefs > 0) {
+			inUse = true;
+			continue;
+		}
+		if (material.handle) {
+			remixInterface.DestroyMaterial(material.handle);
+			material.handle = nullptr;
+		}
+	}
+	if (!inUse) {
+		remixMaterials.erase(it);
+	}
+}
+
+void UD3D9RenderDevice::destroyRemixMaterials() {
+	for (auto& materialsPair : remixMaterials) {
+		for (RemixMaterial& material : materialsPair.second) {
+			if (material.handle) {
+				remixInterface.DestroyMaterial(material.handle);
+			}
+		}
+	}
+	remixMaterials.clear();
+}
+
+bool UD3D9RenderDevice::canUseRemixLevelMesh(const FTextureInfo& texInfo, DWORD polyFlags) {
+	// These change the texture coordinates or the texture every frame
+	DWORD animatedFlags = PF_AutoUPan | PF_AutoVPan;
+#if !RUNE
+	animatedFlags |= PF_SmallWavy;
+#endif
+	if (polyFlags & (animatedFlags | PF_Mirrored)) {
+		return false;
+	}
+	if (texInfo.bRealtime || getTextureFromInfo(texInfo)->AnimNext) {
+		return false;
+	}
+	return true;
+}
+
+bool UD3D9RenderDevice::createRemixLevelMesh(BYTE zone, FTextureInfo& texInfo, DWORD polyFlags, const std::vector<FSurfaceFacet*>& facets, const TCHAR* levelName) {
+	guard(UD3D9RenderDevice::createRemixLevelMesh);
+
+	if (!canUseRemixLevelMesh(texInfo, polyFlags)) {
+		return false;
+	}
+	std::vector<remixapi_HardcodedVertex> vertices;
+	std::vector<uint32_t> indices;
+	const FLOAT UMult = 1.0f / (texInfo.UScale * texInfo.USize);
+	const FLOAT VMult = 1.0f / (texInfo.VScale * texInfo.VSize);
+	for (const FSurfaceFacet* facet : facets) {
+		// Same coordinates as drawLevelSurfaces, but normalised as there is no texture matrix
+		FLOAT uDot = facet->MapCoords.XAxis | facet->MapCoords.Origin;
+		FLOAT vDot = facet->MapCoords.YAxis | facet->MapCoords.Origin;
+		if (facet->Span) {
+			const FVector* realPan = (const FVector*)facet->Span;
+			uDot -= realPan->X;
+			vDot -= realPan->Y;
+		}
+		const FVector& normal = facet->MapCoords.ZAxis;
+		for (FSavedPoly* poly = facet->Polys; poly; poly = poly->Next) {
+			if (poly->NumPts <= 2) {
+				continue;
+			}
+			uint32_t hubIndex = static_cast<uint32_t>(vertices.size());
+			for (INT i = 0; i < poly->NumPts; i++) {
+				const FVector& point = poly->Pts[i]->Point;
+				remixapi_HardcodedVertex& vert = vertices.emplace_back();
+				vert.position[0] = point.X;
+				vert.position[1] = point.Y;
+				vert.position[2] = point.Z;
+				vert.normal[0] = normal.X;
+				vert.normal[1] = normal.Y;
+				vert.normal[2] = normal.Z;
+				vert.texcoord[0] = ((facet->MapCoords.XAxis | point) - uDot) * UMult;
+				vert.texcoord[1] = ((facet->MapCoords.YAxis | point) - vDot) * VMult;
+				vert.color = 0xFFFFFFFF;
+			}
+			// Fan from the first point, as BufferStaticComplexSurfaceGeometry does
+			for (INT i = 2; i < poly->NumPts; i++) {
+				indices.push_back(hubIndex);
+				indices.push_back(hubIndex + i - 1);
+				indices.push_back(hubIndex + i);
+			}
+		}
+	}
+	if (indices.empty()) {
+		return false;
+	}
+
+	RemixMaterialClass materialClass = getRemixMaterialClass(polyFlags);
+	QWORD materialCacheID = calcCacheID(texInfo, (materialClass == REMIX_MATERIAL_MASKED) ? PF_Masked : 0);
+	remixapi_MaterialHandle materialHandle = acquireRemixMaterial(texInfo, polyFlags);
+	if (!materialHandle) {
+		return false;
+	}
+
+	struct {
+		QWORD levelHash;
+		QWORD materialHash;
+		DWORD polyFlags;
+		DWORD zone;
+	} meshKey = { XXH64(levelName, appStrlen(levelName) * sizeof(TCHAR), 0), remixMaterials[materialCacheID][materialClass].hash, polyFlags, zone };
+
+	remixapi_ErrorCode remixErr = remixLevelMeshes.add(remixInterface, zone, XXH64(&meshKey, sizeof(meshKey), 0), vertices, indices, materialHandle, materialCacheID, materialClass);
+	if (remixErr != REMIXAPI_ERROR_CODE_SUCCESS) {
+		releaseRemixMaterial(materialCacheID, materialClass);
+		static bool loggedCreateMeshError = false;
+		if (!loggedCreateMeshError) {
+			loggedCreateMeshError = true;
+			debugf(NAME_D3D9DrvRTX, TEXT("Failed to create RTX Remix mesh! Error: %d"), remixErr);
+		}
+		return false;
+	}
+	return true;
+
+	unguard;
+}
+
+void UD3D9RenderDevice::drawRemixLevelMeshes(BYTE zone) {
+	guard(UD3D9RenderDevice::drawRemixLevelMeshes);
+	remixLevelMeshes.draw(remixInterface, zone);
+	unguard;
+}
+
+void UD3D9RenderDevice::destroyRemixLevelMeshes() {
+	remixLevelMeshes.destroyAll(remixInterface, [this](QWORD cacheID, RemixMaterialClass materialClass) {
+		releaseRemixMaterial(cacheID, materialClass);
+	});
+	// Texture objects can be gone by the next level
+	remixTextureFiles.clear();
+	// Registered again by the next DrawWorld, which also covers a device reset in the middle of a level
+	remixLevelMeshesDirty = true;
+}
+
 // Helper function to convert a hash to a float in the range [-1, 1]
 static inline float hashToFloat(uint32_t hash, uint32_t max_value) {
 	return (static_cast<float>(hash) / static_cast<float>(max_value) * 2.0f) - 1.0f;
@@ -3669,134 +4107,265 @@ static uint32_t xxh32_FRotator(const FRotator& t) {
 	return hash;
 }
 
-void UD3D9RenderDevice::renderAnchor(const D3DMATRIX* matrix, UTexture* texture, const uint32_t hash1, const uint32_t hash2) {
-	EndBuffering();
-	m_d3dDevice->SetTransform(D3DTS_WORLD, matrix);
-
-	FTextureInfo texInfo;
-#if UNREAL_GOLD_OLDUNREAL
-	texInfo = *texture->GetTexture(-1, this);
-#elif KLINGON_HONOR_GUARD
-	texture->GetInfo(texInfo, 0.0);
-#else
-	texture->Lock(texInfo, 0.0, -1, this);
-#endif
-
-	FRenderVert v1{};
-	v1.pos = FVector(0, 0, 5);
-	v1.U = 0.5 * texInfo.USize;
-	v1.V = 0.5 * texInfo.VSize;
-	FRenderVert v2{};
-	v2.pos = FVector(5, 0, 0) + hashToRandomVector(hash1);
-	v2.U = 1.0 * texInfo.USize;
-	v2.V = 1.0 * texInfo.VSize;
-	FRenderVert v3{};
-	v3.pos = FVector(0, 5, 0);
-	v3.U = 0.0 * texInfo.USize;
-	v3.V = 1.0 * texInfo.VSize;
-	FRenderVert v4{};
-	v4.pos = FVector(-5, 0, 0) + hashToRandomVector(hash2);
-	v4.U = 0.0 * texInfo.USize;
-	v4.V = 0.0 * texInfo.VSize;
-	FRenderVert v5{};
-	v5.pos = FVector(0, -5, 0);
-	v5.U = 1.0 * texInfo.USize;
-	v5.V = 0.0 * texInfo.VSize;
-
-	std::vector<FRenderVert> verts;
-	verts.push_back(v1);
-	verts.push_back(v2);
-	verts.push_back(v3);
-
-	verts.push_back(v1);
-	verts.push_back(v3);
-	verts.push_back(v4);
-
-	verts.push_back(v1);
-	verts.push_back(v4);
-	verts.push_back(v5);
-
-	verts.push_back(v1);
-	verts.push_back(v5);
-	verts.push_back(v2);
-
-	DWORD polyFlags = PF_Occlude;
-
-	BufferTriangleSurfaceGeometry(verts);
-
-	//Initialize render passes state information
-	m_rpPassCount = 0;
-	m_rpTMUnits = TMUnits;
-	m_rpForceSingle = false;
-	m_rpMasked = ((polyFlags & PF_Masked) == 0) ? false : true;
-
-	AddRenderPass(&texInfo, polyFlags & ~PF_FlatShaded, 0.0f);
-
-	RenderPasses();
+void UD3D9RenderDevice::addAnchor(const D3DMATRIX& matrix, const uint32_t hash1, const uint32_t hash2) {
+	QWORD key = ((QWORD)hash1 << 32) | hash2;
+	auto geomIt = anchorGeometry.find(key);
+	if (geomIt == anchorGeometry.end()) {
+		// Remix matches replacements by the geometry, so this is the same triangle list as it always was
+		struct {
+			FVector pos;
+			FLOAT u, v;
+		} points[5] = {
+			{ FVector(0, 0, 5), 0.5f, 0.5f },
+			{ FVector(5, 0, 0) + hashToRandomVector(hash1), 1.0f, 1.0f },
+			{ FVector(0, 5, 0), 0.0f, 1.0f },
+			{ FVector(-5, 0, 0) + hashToRandomVector(hash2), 0.0f, 0.0f },
+			{ FVector(0, -5, 0), 1.0f, 0.0f },
+		};
+		static const int tris[ANCHOR_VERTS] = {
+			0, 1, 2,
+			0, 2, 3,
+			0, 3, 4,
+			0, 4, 1,
+		};
 
-#if !UTGLR_NO_TEXTURE_UNLOCK
-	texture->Unlock(texInfo);
-#endif
+		UINT firstVertex = static_cast<UINT>(anchorVerts.size());
+		for (int point : tris) {
+			FGLVertexColor& vert = anchorVerts.emplace_back();
+			vert.x = points[point].pos.X;
+			vert.y = points[point].pos.Y;
+			vert.z = points[point].pos.Z;
+			vert.norm = FGLNormal(FVector(0, 0, 0));
+			vert.color = 0xFFFFFFFF;
+			anchorTexCoords.push_back({ points[point].u, points[point].v });
+		}
+		geomIt = anchorGeometry.emplace(key, firstVertex).first;
+		anchorBuffersDirty = true;
+	}
+	anchorDraws.push_back({ matrix, geomIt->second });
 }
 
-void UD3D9RenderDevice::renderSkyZoneAnchor(ASkyZoneInfo* zone, const FVector* location) {
+void UD3D9RenderDevice::renderAnchors(UTexture* texture) {
 #ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
 	{
 		static int si;
-		dout << L"utd3d9r: renderSkyZoneAnchor = " << si++ << std::endl;
+		dout << L"utd3d9r: renderAnchors = " << si++ << std::endl;
 	}
 #endif
-	guard(UD3D9RenderDevice::renderSkyZoneAnchor);
-	using namespace DirectX;
+	guard(UD3D9RenderDevice::renderAnchors);
 
-	if (!EnableSkyBoxAnchors) {
+	if (anchorDraws.empty()) {
 		return;
 	}
 
-	XMMATRIX actorMatrix = XMMatrixIdentity();
+	HRESULT hResult;
 
-	XMMATRIX matLoc = XMMatrixTranslationFromVector(FVecToDXVec(location ? *location : zone->Location));
-	XMMATRIX matRot = XMMatrixInverse(nullptr, FRotToDXRotMat(zone->Rotation));
-	actorMatrix *= matRot;
-	actorMatrix *= matLoc;
+	if (anchorBuffersDirty) {
+		UINT numVerts = static_cast<UINT>(anchorVerts.size());
+		if (numVerts > m_anchorBufferSize) {
+			if (m_d3dAnchorVertexColorBuffer) {
+				m_d3dAnchorVertexColorBuffer->Release();
+				m_d3dAnchorVertexColorBuffer = NULL;
+			}
+			if (m_d3dAnchorTexCoordBuffer) {
+				m_d3dAnchorTexCoordBuffer->Release();
+				m_d3dAnchorTexCoordBuffer = NULL;
+			}
+			m_anchorBufferSize = Max(Max(m_anchorBufferSize * 2, numVerts), 64 * ANCHOR_VERTS);
+			hResult = m_d3dDevice->CreateVertexBuffer(sizeof(FGLVertexColor) * m_anchorBufferSize, D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &m_d3dAnchorVertexColorBuffer, NULL);
+			if (FAILED(hResult)) {
+				appErrorf(vertexBufferFailMessage, TEXT("Anchor"), *ExplainResult(hResult));
+			}
+			hResult = m_d3dDevice->CreateVertexBuffer(sizeof(FGLTexCoord) * m_anchorBufferSize, D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &m_d3dAnchorTexCoordBuffer, NULL);
+			if (FAILED(hResult)) {
+				appErrorf(vertexBufferFailMessage, TEXT("AnchorTex"), *ExplainResult(hResult));
+			}
+		}
 
-	D3DMATRIX d3dMatrix = ToD3DMATRIX(actorMatrix);
+		//Only happens when new anchors show up, so the whole thing is written again
+		BYTE* pData = nullptr;
+		hResult = m_d3dAnchorVertexColorBuffer->Lock(0, 0, (VOID**)&pData, D3DLOCK_NOSYSLOCK);
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Vertex buffer lock failed: %ls"), *ExplainResult(hResult));
+		}
+		appMemcpy(pData, anchorVerts.data(), sizeof(FGLVertexColor) * numVerts);
+		m_d3dAnchorVertexColorBuffer->Unlock();
 
-	uint32_t locHash = xxh32_FVector(zone->Location);
-	uint32_t rotHash = xxh32_FRotator(zone->RotationRate);
+		hResult = m_d3dAnchorTexCoordBuffer->Lock(0, 0, (VOID**)&pData, D3DLOCK_NOSYSLOCK);
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Vertex buffer lock failed: %ls"), *ExplainResult(hResult));
+		}
+		appMemcpy(pData, anchorTexCoords.data(), sizeof(FGLTexCoord) * numVerts);
+		m_d3dAnchorTexCoordBuffer->Unlock();
+
+		anchorBuffersDirty = false;
+	}
+
+	EndBuffering();
+
+	FTextureInfo texInfo;
+#if UNREAL_GOLD_OLDUNREAL
+	texInfo = *texture->GetTexture(-1, this);
+#elif KLINGON_HONOR_GUARD
+	texture->GetInfo(texInfo, 0.0);
+#else
+	texture->Lock(texInfo, 0.0, -1, this);
+#endif
+
+	//State is the same for every anchor
+	DWORD polyFlags = PF_Occlude;
+	SetBlend(polyFlags);
+	SetTexture(0, texInfo, polyFlags, 0.0f);
+	SetStreamState(m_standardNTextureVertexDecl[0]);
+	DisableSubsequentTextures(1);
+
+	if (m_currentVertexColorBuffer != m_d3dAnchorVertexColorBuffer) {
+		hResult = m_d3dDevice->SetStreamSource(0, m_d3dAnchorVertexColorBuffer, 0, sizeof(FGLVertexColor));
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("SetStreamSource failed: %ls"), *ExplainResult(hResult));
+		}
+		m_currentVertexColorBuffer = m_d3dAnchorVertexColorBuffer;
+	}
+	if (m_currentTexCoordBuffer[0] != m_d3dAnchorTexCoordBuffer) {
+		hResult = m_d3dDevice->SetStreamSource(2, m_d3dAnchorTexCoordBuffer, 0, sizeof(FGLTexCoord));
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("SetStreamSource failed: %ls"), *ExplainResult(hResult));
+		}
+		m_currentTexCoordBuffer[0] = m_d3dAnchorTexCoordBuffer;
+	}
 
-	UTexture* tex = zone->Level->DefaultTexture;
+	//Each anchor stays its own draw so Remix sees each one as its own mesh
+	for (const AnchorDraw& anchor : anchorDraws) {
+		m_d3dDevice->SetTransform(D3DTS_WORLD, &anchor.matrix);
+		m_d3dDevice->DrawPrimitive(D3DPT_TRIANGLELIST, anchor.firstVertex, ANCHOR_VERTS / 3);
+	}
+	anchorDraws.clear();
 
-	renderAnchor(&d3dMatrix, tex, locHash, rotHash);
+#if !UTGLR_NO_TEXTURE_UNLOCK
+	texture->Unlock(texInfo);
+#endif
 
 	unguard;
 }
 
-void UD3D9RenderDevice::renderRTXAnchor(const RTXAnchor& anchor, UTexture* texture) {
-#ifdef UTGLR_DEBUG_SHOW_CALL_COUNTS
-	{
-		static int si;
-		dout << L"utd3d9r: renderRTXAnchor = " << si++ << std::endl;
+void UD3D9RenderDevice::clearAnchorGeometry() {
+	anchorGeometry.clear();
+	anchorVerts.clear();
+	anchorTexCoords.clear();
+	anchorDraws.clear();
+	anchorBuffersDirty = false;
+}
+
+void UD3D9RenderDevice::addSkyZoneAnchor(ASkyZoneInfo* zone, const FVector* location) {
+	guard(UD3D9RenderDevice::addSkyZoneAnchor);
+	using namespace DirectX;
+
+	if (!EnableSkyBoxAnchors) {
+		return;
 	}
-#endif
-	guard(UD3D9RenderDevice::renderSkyZoneAnchor);
+
+	XMMATRIX actorMatrix = XMMatrixIdentity();
+
+	XMMATRIX matLoc = XMMatrixTranslationFromVector(FVecToDXVec(location ? *location : zone->Location));
+	XMMATRIX matRot = XMMatrixInverse(nullptr, FRotToDXRotMat(zone->Rotation));
+	actorMatrix *= matRot;
+	actorMatrix *= matLoc;
+
+	D3DMATRIX d3dMatrix = ToD3DMATRIX(actorMatrix);
+
+	uint32_t locHash = xxh32_FVector(zone->Location);
+	uint32_t rotHash = xxh32_FRotator(zone->RotationRate);
+
+	addAnchor(d3dMatrix, locHash, rotHash);
+
+	unguard;
+}
+
+void UD3D9RenderDevice::addRTXAnchor(const RTXAnchors& anchors, size_t index) {
+	guard(UD3D9RenderDevice::addRTXAnchor);
 	using namespace DirectX;
 
 	XMMATRIX actorMatrix = XMMatrixIdentity();
 
-	XMMATRIX matLoc = XMMatrixTranslationFromVector(FVecToDXVec(anchor.getLocation()));
-	XMMATRIX matRot = XMMatrixRotationRollPitchYawFromVector(FVecToDXVec(anchor.getRotation()));
-	XMMATRIX matScale = XMMatrixScalingFromVector(FVecToDXVec(anchor.getScale()));
+	XMMATRIX matLoc = XMMatrixTranslationFromVector(FVecToDXVec(anchors.getLocation(index)));
+	XMMATRIX matRot = XMMatrixRotationRollPitchYawFromVector(FVecToDXVec(anchors.getRotation(index)));
+	XMMATRIX matScale = XMMatrixScalingFromVector(FVecToDXVec(anchors.getScale(index)));
 	actorMatrix *= matScale;
 	actorMatrix *= matRot;
 	actorMatrix *= matLoc;
 
 	D3DMATRIX d3dMatrix = ToD3DMATRIX(actorMatrix);
 
-	uint32_t hash = anchor.getHash();
+	uint32_t hash = anchors.getHash(index);
+
+	addAnchor(d3dMatrix, hash, ~hash);
 
-	renderAnchor(&d3dMatrix, texture, hash, ~hash);
+	unguard;
+}
+
+void UD3D9RenderDevice::setTexturePrecacheList(std::vector<TexPrecacheEntry>&& entries) {
+	guard(UD3D9RenderDevice::setTexturePrecacheList);
+	texPrecacheList = std::move(entries);
+	texPrecachePos = 0;
+	texPrecacheFrames = 0;
+	texPrecacheMs = 0.0;
+	unguard;
+}
+
+void UD3D9RenderDevice::precacheTextures(FSceneNode* frame) {
+	guard(UD3D9RenderDevice::precacheTextures);
+	if (texPrecachePos >= texPrecacheList.size()) {
+		return;
+	}
+
+	EndBuffering();
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	FTime currentTime = frame->Viewport->CurrentTime;
+
+	// A budget of 0 does the whole list in one go
+	while (texPrecachePos < texPrecacheList.size()) {
+		const TexPrecacheEntry& entry = texPrecacheList[texPrecachePos++];
+
+		// Skip textures that were collected since the list was made
+		UTexture* texture = Cast<UTexture>(UObject::GetIndexedObject(entry.textureIndex));
+		if (!texture || texture != entry.texture) {
+			continue;
+		}
+
+		FTextureInfo texInfo;
+#if UNREAL_GOLD_OLDUNREAL
+		texInfo = *texture->GetTexture(-1, this);
+#elif KLINGON_HONOR_GUARD
+		texture->GetInfo(texInfo, currentTime);
+#else
+		texture->Lock(texInfo, currentTime, -1, this);
+#endif
+		SetTextureNoPanBias(0, texInfo, entry.polyFlags);
+#if !UTGLR_NO_TEXTURE_UNLOCK
+		texture->Unlock(texInfo);
+#endif
+
+		if (TexPrecacheBudgetMs > 0.0f) {
+			std::chrono::duration<DOUBLE, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+			if (elapsed.count() >= TexPrecacheBudgetMs) {
+				break;
+			}
+		}
+	}
 
+	// The texture info above is gone, so don't leave its bind cached on the unit
+	SetNoTexture(0);
+
+	std::chrono::duration<DOUBLE, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+	texPrecacheMs += elapsed.count();
+	texPrecacheFrames++;
+
+	if (texPrecachePos >= texPrecacheList.size()) {
+		debugf(NAME_D3D9DrvRTX, TEXT("Precached %d textures in %.1f ms over %d frames"), (INT)texPrecacheList.size(), texPrecacheMs, texPrecacheFrames);
+		texPrecacheList.clear();
+		texPrecachePos = 0;
+	}
 	unguard;
 }
 
@@ -3885,12 +4454,31 @@ void UD3D9RenderDevice::GetStats(TCHAR* Result) {
 	double msPerCycle = GSecondsPerCycle * 1000.0f;
 	appSprintf( // stijn: mem safety NOT OK
 		Result,
-		TEXT("D3D9 stats: Bind=%04.1f Image=%04.1f Complex=%04.1f Gouraud=%04.1f Tile=%04.1f"),
+		TEXT("D3D9 stats: Bind=%04.1f Image=%04.1f Complex=%04.1f Gouraud=%04.1f Tile=%04.1f Tiles=%d Batches=%d TileBytes=%d CTRecs=%d/%d CTPeak=%d TexQueued=%d TexUploaded=%d TexStalls=%d TexDiskHits=%d TexDiskMisses=%d TexResMB=%.1f TexEvicted=%d TexBudgetEvicted=%d TexDirtyRows=%d TexDedupHits=%d TexDedupSavedMB=%.1f LightClusters=%d LightsMerged=%d"),
 		msPerCycle * BindCycles,
 		msPerCycle * ImageCycles,
 		msPerCycle * ComplexCycles,
 		msPerCycle * GouraudCycles,
-		msPerCycle * TileCycles
+		msPerCycle * TileCycles,
+		TileCount,
+		TileBatches,
+		TileBufferBytes,
+		m_CT_Allocator.used(),
+		m_CT_Allocator.allocated(),
+		m_CT_Allocator.peak(),
+		TexAsyncQueued,
+		TexAsyncUploaded,
+		TexStalls,
+		TexDiskHits,
+		TexDiskMisses,
+		m_texResidentBytes / (1024.0 * 1024.0),
+		TexEvictions,
+		TexBudgetEvictions,
+		TexDirtyRows,
+		TexDedupHits,
+		m_texDedupSavedBytes / (1024.0 * 1024.0),
+		LightClusters,
+		LightsMerged
 	);
 
 	unguard;
@@ -4204,45 +4792,25 @@ void UD3D9RenderDevice::InitNoTextureSafe(void) {
 void UD3D9RenderDevice::ScanForOldTextures(void) {
 	guard(UD3D9RenderDevice::ScanForOldTextures);
 
-	unsigned int u;
 	FCachedTexture *pCT;
 
 	//Prevent currently bound textures from being recycled
-	for (u = 0; u < MAX_TMUNITS; u++) {
-		FCachedTexture *pBind = TexInfo[u].pBind;
-		if (pBind != NULL) {
-			//Update last used frame count so that the texture will not be recycled
-			pBind->LastUsedFrameCount = m_currentFrameCount;
-
-			//Move node to tail of linked list if in LRU list
-			if (pBind->bindType == BIND_TYPE_NON_ZERO_PREFIX_LRU_LIST) {
-				m_nonZeroPrefixBindChain->unlink(pBind);
-				m_nonZeroPrefixBindChain->link_to_tail(pBind);
-			}
-		}
-	}
+	KeepBoundTextures();
 
 	pCT = m_nonZeroPrefixBindChain->begin();
 	while (pCT != m_nonZeroPrefixBindChain->end()) {
 		DWORD numFramesSinceUsed = m_currentFrameCount - pCT->LastUsedFrameCount;
 		if (numFramesSinceUsed > DynamicTexIdRecycleLevel) {
 			//See if the tex pool is not enabled, or the tex format is not RGBA8, or the texture has mipmaps
-			if (!UseTexPool || (pCT->texFormat != D3DFMT_A8R8G8B8) || (pCT->texParams.filter & CT_HAS_MIPMAPS_BIT)) {
-				//Remove node from linked list
-				m_nonZeroPrefixBindChain->unlink(pCT);
-
-				//Get pointer to node in bind map
-				QWORD_CTTree_t::node_t *pNode = (QWORD_CTTree_t::node_t *)((BYTE *)pCT - (PTRINT)&(((QWORD_CTTree_t::node_t *)0)->data));
-				//Extract tree index
-				BYTE treeIndex = pCT->treeIndex;
+			//Texture objects still used by identical textures cannot be handed out again either
+			if (!UseTexPool || (pCT->texFormat != D3DFMT_A8R8G8B8) || (pCT->texParams.filter & CT_HAS_MIPMAPS_BIT) || IsTexObjShared(pCT)) {
+				FCachedTexture *pOldCT = pCT;
 				//Advanced cached texture pointer to next entry in linked list
 				pCT = pCT->pNext;
 
-				//Remove node from bind map
-				m_nonZeroPrefixBindTrees[treeIndex].remove(pNode);
-
 				//Delete the texture
-				pNode->data.pTexObj->Release();
+				DeleteCachedTexture(pOldCT);
+				TexEvictions++;
 #if 0
 {
 	static int si;
@@ -4253,8 +4821,6 @@ void UD3D9RenderDevice::ScanForOldTextures(void) {
 				continue;
 			}
 			else {
-				TexPoolMap_t::node_t *texPoolPtr;
-
 #if 0
 {
 	static int si;
@@ -4269,28 +4835,27 @@ void UD3D9RenderDevice::ScanForOldTextures(void) {
 				//Create a key from the lg2 width and height of the texture object
 				TexPoolMapKey_t texPoolKey = MakeTexPoolMapKey(pCT->UBits, pCT->VBits);
 
-				//Get pointer to node in bind map
-				QWORD_CTTree_t::node_t *pNode = (QWORD_CTTree_t::node_t *)((BYTE *)pCT - (PTRINT)&(((QWORD_CTTree_t::node_t *)0)->data));
-				//Extract tree index
-				BYTE treeIndex = pCT->treeIndex;
+				FCachedTexture *pOldCT = pCT;
 				//Advanced cached texture pointer to next entry in linked list
 				pCT = pCT->pNext;
 
 				//Remove node from bind map
-				m_nonZeroPrefixBindTrees[treeIndex].remove(pNode);
-
-				//See if the key does not yet exist
-				texPoolPtr = m_RGBA8TexPool->find(texPoolKey);
-				//If the key does not yet exist, add an empty vector in its place
-				if (texPoolPtr == 0) {
-					texPoolPtr = m_TexPoolMap_Allocator.alloc_node();
-					texPoolPtr->key = texPoolKey;
-					texPoolPtr->data = QWORD_CTTree_NodePool_t();
-					m_RGBA8TexPool->insert(texPoolPtr);
+				m_nonZeroPrefixBindMap->remove(pOldCT->CacheID);
+
+				//Drop any pending background conversion, the next user overwrites the texture anyway
+				if (pOldCT->pConvertJob) {
+					pOldCT->pConvertJob->pBind = NULL;
+					pOldCT->pConvertJob = NULL;
 				}
+				FreeRealtimeShadow(pOldCT);
+
+				//The next user overwrites the contents, so identical textures must not find it anymore
+				ReleaseSharedTexObj(pOldCT);
+				evictRemixMaterials(pOldCT->CacheID);
 
-				//Add node plus texture id to a list in the tex pool based on its dimensions
-				texPoolPtr->data.add(pNode);
+				//Add node plus texture id to the head of a list in the tex pool based on its dimensions
+				pOldCT->pNext = m_RGBA8TexPool->find(texPoolKey);
+				m_RGBA8TexPool->insert(texPoolKey, pOldCT);
 
 				continue;
 			}
@@ -4306,6 +4871,326 @@ void UD3D9RenderDevice::ScanForOldTextures(void) {
 	unguard;
 }
 
+void UD3D9RenderDevice::KeepBoundTextures(void) {
+	for (unsigned int u = 0; u < MAX_TMUNITS; u++) {
+		FCachedTexture *pBind = TexInfo[u].pBind;
+		if (pBind != NULL) {
+			//Update last used frame count so that the texture will not be recycled
+			pBind->LastUsedFrameCount = m_currentFrameCount;
+
+			//Move node to tail of linked list if in LRU list
+			if (pBind->bindType == BIND_TYPE_NON_ZERO_PREFIX_LRU_LIST) {
+				m_nonZeroPrefixBindChain->unlink(pBind);
+				m_nonZeroPrefixBindChain->link_to_tail(pBind);
+			}
+		}
+	}
+}
+
+void UD3D9RenderDevice::DeleteCachedTexture(FCachedTexture *pCT) {
+	//Remove node from linked list
+	m_nonZeroPrefixBindChain->unlink(pCT);
+
+	//Remove node from bind map
+	m_nonZeroPrefixBindMap->remove(pCT->CacheID);
+
+	//Drop any pending background conversion
+	if (pCT->pConvertJob) {
+		pCT->pConvertJob->pBind = NULL;
+	}
+
+	//Delete the texture, the object stays alive while identical textures still use it
+	FreeRealtimeShadow(pCT);
+	evictRemixMaterials(pCT->CacheID);
+	if (!ReleaseSharedTexObj(pCT)) {
+		RemoveTexResidency(pCT);
+		pCT->pTexObj->Release();
+	}
+	m_CT_Allocator.free(pCT);
+}
+
+void UD3D9RenderDevice::EnforceTexMemBudget(void) {
+	guard(UD3D9RenderDevice::EnforceTexMemBudget);
+
+	if (TexMemBudgetMB <= 0) {
+		return;
+	}
+
+	//Start evicting above the budget and keep going down to the low water mark
+	//The gap keeps every frame near the budget from evicting again
+	QWORD budgetBytes = (QWORD)TexMemBudgetMB << 20;
+	if (m_texResidentBytes <= budgetBytes) {
+		return;
+	}
+	QWORD lowWaterBytes = (budgetBytes * Clamp(TexMemLowWaterPct, 0, 100)) / 100;
+
+	//Prevent currently bound textures from being evicted
+	KeepBoundTextures();
+
+	DWORD numEvicted = 0;
+
+	//Pooled textures are not used by anything, so they go first
+	m_RGBA8TexPool->for_each([this, &numEvicted](TexPoolMapKey_t, FCachedTexture *pCT) {
+		while (pCT != 0) {
+			FCachedTexture *pNextCT = pCT->pNext;
+			RemoveTexResidency(pCT);
+			pCT->pTexObj->Release();
+			m_CT_Allocator.free(pCT);
+			numEvicted++;
+			pCT = pNextCT;
+		}
+	});
+	m_RGBA8TexPool->clear();
+
+	//Then least recently used first, never touching textures used this frame
+	FCachedTexture *pCT = m_nonZeroPrefixBindChain->begin();
+	while ((m_texResidentBytes > lowWaterBytes) && (pCT != m_nonZeroPrefixBindChain->end())) {
+		if (pCT->LastUsedFrameCount == m_currentFrameCount) {
+			break;
+		}
+
+		FCachedTexture *pOldCT = pCT;
+		pCT = pCT->pNext;
+
+		DeleteCachedTexture(pOldCT);
+		numEvicted++;
+	}
+
+	TexBudgetEvictions += numEvicted;
+
+	//Bound textures can keep it over budget every frame, only log when something was freed
+	if (numEvicted == 0) {
+		return;
+	}
+
+	debugf(NAME_D3D9DrvRTX, TEXT("Texture budget of %d MB exceeded, evicted %d textures, %d KB resident (RGBA8 %d KB, 16-bit %d KB, DXT1 %d KB, DXT3 %d KB, DXT5 %d KB, other %d KB)"),
+		TexMemBudgetMB, numEvicted, (INT)(m_texResidentBytes >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_RGBA8] >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_16BIT] >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_DXT1] >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_DXT3] >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_DXT5] >> 10),
+		(INT)(m_texResidentFormatBytes[TEX_RES_FORMAT_OTHER] >> 10));
+
+	unguard;
+}
+
+UD3D9RenderDevice::tex_res_format_t UD3D9RenderDevice::GetTexResFormat(D3DFORMAT texFormat) {
+	switch (texFormat) {
+	case D3DFMT_A8R8G8B8:
+	case D3DFMT_X8R8G8B8:
+		return TEX_RES_FORMAT_RGBA8;
+	case D3DFMT_R5G6B5:
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		return TEX_RES_FORMAT_16BIT;
+	case D3DFMT_DXT1:
+		return TEX_RES_FORMAT_DXT1;
+	case D3DFMT_DXT3:
+		return TEX_RES_FORMAT_DXT3;
+	case D3DFMT_DXT5:
+		return TEX_RES_FORMAT_DXT5;
+	default:
+		return TEX_RES_FORMAT_OTHER;
+	}
+}
+
+DWORD UD3D9RenderDevice::CalcTexBytes(D3DFORMAT texFormat, DWORD UBits, DWORD VBits, DWORD numLevels) {
+	DWORD texBytes = 0;
+	DWORD width = 1U << UBits;
+	DWORD height = 1U << VBits;
+
+	for (DWORD level = 0; level < numLevels; level++) {
+		switch (texFormat) {
+		case D3DFMT_DXT1:
+			//8 bytes per 4x4 block
+			texBytes += ((width + 3) >> 2) * ((height + 3) >> 2) * 8;
+			break;
+		case D3DFMT_DXT3:
+		case D3DFMT_DXT5:
+			//16 bytes per 4x4 block
+			texBytes += ((width + 3) >> 2) * ((height + 3) >> 2) * 16;
+			break;
+		case D3DFMT_R5G6B5:
+		case D3DFMT_X1R5G5B5:
+		case D3DFMT_A1R5G5B5:
+			texBytes += width * height * 2;
+			break;
+		default:
+			texBytes += width * height * 4;
+		}
+
+		width = (width & 0x1) | (width >> 1);
+		height = (height & 0x1) | (height >> 1);
+	}
+
+	return texBytes;
+}
+
+QWORD UD3D9RenderDevice::HashTexContent(const FCachedTexture *pBind, FTextureInfo &Info, DWORD PolyFlags) {
+	guard(UD3D9RenderDevice::HashTexContent);
+
+	//Contents of realtime textures change after the first upload
+	if (Info.bRealtime || (pBind->BaseMip >= Info.NumMips)) {
+		return 0;
+	}
+
+	//Source bytes per texel, or per 4x4 block for compressed formats
+	DWORD unitBytes;
+	bool blocks = false;
+	switch (pBind->texType) {
+	case TEX_TYPE_COMPRESSED_DXT1:
+	case TEX_TYPE_COMPRESSED_DXT1_TO_DXT3:
+		unitBytes = 8;
+		blocks = true;
+		break;
+	case TEX_TYPE_COMPRESSED_DXT3:
+	case TEX_TYPE_COMPRESSED_DXT5:
+		unitBytes = 16;
+		blocks = true;
+		break;
+	case TEX_TYPE_HAS_PALETTE:
+		if (!Info.Palette) {
+			return 0;
+		}
+		unitBytes = 1;
+		break;
+	case TEX_TYPE_NORMAL:
+		unitBytes = 4;
+		break;
+	default:
+		return 0;
+	}
+
+#if !KLINGON_HONOR_GUARD
+	if (SupportsLazyTextures) {
+		Info.Load();
+	}
+#endif
+
+	//Everything the upload depends on besides the mips and palette
+	struct {
+		DWORD texType;
+		DWORD texFormat;
+		INT format;
+		BYTE UBits, VBits;
+		BYTE BaseMip, MaxLevel;
+		INT NumMips;
+		INT USize, VSize;
+		DWORD UClampVal, VClampVal;
+		DWORD masked;
+	} params;
+	appMemzero(&params, sizeof(params));
+	params.texType = pBind->texType;
+	params.texFormat = pBind->texFormat;
+	params.format = Info.Format;
+	params.UBits = pBind->UBits;
+	params.VBits = pBind->VBits;
+	params.BaseMip = pBind->BaseMip;
+	params.MaxLevel = pBind->MaxLevel;
+	params.NumMips = Info.NumMips;
+	params.USize = Info.USize;
+	params.VSize = Info.VSize;
+	params.UClampVal = pBind->UClampVal;
+	params.VClampVal = pBind->VClampVal;
+	params.masked = (PolyFlags & PF_Masked) ? 1 : 0;
+
+	XXH64_state_t state;
+	XXH64_reset(&state, 0);
+	XXH64_update(&state, &params, sizeof(params));
+	//Stepped levels are made from the last mip, so the mips from the base one on cover every level
+	for (INT MipIndex = pBind->BaseMip; MipIndex < Info.NumMips; MipIndex++) {
+		const FMipmapBase *Mip = Info.Mips[MipIndex];
+		if (!Mip->DataPtr) {
+			//Not loaded, so the contents are unknown
+			return 0;
+		}
+		DWORD mipBytes = blocks ?
+			((Mip->USize + 3) >> 2) * ((Mip->VSize + 3) >> 2) * unitBytes :
+			Mip->USize * Mip->VSize * unitBytes;
+		XXH64_update(&state, &Mip->USize, sizeof(Mip->USize));
+		XXH64_update(&state, &Mip->VSize, sizeof(Mip->VSize));
+		XXH64_update(&state, Mip->DataPtr, mipBytes);
+	}
+	if (pBind->texType == TEX_TYPE_HAS_PALETTE) {
+		XXH64_update(&state, Info.Palette, 256 * sizeof(FColor));
+	}
+
+	QWORD hash = XXH64_digest(&state);
+	//0 means not shareable
+	return hash ? hash : 1;
+	unguard;
+}
+
+bool UD3D9RenderDevice::TryShareTexObj(FCachedTexture *pBind, FTextureInfo &Info, DWORD PolyFlags) {
+	guard(UD3D9RenderDevice::TryShareTexObj);
+
+	pBind->contentHash = 0;
+	if (!TexDedup) {
+		return false;
+	}
+
+	pBind->contentHash = HashTexContent(pBind, Info, PolyFlags);
+	if (!pBind->contentHash) {
+		return false;
+	}
+
+	//Only textures that finished uploading are in the map
+	IDirect3DTexture9 *pTexObj = m_texSharedObjs.acquire(pBind->contentHash);
+	if (!pTexObj) {
+		return false;
+	}
+	pBind->pTexObj = pTexObj;
+
+	DWORD numLevels = (Info.NumMips == 1) ? 1 : (pBind->MaxLevel + 1);
+	pBind->texBytes = CalcTexBytes(pBind->texFormat, pBind->UBits, pBind->VBits, numLevels);
+	m_texDedupSavedBytes += pBind->texBytes;
+	TexDedupHits++;
+
+	return true;
+	unguard;
+}
+
+void UD3D9RenderDevice::PublishSharedTexObj(FCachedTexture *pBind) {
+	if (!pBind->contentHash) {
+		return;
+	}
+
+	//An identical texture may have finished first, this one then keeps its own object
+	if (!m_texSharedObjs.publish(pBind->contentHash, pBind->pTexObj)) {
+		pBind->contentHash = 0;
+	}
+}
+
+bool UD3D9RenderDevice::ReleaseSharedTexObj(FCachedTexture *pCT) {
+	if (!pCT->contentHash) {
+		return false;
+	}
+
+	//The last user frees the object and its residency like an unshared texture
+	QWORD contentHash = pCT->contentHash;
+	pCT->contentHash = 0;
+	if (!m_texSharedObjs.release(contentHash, pCT->pTexObj)) {
+		return false;
+	}
+
+	m_texDedupSavedBytes -= pCT->texBytes;
+	return true;
+}
+
+void UD3D9RenderDevice::CreateTexObj(FCachedTexture *pBind, const FTextureInfo &Info) {
+	DWORD numLevels = (Info.NumMips == 1) ? 1 : (pBind->MaxLevel + 1);
+	HRESULT hResult = m_d3dDevice->CreateTexture(
+		1U << pBind->UBits, 1U << pBind->VBits, numLevels,
+		0, pBind->texFormat, D3DPOOL_MANAGED, &pBind->pTexObj, NULL);
+	if (FAILED(hResult)) {
+		appErrorf(TEXT("CreateTexture failed: %ls"), *ExplainResult(hResult));
+	}
+
+	pBind->texBytes = CalcTexBytes(pBind->texFormat, pBind->UBits, pBind->VBits, numLevels);
+	AddTexResidency(pBind);
+}
+
 void UD3D9RenderDevice::SetNoTextureNoCheck(INT Multi) {
 	guard(UD3D9RenderDevice::SetNoTexture);
 
@@ -4326,13 +5211,32 @@ void UD3D9RenderDevice::SetNoTextureNoCheck(INT Multi) {
 	unguard;
 }
 
+void UD3D9RenderDevice::updateHashTexBlacklist() {
+	//Decisions are keyed by texture object, which the last level's textures may no longer be
+	hashTexDecisions.clear();
+
+	unsigned int generation = getConfigGeneration();
+	if (generation == hashTexBlacklistGeneration) {
+		return;
+	}
+	hashTexBlacklist = getHashTexBlacklist();
+	hashTexBlacklistGeneration = generation;
+}
+
 bool UD3D9RenderDevice::shouldGenHashTexture(const FTextureInfo& texInfo) {
 	if (!EnableHashTextures) {
 		return false;
 	}
 	if (texInfo.bRealtime) {
-		std::wstring name(appToUnicode(getTextureFromInfo(texInfo)->GetPathName()));
-		return !hashTexBlacklist.count(name);
+		UTexture* texture = getTextureFromInfo(texInfo);
+		auto it = hashTexDecisions.find(texture);
+		if (it != hashTexDecisions.end()) {
+			return it->second;
+		}
+		std::wstring name(appToUnicode(texture->GetPathName()));
+		bool genHashTex = !hashTexBlacklist.count(name);
+		hashTexDecisions.emplace(texture, genHashTex);
+		return genHashTex;
 	}
 	return false;
 }
@@ -4340,19 +5244,29 @@ bool UD3D9RenderDevice::shouldGenHashTexture(const FTextureInfo& texInfo) {
 void UD3D9RenderDevice::fillHashTexture(FTexConvertCtx convertContext, FTextureInfo& texInfo) {
 	const TCHAR* name = getTextureFromInfo(texInfo)->GetPathName();
 	debugf(NAME_D3D9DrvRTX, TEXT("Generating magic hash texture for '%s'"), name);
-	const unsigned int nameLen = FString(name).Len();
-	uint8_t* pTex = (uint8_t*) convertContext.lockRect.pBits;
-	unsigned int nameIdx = 0;
-	for (int y = 0; y < convertContext.texHeightPow2; y++) {
-		for (int x = 0; x < convertContext.texWidthPow2; x++) {
-			*pTex++ = name[nameIdx++] ^ 0x80; // B
-			if (nameIdx >= nameLen) nameIdx = 0;
-			*pTex++ = name[nameIdx++]; // G
-			if (nameIdx >= nameLen) nameIdx = 0;
-			*pTex++ = name[nameIdx++] ^ 0x80; // R
-			if (nameIdx >= nameLen) nameIdx = 0;
-			*pTex++ = 0xFF; // A
-		}
+	const DWORD nameLen = appStrlen(name);
+	const DWORD width = convertContext.texWidthPow2;
+
+	//The name is cycled through 3 characters per texel, so the texel pattern repeats every nameLen texels
+	//Build one period plus a row's worth of texels, then every row is a copy starting at its offset into the period
+	std::vector<DWORD> rowTemplate(nameLen + width);
+	DWORD nameIdx = 0;
+	for (DWORD t = 0; t < rowTemplate.size(); t++) {
+		DWORD b = (BYTE)(name[nameIdx] ^ 0x80);
+		if (++nameIdx >= nameLen) nameIdx = 0;
+		DWORD g = (BYTE)name[nameIdx];
+		if (++nameIdx >= nameLen) nameIdx = 0;
+		DWORD r = (BYTE)(name[nameIdx] ^ 0x80);
+		if (++nameIdx >= nameLen) nameIdx = 0;
+		rowTemplate[t] = 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+
+	BYTE* pTex = (BYTE*)convertContext.lockRect.pBits;
+	DWORD rowStart = 0;
+	for (DWORD y = 0; y < convertContext.texHeightPow2; y++) {
+		appMemcpy(pTex, &rowTemplate[rowStart], width * sizeof(DWORD));
+		pTex += convertContext.lockRect.Pitch;
+		rowStart = (rowStart + width) % nameLen;
 	}
 }
 
@@ -4362,28 +5276,25 @@ bool UD3D9RenderDevice::BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& I
 
 	FCachedTexture* pBind = NULL;
 	bool existingBind = false;
-	HRESULT hResult;
 
 	if (isZeroPrefixCacheID) {
 		DWORD CacheIDSuffix = (Tex.CurrentCacheID & 0x00000000FFFFFFFFULL);
 
-		DWORD_CTTree_t* zeroPrefixBindTree = &m_zeroPrefixBindTrees[CTZeroPrefixCacheIDSuffixToTreeIndex(CacheIDSuffix)];
-		DWORD_CTTree_t::node_t* bindTreePtr = zeroPrefixBindTree->find(CacheIDSuffix);
-		if (bindTreePtr != 0) {
-			pBind = &bindTreePtr->data;
+		pBind = m_zeroPrefixBindMap->find(CacheIDSuffix);
+		if (pBind != 0) {
 			existingBind = true;
 		}
 		else {
-			DWORD_CTTree_t::node_t* pNewNode;
-
 			//Insert new texture info
-			pNewNode = m_DWORD_CTTree_Allocator.alloc_node();
-			pNewNode->key = CacheIDSuffix;
-			zeroPrefixBindTree->insert(pNewNode);
-			pBind = &pNewNode->data;
+			pBind = m_CT_Allocator.alloc();
+			pBind->CacheID = Tex.CurrentCacheID;
+			m_zeroPrefixBindMap->insert(CacheIDSuffix, pBind);
 
 			//Set bind type
 			pBind->bindType = BIND_TYPE_ZERO_PREFIX;
+			pBind->pConvertJob = NULL;
+			pBind->pRealtimeShadow = NULL;
+			pBind->contentHash = 0;
 
 			//Set default tex params
 			pBind->texParams = CT_DEFAULT_TEX_PARAMS;
@@ -4398,23 +5309,16 @@ bool UD3D9RenderDevice::BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& I
 				dout << L"utd3d9r: Create texture zp = " << si++ << std::endl;
 			}
 #endif
-			//Create the texture
-			hResult = m_d3dDevice->CreateTexture(
-				1U << pBind->UBits, 1U << pBind->VBits, (Info.NumMips == 1) ? 1 : (pBind->MaxLevel + 1),
-				0, pBind->texFormat, D3DPOOL_MANAGED, &pBind->pTexObj, NULL);
-			if (FAILED(hResult)) {
-				appErrorf(TEXT("CreateTexture failed: %ls"), *ExplainResult(hResult));
+			//Reuse the texture object of an identical texture if there is one
+			if (!TryShareTexObj(pBind, Info, PolyFlags)) {
+				//Create the texture
+				CreateTexObj(pBind, Info);
 			}
 		}
 	}
 	else {
-		DWORD CacheIDSuffix = (Tex.CurrentCacheID & 0x00000000FFFFFFFFULL);
-		DWORD treeIndex = CTNonZeroPrefixCacheIDSuffixToTreeIndex(CacheIDSuffix);
-
-		QWORD_CTTree_t* nonZeroPrefixBindTree = &m_nonZeroPrefixBindTrees[treeIndex];
-		QWORD_CTTree_t::node_t* bindTreePtr = nonZeroPrefixBindTree->find(Tex.CurrentCacheID);
-		if (bindTreePtr != 0) {
-			pBind = &bindTreePtr->data;
+		pBind = m_nonZeroPrefixBindMap->find(Tex.CurrentCacheID);
+		if (pBind != 0) {
 			pBind->LastUsedFrameCount = m_currentFrameCount;
 
 			//Check if texture is in LRU list
@@ -4427,26 +5331,23 @@ bool UD3D9RenderDevice::BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& I
 			existingBind = true;
 		}
 		else {
-			QWORD_CTTree_t::node_t* pNewNode;
-
 			//Allocate a new node
 			//Use the node pool if it is not empty
-			pNewNode = m_nonZeroPrefixNodePool.try_remove();
-			if (!pNewNode) {
-				pNewNode = m_QWORD_CTTree_Allocator.alloc_node();
+			pBind = m_nonZeroPrefixNodePool.try_remove();
+			if (!pBind) {
+				pBind = m_CT_Allocator.alloc();
 			}
 
 			//Insert new texture info
-			pNewNode->key = Tex.CurrentCacheID;
-			nonZeroPrefixBindTree->insert(pNewNode);
-			pBind = &pNewNode->data;
+			pBind->CacheID = Tex.CurrentCacheID;
+			m_nonZeroPrefixBindMap->insert(Tex.CurrentCacheID, pBind);
 			pBind->LastUsedFrameCount = m_currentFrameCount;
 
 			//Set bind type
 			pBind->bindType = BIND_TYPE_NON_ZERO_PREFIX_LRU_LIST;
-
-			//Save tree index
-			pBind->treeIndex = (BYTE)treeIndex;
+			pBind->pConvertJob = NULL;
+			pBind->pRealtimeShadow = NULL;
+			pBind->contentHash = 0;
 
 			//Set default tex params
 			pBind->texParams = CT_DEFAULT_TEX_PARAMS;
@@ -4468,48 +5369,55 @@ bool UD3D9RenderDevice::BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& I
 			//Cache texture info for the new texture
 			CacheTextureInfo(pBind, Info, PolyFlags);
 
-			//See if the tex pool is enabled
 			bool needTexIdAllocate = true;
-			if (UseTexPool) {
+
+			//Reuse the texture object of an identical texture if there is one
+			if (TryShareTexObj(pBind, Info, PolyFlags)) {
+				needTexIdAllocate = false;
+			}
+
+			//See if the tex pool is enabled
+			if (needTexIdAllocate && UseTexPool) {
 				//See if the format will be RGBA8
 				//Only textures without mipmaps are stored in the tex pool
 				if ((pBind->texType == TEX_TYPE_NORMAL) && (Info.NumMips == 1)) {
-					TexPoolMap_t::node_t* texPoolPtr;
+					FCachedTexture* texPoolNodePtr;
 
 					//Create a key from the lg2 width and height of the texture object
 					TexPoolMapKey_t texPoolKey = MakeTexPoolMapKey(pBind->UBits, pBind->VBits);
 
-					//Search for the key in the map
-					texPoolPtr = m_RGBA8TexPool->find(texPoolKey);
-					if (texPoolPtr != 0) {
-						QWORD_CTTree_NodePool_t::node_t* texPoolNodePtr;
-
-						//Get a reference to the pool of nodes with tex ids of the right dimension
-						QWORD_CTTree_NodePool_t& texPool = texPoolPtr->data;
+					//Search for a list of nodes with tex ids of the right dimension
+					texPoolNodePtr = m_RGBA8TexPool->find(texPoolKey);
+					if (texPoolNodePtr != 0) {
+						//Pop the head of the list, dropping the key once the list is empty
+						if (texPoolNodePtr->pNext != 0) {
+							m_RGBA8TexPool->insert(texPoolKey, texPoolNodePtr->pNext);
+						}
+						else {
+							m_RGBA8TexPool->remove(texPoolKey);
+						}
 
-						//Attempt to get a texture id for the tex pool
-						if ((texPoolNodePtr = texPool.try_remove()) != 0) {
-							//Use texture id from node in tex pool
-							pBind->pTexObj = texPoolNodePtr->data.pTexObj;
+						//Use texture id from node in tex pool, it is already counted as resident
+						pBind->pTexObj = texPoolNodePtr->pTexObj;
+						pBind->texBytes = texPoolNodePtr->texBytes;
 
-							//Use tex params from node in tex pool
-							pBind->texParams = texPoolNodePtr->data.texParams;
-							pBind->dynamicTexBits = texPoolNodePtr->data.dynamicTexBits;
+						//Use tex params from node in tex pool
+						pBind->texParams = texPoolNodePtr->texParams;
+						pBind->dynamicTexBits = texPoolNodePtr->dynamicTexBits;
 
-							//Then add node to free list
-							m_nonZeroPrefixNodePool.add(texPoolNodePtr);
+						//Then add node to free list
+						m_nonZeroPrefixNodePool.add(texPoolNodePtr);
 
 #if 0
-							{
-								static int si;
-								dout << L"utd3d9r: TexPool retrieve = " << si++ << L", Id = 0x" << HexString((DWORD)pBind->pTexObj, 32)
-									<< L", u = " << pBind->UBits << L", v = " << pBind->VBits << std::endl;
-							}
+						{
+							static int si;
+							dout << L"utd3d9r: TexPool retrieve = " << si++ << L", Id = 0x" << HexString((DWORD)pBind->pTexObj, 32)
+								<< L", u = " << pBind->UBits << L", v = " << pBind->VBits << std::endl;
+						}
 #endif
 
-							//Clear the need tex id allocate flag
-							needTexIdAllocate = false;
-						}
+						//Clear the need tex id allocate flag
+						needTexIdAllocate = false;
 					}
 				}
 			}
@@ -4521,12 +5429,7 @@ bool UD3D9RenderDevice::BindTexture(DWORD texNum, FTexInfo& Tex, FTextureInfo& I
 				}
 #endif
 				//Create the texture
-				hResult = m_d3dDevice->CreateTexture(
-					1U << pBind->UBits, 1U << pBind->VBits, (Info.NumMips == 1) ? 1 : (pBind->MaxLevel + 1),
-					0, pBind->texFormat, D3DPOOL_MANAGED, &pBind->pTexObj, NULL);
-				if (FAILED(hResult)) {
-					appErrorf(TEXT("CreateTexture failed: %ls"), *ExplainResult(hResult));
-				}
+				CreateTexObj(pBind, Info);
 			}
 		}
 	}
@@ -4547,8 +5450,8 @@ void UD3D9RenderDevice::SetTextureNoCheck(DWORD texNum, FTexInfo& Tex, FTextureI
 	//Save pointer to current texture bind for current texture unit
 	Tex.pBind = pBind;
 
-	//Set texture
-	m_d3dDevice->SetTexture(texNum, pBind->pTexObj);
+	//Set texture, drawing the placeholder until a background conversion is uploaded
+	m_d3dDevice->SetTexture(texNum, pBind->pConvertJob ? m_pNoTexObj : pBind->pTexObj);
 
 	unclockFast(BindCycles);
 
@@ -4613,9 +5516,22 @@ void UD3D9RenderDevice::SetTextureNoCheck(DWORD texNum, FTexInfo& Tex, FTextureI
 #endif
 
 	// Upload if needed.
-	if (!existingBind || (Info.bRealtimeChanged && !shouldGenHashTexture(Info))) {
+	if (!existingBind || (Info.bRealtimeChanged && (pBind->texType != TEX_TYPE_CACHE_GEN))) {
 		FColor paletteIndex0;
 
+		//A pending background conversion would overwrite this upload, so finish it first
+		if (pBind->pConvertJob) {
+			WaitForTexConvertJob(pBind);
+		}
+
+		//Changed contents must not show up in identical textures sharing the object, or be found by new ones
+		if (existingBind && ReleaseSharedTexObj(pBind)) {
+			//The new object is empty, so the whole texture is uploaded
+			FreeRealtimeShadow(pBind);
+			CreateTexObj(pBind, Info);
+			m_d3dDevice->SetTexture(texNum, pBind->pTexObj);
+		}
+
 		// Cleanup texture flags.
 #if !KLINGON_HONOR_GUARD
 		if (SupportsLazyTextures) {
@@ -4678,183 +5594,847 @@ void UD3D9RenderDevice::SetTextureNoCheck(DWORD texNum, FTexInfo& Tex, FTextureI
 		m_texConvertCtx.texWidthPow2 = 1 << pBind->UBits;
 		m_texConvertCtx.texHeightPow2 = 1 << pBind->VBits;
 
-		guard(WriteTexture);
-		INT Level;
-		for (Level = 0; Level <= MaxUploadLevel; Level++) {
-			// Convert the mipmap.
-			INT MipIndex = pBind->BaseMip + Level;
-			INT stepBits = 0;
-			if (MipIndex >= Info.NumMips && Info.NumMips > 0) {
-				stepBits = MipIndex - (Info.NumMips - 1);
-				MipIndex = Info.NumMips - 1;
-			}
-			m_texConvertCtx.stepBits = stepBits;
+		//Binds sharing the texture object of an identical texture have nothing to upload
+		bool uploaded = !existingBind && IsTexObjShared(pBind);
 
-			FMipmapBase* Mip = Info.Mips[MipIndex];
-			if (!Mip->DataPtr) {
-				//Skip looking at any subsequent mipmap pointers
-				break;
-			}
-			else {
-				//Lock texture level
-				HRESULT hResult = pBind->pTexObj->LockRect(Level, &m_texConvertCtx.lockRect, NULL, D3DLOCK_NOSYSLOCK);
-				if (FAILED(hResult)) {
-					appErrorf(TEXT("Texture lock failed: %ls"), *ExplainResult(hResult));
-				}
+		//Realtime textures seen before only upload the rows that changed
+		if (existingBind && pBind->pRealtimeShadow) {
+			uploaded = UpdateRealtimeTexture(pBind, Info, MaxUploadLevel);
+		}
 
-				//Texture data copy and potential conversion if necessary
-				switch (pBind->texType) {
-				case TEX_TYPE_COMPRESSED_DXT1:
-					guard(ConvertDXT1_DXT1);
-					ConvertDXT1_DXT1(Mip, Level);
-					unguard;
-					break;
+		//New textures that only need a plain conversion can come from the disk cache or go to the background worker
+		std::vector<FTexConvertJob::level_t> convertLevels;
+		DWORD convertSrcSize = 0;
+		DWORD convertDstSize = 0;
+		bool plainConvert = false;
+		if (!uploaded && !existingBind && !Info.bRealtime && (AsyncTextureUpload || m_texDiskCache.is_open())) {
+			plainConvert = GetTexConvertLayout(pBind, Info, MaxUploadLevel, convertLevels, convertSrcSize, convertDstSize);
+		}
 
-				case TEX_TYPE_COMPRESSED_DXT1_TO_DXT3:
-					guard(ConvertDXT1_DXT3);
-					ConvertDXT1_DXT3(Mip, Level);
-					unguard;
-					break;
+		QWORD diskCacheKey = 0;
+		if (plainConvert && m_texDiskCache.is_open()) {
+			diskCacheKey = HashTexConvertSource(pBind, Info, convertLevels);
+			uploaded = LoadTexFromDiskCache(pBind, convertLevels, convertDstSize, diskCacheKey);
+		}
 
-				case TEX_TYPE_COMPRESSED_DXT3:
-					guard(ConvertDXT3);
-					ConvertDXT35_DXT35(Mip, Level);
-					unguard;
-					break;
+		//The placeholder is drawn until the result is uploaded at the end of a frame
+		if (!uploaded && plainConvert && AsyncTextureUpload) {
+			QueueTexConvertJob(pBind, Info, convertLevels, convertSrcSize, convertDstSize, diskCacheKey);
+			m_d3dDevice->SetTexture(texNum, m_pNoTexObj);
+			TexAsyncQueued++;
+			uploaded = true;
+		}
 
-				case TEX_TYPE_COMPRESSED_DXT5:
-					guard(ConvertDXT5);
-					ConvertDXT35_DXT35(Mip, Level);
-					unguard;
-					break;
+		if (!uploaded) {
+			//Packed copy of the converted levels for the disk cache
+			std::vector<BYTE> diskCacheData;
+			if (diskCacheKey) {
+				diskCacheData.resize(convertDstSize);
+			}
+
+			guard(WriteTexture);
+			INT Level;
+			for (Level = 0; Level <= MaxUploadLevel; Level++) {
+				// Convert the mipmap.
+				INT MipIndex = pBind->BaseMip + Level;
+				INT stepBits = 0;
+				if (MipIndex >= Info.NumMips && Info.NumMips > 0) {
+					stepBits = MipIndex - (Info.NumMips - 1);
+					MipIndex = Info.NumMips - 1;
+				}
+				m_texConvertCtx.stepBits = stepBits;
 
-				case TEX_TYPE_PALETTED:
-					//Not supported
+				FMipmapBase* Mip = Info.Mips[MipIndex];
+				if (!Mip->DataPtr) {
+					//Skip looking at any subsequent mipmap pointers
 					break;
+				}
+				else {
+					//Lock texture level
+					HRESULT hResult = pBind->pTexObj->LockRect(Level, &m_texConvertCtx.lockRect, NULL, D3DLOCK_NOSYSLOCK);
+					if (FAILED(hResult)) {
+						appErrorf(TEXT("Texture lock failed: %ls"), *ExplainResult(hResult));
+					}
 
-				case TEX_TYPE_HAS_PALETTE:
-					switch (pBind->texFormat) {
-					case D3DFMT_R5G6B5:
-						guard(ConvertP8_RGB565);
-						if (stepBits == 0) {
-							ConvertP8_RGB565_NoStep(Mip, Info.Palette, Level);
-						}
-						else {
-							ConvertP8_RGB565(Mip, Info.Palette, Level);
-						}
+					//Texture data copy and potential conversion if necessary
+					if (pBind->texType == TEX_TYPE_CACHE_GEN) {
+						guard(fillHashTexture);
+						fillHashTexture(m_texConvertCtx, Info);
 						unguard;
-						break;
+					}
+					else {
+						ConvertTextureMip(m_texConvertCtx, Mip, Info.Palette, Info.Format, Level);
+					}
 
-					case D3DFMT_X1R5G5B5:
-					case D3DFMT_A1R5G5B5:
-						guard(ConvertP8_RGBA5551);
-						if (stepBits == 0) {
-							ConvertP8_RGBA5551_NoStep(Mip, Info.Palette, Level);
-						}
-						else {
-							ConvertP8_RGBA5551(Mip, Info.Palette, Level);
+					//Keep the converted rows for the disk cache
+					if (diskCacheKey) {
+						const FTexConvertJob::level_t &level = convertLevels[Level];
+						const BYTE *pSrc = (const BYTE *)m_texConvertCtx.lockRect.pBits;
+						BYTE *pDst = &diskCacheData[level.dstOffset];
+						for (DWORD row = 0; row < level.dstHeight; row++) {
+							appMemcpy(pDst, pSrc, level.dstPitch);
+							pSrc += m_texConvertCtx.lockRect.Pitch;
+							pDst += level.dstPitch;
 						}
-						unguard;
-						break;
+					}
 
-					default:
-						guard(ConvertP8_RGBA8888);
-						if (stepBits == 0) {
-							ConvertP8_RGBA8888_NoStep(Mip, Info.Palette, Level);
-						}
-						else {
-							ConvertP8_RGBA8888(Mip, Info.Palette, Level);
-						}
-						unguard;
+					DWORD texWidth, texHeight;
+
+					//Get current texture width and height
+					texWidth = m_texConvertCtx.texWidthPow2;
+					texHeight = m_texConvertCtx.texHeightPow2;
+
+					//Calculate and save next texture width and height
+					//Both are divided by two down to a floor of 1
+					//Texture width and height must be even powers of 2 for the following code to work
+					m_texConvertCtx.texWidthPow2 = (texWidth & 0x1) | (texWidth >> 1);
+					m_texConvertCtx.texHeightPow2 = (texHeight & 0x1) | (texHeight >> 1);
+
+					//Unlock texture level
+					hResult = pBind->pTexObj->UnlockRect(Level);
+					if (FAILED(hResult)) {
+						appErrorf(TEXT("Texture unlock failed: %ls"), *ExplainResult(hResult));
 					}
+				}
+			}
+			unguard;
+
+			if (diskCacheKey) {
+				m_texDiskCache.write(diskCacheKey, &diskCacheData[0], convertDstSize);
+			}
+
+			//Remember the source of realtime textures so the next change can be uploaded by dirty rows
+			if (Info.bRealtime && !CaptureRealtimeShadow(pBind, Info, MaxUploadLevel)) {
+				FreeRealtimeShadow(pBind);
+			}
+		}
+
+		unclockFast(ImageCycles);
+
+		//Restore palette index 0 for masked paletted textures
+		if (Info.Palette && (PolyFlags & PF_Masked)) {
+			Info.Palette[0] = paletteIndex0;
+		}
+
+		// Cleanup.
+#if !KLINGON_HONOR_GUARD
+		if (SupportsLazyTextures) {
+			Info.Unload();
+		}
+#endif
+
+		//Identical textures can use the texture object once its contents are in place
+		if (!existingBind && !pBind->pConvertJob) {
+			PublishSharedTexObj(pBind);
+		}
+	}
+
+	//Set texture filter parameters
+	SetTexFilter(texNum, pBind->texParams.filter);
+
+	unguard;
+}
+
+bool UD3D9RenderDevice::GetTexConvertLayout(const FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel, std::vector<FTexConvertJob::level_t> &levels, DWORD &srcSize, DWORD &dstSize) {
+	guard(UD3D9RenderDevice::GetTexConvertLayout);
+
+	//Only plain and paletted conversions are handled, DXT uploads are copies
+	DWORD srcTexelBytes;
+	switch (pBind->texType) {
+	case TEX_TYPE_NORMAL:
+		srcTexelBytes = 4;
+		break;
+	case TEX_TYPE_HAS_PALETTE:
+		if (!Info.Palette) {
+			return false;
+		}
+		srcTexelBytes = 1;
+		break;
+	default:
+		return false;
+	}
+
+	DWORD dstTexelBytes;
+	switch (pBind->texFormat) {
+	case D3DFMT_R5G6B5:
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		dstTexelBytes = 2;
+		break;
+	default:
+		dstTexelBytes = 4;
+	}
+
+	//Lay out the source snapshot and the tightly packed output for each level
+	levels.clear();
+	srcSize = 0;
+	dstSize = 0;
+	DWORD texWidth = 1U << pBind->UBits;
+	DWORD texHeight = 1U << pBind->VBits;
+	for (INT Level = 0; Level <= MaxUploadLevel; Level++) {
+		INT MipIndex = pBind->BaseMip + Level;
+		if (MipIndex >= Info.NumMips) {
+			//Stepped levels stay on the synchronous path
+			return false;
+		}
+		const FMipmapBase *Mip = Info.Mips[MipIndex];
+		if (!Mip->DataPtr) {
+			break;
+		}
+
+		FTexConvertJob::level_t level;
+		level.UBits = Mip->UBits;
+		level.VBits = Mip->VBits;
+		level.USize = Mip->USize;
+		level.VSize = Mip->VSize;
+		level.srcOffset = srcSize;
+		level.srcSize = Mip->USize * Mip->VSize * srcTexelBytes;
+		level.dstOffset = dstSize;
+		level.dstPitch = texWidth * dstTexelBytes;
+		level.dstWidth = texWidth;
+		level.dstHeight = texHeight;
+		levels.push_back(level);
+
+		srcSize += level.srcSize;
+		dstSize += level.dstPitch * texHeight;
+
+		texWidth = (texWidth & 0x1) | (texWidth >> 1);
+		texHeight = (texHeight & 0x1) | (texHeight >> 1);
+	}
+
+	return !levels.empty();
+	unguard;
+}
+
+QWORD UD3D9RenderDevice::HashTexConvertSource(const FCachedTexture *pBind, const FTextureInfo &Info, const std::vector<FTexConvertJob::level_t> &levels) {
+	guard(UD3D9RenderDevice::HashTexConvertSource);
+
+	//Everything the converters look at, LOD bias and the size limits show up through the chosen mips and bind size
+	struct {
+		DWORD version;
+		DWORD texType;
+		DWORD texFormat;
+		INT format;
+		BYTE UBits, VBits;
+		WORD numLevels;
+		DWORD UClampVal, VClampVal;
+	} params;
+	appMemzero(&params, sizeof(params));
+	params.version = 1;
+	params.texType = pBind->texType;
+	params.texFormat = pBind->texFormat;
+	params.format = Info.Format;
+	params.UBits = pBind->UBits;
+	params.VBits = pBind->VBits;
+	params.numLevels = (WORD)levels.size();
+	params.UClampVal = pBind->UClampVal;
+	params.VClampVal = pBind->VClampVal;
+
+	XXH64_state_t state;
+	XXH64_reset(&state, 0);
+	XXH64_update(&state, &params, sizeof(params));
+	for (UINT u = 0; u < levels.size(); u++) {
+		const FTexConvertJob::level_t &level = levels[u];
+		XXH64_update(&state, &level.USize, sizeof(level.USize));
+		XXH64_update(&state, &level.VSize, sizeof(level.VSize));
+		XXH64_update(&state, Info.Mips[pBind->BaseMip + u]->DataPtr, level.srcSize);
+	}
+	if (pBind->texType == TEX_TYPE_HAS_PALETTE) {
+		XXH64_update(&state, Info.Palette, 256 * sizeof(FColor));
+	}
+
+	QWORD key = XXH64_digest(&state);
+	//0 means no key
+	return key ? key : 1;
+	unguard;
+}
+
+void UD3D9RenderDevice::WriteTexLevels(FCachedTexture *pBind, const std::vector<FTexConvertJob::level_t> &levels, const BYTE *pData) {
+	guard(UD3D9RenderDevice::WriteTexLevels);
+
+	HRESULT hResult;
+
+	for (UINT u = 0; u < levels.size(); u++) {
+		const FTexConvertJob::level_t &level = levels[u];
+		D3DLOCKED_RECT lockRect;
+
+		//Lock texture level
+		hResult = pBind->pTexObj->LockRect(u, &lockRect, NULL, D3DLOCK_NOSYSLOCK);
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Texture lock failed: %ls"), *ExplainResult(hResult));
+		}
+
+		//Copy the packed rows
+		const BYTE *pSrc = pData + level.dstOffset;
+		BYTE *pDst = (BYTE *)lockRect.pBits;
+		for (DWORD row = 0; row < level.dstHeight; row++) {
+			appMemcpy(pDst, pSrc, level.dstPitch);
+			pSrc += level.dstPitch;
+			pDst += lockRect.Pitch;
+		}
+
+		//Unlock texture level
+		hResult = pBind->pTexObj->UnlockRect(u);
+		if (FAILED(hResult)) {
+			appErrorf(TEXT("Texture unlock failed: %ls"), *ExplainResult(hResult));
+		}
+	}
+
+	unguard;
+}
+
+bool UD3D9RenderDevice::LoadTexFromDiskCache(FCachedTexture *pBind, const std::vector<FTexConvertJob::level_t> &levels, DWORD dstSize, QWORD key) {
+	guard(UD3D9RenderDevice::LoadTexFromDiskCache);
+
+	const BYTE *pData = m_texDiskCache.lock(key, dstSize);
+	if (!pData) {
+		TexDiskMisses++;
+		return false;
+	}
+
+	WriteTexLevels(pBind, levels, pData);
+	m_texDiskCache.unlock();
+
+	TexDiskHits++;
+
+	return true;
+	unguard;
+}
+
+//Converts a palette to swizzled 32-bit texels for the row proc palette lookup
+static void BuildP8_RGBA8888Palette(const FColor *Palette, unsigned int *pPalette) {
+	for (INT k = 0; k < 256; k++) {
+		DWORD dwColor = GET_COLOR_DWORD(Palette[k]);
+#if !UTGLR_NO_PALETTE_ALPHA_FIX
+		if (k != 0) dwColor |= 0xFF000000; // Set alpha to 1
+#endif
+		pPalette[k] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
+	}
+}
+
+const std::wstring& UD3D9RenderDevice::getRemixTextureFile(FTextureInfo& texInfo, DWORD polyFlags) {
+	guard(UD3D9RenderDevice::getRemixTextureFile);
+
+	UTexture* texture = getTextureFromInfo(texInfo);
+	auto fileIt = remixTextureFiles.find(texture);
+	if (fileIt != remixTextureFiles.end()) {
+		return fileIt->second;
+	}
+	std::wstring& fileName = remixTextureFiles[texture];
+
+#if !KLINGON_HONOR_GUARD
+	if (SupportsLazyTextures) {
+		texInfo.Load();
+	}
+#endif
+	const FMipmapBase* Mip = texInfo.Mips[0];
+	if (!Mip || !Mip->DataPtr) {
+		return fileName;
+	}
+
+	CDDSFile::format_t format;
+	const void* pData = Mip->DataPtr;
+	std::vector<unsigned int> convertedData;
+	switch (texInfo.Format) {
+	case TEXF_P8:
+	{
+		if (!texInfo.Palette) {
+			return fileName;
+		}
+		unsigned int palette[256];
+		BuildP8_RGBA8888Palette(texInfo.Palette, palette);
+		if (polyFlags & PF_Masked) {
+			palette[0] = 0;
+		}
+		convertedData.resize(Mip->USize * Mip->VSize);
+		m_texConv.pPalette(convertedData.data(), Mip->DataPtr, palette, static_cast<unsigned int>(convertedData.size()));
+		pData = convertedData.data();
+		format = CDDSFile::FORMAT_BGRA8;
+		break;
+	}
+	case TEXF_DXT1:
+		format = CDDSFile::FORMAT_DXT1;
+		break;
+#if UNREAL_TOURNAMENT_OLDUNREAL || UNREAL_GOLD_OLDUNREAL
+	case TEXF_DXT3:
+		format = CDDSFile::FORMAT_DXT3;
+		break;
+	case TEXF_DXT5:
+		format = CDDSFile::FORMAT_DXT5;
+		break;
+	case TEXF_BGRA8:
+		format = CDDSFile::FORMAT_BGRA8;
+		break;
+	case TEXF_RGBA8_:
+		format = CDDSFile::FORMAT_RGBA8;
+		break;
+#elif BROTHER_BEAR
+	case TEXF_RGBA8:
+		// Uploaded as BGRA8 too
+		format = CDDSFile::FORMAT_BGRA8;
+		break;
+#endif
+	default:
+		return fileName;
+	}
+	unsigned int dataSize = CDDSFile::data_size(format, Mip->USize, Mip->VSize);
+
+	// Content in the name, so a changed texture never picks up an old file
+	XXH64_hash_t contentHash = XXH64(pData, dataSize, 0);
+	wchar_t hashStr[17];
+	swprintf(hashStr, 17, L"%016llx", static_cast<unsigned long long>(contentHash));
+	std::wstring dir = std::wstring(appToUnicode(appBaseDir())) + L"RemixTextures";
+	std::wstring path = dir + L"\\" + appToUnicode(texture->GetPathName()) + L"_" + hashStr + L".dds";
+
+	if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES) {
+		CreateDirectoryW(dir.c_str(), NULL);
+		if (!CDDSFile::write(path.c_str(), format, Mip->USize, Mip->VSize, pData)) {
+			debugf(NAME_D3D9DrvRTX, TEXT("Failed to write RTX Remix texture file for %s"), texture->GetPathName());
+			return fileName;
+		}
+	}
+	fileName = std::move(path);
+	return fileName;
+
+	unguard;
+}
+
+bool UD3D9RenderDevice::CaptureRealtimeShadow(FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel) {
+	guard(UD3D9RenderDevice::CaptureRealtimeShadow);
+
+	//Only paletted textures expanded to 32-bit, which covers the procedural fire, water, wave and ice textures
+	if ((pBind->texType != TEX_TYPE_HAS_PALETTE) || (pBind->texFormat != D3DFMT_A8R8G8B8)) {
+		return false;
+	}
+
+	std::vector<FTexConvertJob::level_t> levels;
+	DWORD srcSize, dstSize;
+	if (!GetTexConvertLayout(pBind, Info, MaxUploadLevel, levels, srcSize, dstSize)) {
+		return false;
+	}
+
+	//Rows can only be converted on their own if every source texel lands on exactly one texel
+	for (UINT u = 0; u < levels.size(); u++) {
+		const FTexConvertJob::level_t &level = levels[u];
+		if (((DWORD)level.USize != level.dstWidth) || ((DWORD)level.VSize != level.dstHeight)) {
+			return false;
+		}
+	}
+
+	FTexRealtimeShadow *pShadow = pBind->pRealtimeShadow;
+	if (!pShadow) {
+		pShadow = new FTexRealtimeShadow;
+		pBind->pRealtimeShadow = pShadow;
+	}
+	pShadow->levels.swap(levels);
+	pShadow->srcData.resize(srcSize);
+	for (UINT u = 0; u < pShadow->levels.size(); u++) {
+		const FTexConvertJob::level_t &level = pShadow->levels[u];
+		appMemcpy(&pShadow->srcData[level.srcOffset], Info.Mips[pBind->BaseMip + u]->DataPtr, level.srcSize);
+	}
+	appMemcpy(pShadow->palette, Info.Palette, sizeof(pShadow->palette));
+	pShadow->staleMips = false;
+
+	return true;
+	unguard;
+}
+
+bool UD3D9RenderDevice::UpdateRealtimeTexture(FCachedTexture *pBind, const FTextureInfo &Info, INT MaxUploadLevel) {
+	guard(UD3D9RenderDevice::UpdateRealtimeTexture);
+
+	//Rows compared and uploaded together
+	const DWORD DIRTY_BLOCK_ROWS = 8;
+
+	FTexRealtimeShadow *pShadow = pBind->pRealtimeShadow;
+
+	//A new palette changes every texel, and the level layout must still match
+	if (!Info.Palette || (appMemcmp(pShadow->palette, Info.Palette, sizeof(pShadow->palette)) != 0)) {
+		return false;
+	}
+	if ((INT)pShadow->levels.size() != (MaxUploadLevel + 1)) {
+		return false;
+	}
+
+	//Lower levels are only worth updating if the filter samples them
+	bool mipsSampled = (pBind->texParams.filter & CT_MIP_FILTER_MASK) != CT_MIP_FILTER_NONE;
+	if (mipsSampled && pShadow->staleMips) {
+		return false;
+	}
+
+	unsigned int palette[256];
+	BuildP8_RGBA8888Palette(Info.Palette, palette);
+	CTexConv::palette_proc_t paletteProc = m_texConv.pPalette;
+
+	for (UINT u = 0; u < pShadow->levels.size(); u++) {
+		const FTexConvertJob::level_t &level = pShadow->levels[u];
+		const FMipmapBase *Mip = Info.Mips[pBind->BaseMip + u];
+		if (!Mip->DataPtr || (Mip->USize != level.USize) || (Mip->VSize != level.VSize)) {
+			return false;
+		}
+
+		if ((u > 0) && !mipsSampled) {
+			pShadow->staleMips = true;
+			break;
+		}
+
+		const BYTE *pSrc = (const BYTE *)Mip->DataPtr;
+		BYTE *pShadowSrc = &pShadow->srcData[level.srcOffset];
+		DWORD rowBytes = level.USize;
+		DWORD numRows = level.VSize;
+
+		DWORD row = 0;
+		while (row < numRows) {
+			//Skip clean blocks
+			DWORD blockRows = Min(DIRTY_BLOCK_ROWS, numRows - row);
+			if (appMemcmp(pSrc + (row * rowBytes), pShadowSrc + (row * rowBytes), blockRows * rowBytes) == 0) {
+				row += blockRows;
+				continue;
+			}
+
+			//Extend over the following dirty blocks
+			DWORD dirtyStart = row;
+			row += blockRows;
+			while (row < numRows) {
+				blockRows = Min(DIRTY_BLOCK_ROWS, numRows - row);
+				if (appMemcmp(pSrc + (row * rowBytes), pShadowSrc + (row * rowBytes), blockRows * rowBytes) == 0) {
+					break;
+				}
+				row += blockRows;
+			}
+
+			//Convert and upload only the dirty rows
+			RECT dirtyRect;
+			dirtyRect.left = 0;
+			dirtyRect.top = dirtyStart;
+			dirtyRect.right = level.dstWidth;
+			dirtyRect.bottom = row;
+
+			D3DLOCKED_RECT lockRect;
+			HRESULT hResult = pBind->pTexObj->LockRect(u, &lockRect, &dirtyRect, D3DLOCK_NOSYSLOCK);
+			if (FAILED(hResult)) {
+				appErrorf(TEXT("Texture lock failed: %ls"), *ExplainResult(hResult));
+			}
+
+			BYTE *pDst = (BYTE *)lockRect.pBits;
+			for (DWORD dirtyRow = dirtyStart; dirtyRow < row; dirtyRow++) {
+				paletteProc((unsigned int *)pDst, pSrc + (dirtyRow * rowBytes), rowBytes);
+				pDst += lockRect.Pitch;
+			}
+
+			hResult = pBind->pTexObj->UnlockRect(u);
+			if (FAILED(hResult)) {
+				appErrorf(TEXT("Texture unlock failed: %ls"), *ExplainResult(hResult));
+			}
+
+			appMemcpy(pShadowSrc + (dirtyStart * rowBytes), pSrc + (dirtyStart * rowBytes), (row - dirtyStart) * rowBytes);
+			TexDirtyRows += row - dirtyStart;
+		}
+	}
+
+	return true;
+	unguard;
+}
+
+void UD3D9RenderDevice::QueueTexConvertJob(FCachedTexture *pBind, const FTextureInfo &Info, std::vector<FTexConvertJob::level_t> &levels, DWORD srcSize, DWORD dstSize, QWORD diskCacheKey) {
+	guard(UD3D9RenderDevice::QueueTexConvertJob);
+
+	FTexConvertJob *pJob = new FTexConvertJob;
+	pJob->pBind = pBind;
+	pJob->bind = *pBind;
+	pJob->format = Info.Format;
+	pJob->levels.swap(levels);
+	pJob->srcData.resize(srcSize);
+	for (UINT u = 0; u < pJob->levels.size(); u++) {
+		const FTexConvertJob::level_t &level = pJob->levels[u];
+		appMemcpy(&pJob->srcData[level.srcOffset], Info.Mips[pBind->BaseMip + u]->DataPtr, level.srcSize);
+	}
+	if (pBind->texType == TEX_TYPE_HAS_PALETTE) {
+		pJob->palette.assign(Info.Palette, Info.Palette + 256);
+	}
+	pJob->dstData.resize(dstSize);
+	pJob->diskCacheKey = diskCacheKey;
+	pJob->done = false;
+
+	pBind->pConvertJob = pJob;
+	m_texConvertJobs.push_back(pJob);
+
+	//Start the worker on first use
+	if (!m_texConvertThread.joinable()) {
+		m_texConvertExit = false;
+		m_texConvertThread = std::thread(&UD3D9RenderDevice::TexConvertWorkerMain, this);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_texConvertMutex);
+		m_texConvertWorkQueue.push_back(pJob);
+	}
+	m_texConvertWorkCV.notify_one();
+
+	unguard;
+}
+
+void UD3D9RenderDevice::RunTexConvertJob(FTexConvertJob *pJob) {
+	FTexConvertCtx ctx;
+	ctx.stepBits = 0;
+	ctx.pBind = &pJob->bind;
+
+	const FColor *Palette = pJob->palette.empty() ? NULL : &pJob->palette[0];
+
+	for (UINT u = 0; u < pJob->levels.size(); u++) {
+		const FTexConvertJob::level_t &level = pJob->levels[u];
+
+		FMipmapBase Mip(level.UBits, level.VBits);
+		Mip.USize = level.USize;
+		Mip.VSize = level.VSize;
+		Mip.DataPtr = &pJob->srcData[level.srcOffset];
+
+		ctx.texWidthPow2 = level.dstWidth;
+		ctx.texHeightPow2 = level.dstHeight;
+		ctx.lockRect.pBits = &pJob->dstData[level.dstOffset];
+		ctx.lockRect.Pitch = level.dstPitch;
+
+		ConvertTextureMip_NoGuard(ctx, &Mip, Palette, pJob->format, u);
+	}
+}
+
+void UD3D9RenderDevice::TexConvertWorkerMain(void) {
+	std::unique_lock<std::mutex> lock(m_texConvertMutex);
+	for (;;) {
+		m_texConvertWorkCV.wait(lock, [this] { return m_texConvertExit || !m_texConvertWorkQueue.empty(); });
+		if (m_texConvertExit) {
+			break;
+		}
+
+		FTexConvertJob *pJob = m_texConvertWorkQueue.front();
+		m_texConvertWorkQueue.pop_front();
+		m_pTexConvertActiveJob = pJob;
+
+		lock.unlock();
+		RunTexConvertJob(pJob);
+		lock.lock();
+
+		pJob->done = true;
+		m_pTexConvertActiveJob = NULL;
+		m_texConvertDoneCV.notify_all();
+	}
+}
+
+void UD3D9RenderDevice::UploadTexConvertJob(FTexConvertJob *pJob) {
+	guard(UD3D9RenderDevice::UploadTexConvertJob);
+
+	FCachedTexture *pBind = pJob->pBind;
+
+	WriteTexLevels(pBind, pJob->levels, &pJob->dstData[0]);
+
+	if (pJob->diskCacheKey) {
+		m_texDiskCache.write(pJob->diskCacheKey, &pJob->dstData[0], (unsigned int)pJob->dstData.size());
+	}
+
+	pBind->pConvertJob = NULL;
+	pJob->pBind = NULL;
+
+	PublishSharedTexObj(pBind);
+
+	//Replace the placeholder on any texture unit still using this bind
+	for (INT u = 0; u < TMUnits; u++) {
+		if (TexInfo[u].pBind == pBind) {
+			m_d3dDevice->SetTexture(u, pBind->pTexObj);
+		}
+	}
+
+	TexAsyncUploaded++;
+
+	unguard;
+}
+
+void UD3D9RenderDevice::WaitForTexConvertJob(FCachedTexture *pBind) {
+	guard(UD3D9RenderDevice::WaitForTexConvertJob);
+
+	FTexConvertJob *pJob = pBind->pConvertJob;
+
+	{
+		std::unique_lock<std::mutex> lock(m_texConvertMutex);
+		m_texConvertDoneCV.wait(lock, [pJob] { return pJob->done; });
+	}
+	TexStalls++;
+
+	//The job itself is freed by the next UploadConvertedTextures
+	UploadTexConvertJob(pJob);
+
+	unguard;
+}
+
+void UD3D9RenderDevice::UploadConvertedTextures(void) {
+	guard(UD3D9RenderDevice::UploadConvertedTextures);
+
+	if (m_texConvertJobs.empty()) {
+		return;
+	}
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	bool uploadedAny = false;
+
+	//The worker finishes jobs in submission order, so stop at the first one still in progress
+	while (!m_texConvertJobs.empty()) {
+		FTexConvertJob *pJob = m_texConvertJobs.front();
+		{
+			std::lock_guard<std::mutex> lock(m_texConvertMutex);
+			if (!pJob->done) {
+				break;
+			}
+		}
+
+		if (pJob->pBind) {
+			//Always upload at least one texture per frame so the queue keeps draining
+			if (uploadedAny) {
+				std::chrono::duration<DOUBLE, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+				if (elapsed.count() >= TexUploadBudgetMs) {
 					break;
+				}
+			}
+			UploadTexConvertJob(pJob);
+			uploadedAny = true;
+		}
+
+		m_texConvertJobs.pop_front();
+		delete pJob;
+	}
+
+	unguard;
+}
+
+void UD3D9RenderDevice::CancelTexConvertJobs(void) {
+	guard(UD3D9RenderDevice::CancelTexConvertJobs);
+
+	if (m_texConvertJobs.empty()) {
+		return;
+	}
+
+	//Take queued jobs back from the worker and wait for the one it is on
+	{
+		std::unique_lock<std::mutex> lock(m_texConvertMutex);
+		m_texConvertWorkQueue.clear();
+		m_texConvertDoneCV.wait(lock, [this] { return m_pTexConvertActiveJob == NULL; });
+	}
+
+	for (FTexConvertJob *pJob : m_texConvertJobs) {
+		if (pJob->pBind) {
+			pJob->pBind->pConvertJob = NULL;
+		}
+		delete pJob;
+	}
+	m_texConvertJobs.clear();
+
+	unguard;
+}
+
+void UD3D9RenderDevice::StopTexConvertWorker(void) {
+	guard(UD3D9RenderDevice::StopTexConvertWorker);
+
+	CancelTexConvertJobs();
+
+	if (m_texConvertThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_texConvertMutex);
+			m_texConvertExit = true;
+		}
+		m_texConvertWorkCV.notify_one();
+		m_texConvertThread.join();
+	}
+
+	unguard;
+}
 
-				case TEX_TYPE_CACHE_GEN:
-					guard(fillHashTexture);
-					fillHashTexture(m_texConvertCtx, Info);
-					unguard;
-					break;
+void UD3D9RenderDevice::ConvertTextureMip(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Format, INT Level) {
+	guard(UD3D9RenderDevice::ConvertTextureMip);
+	ConvertTextureMip_NoGuard(ctx, Mip, Palette, Format, Level);
+	unguard;
+}
 
-				default:
-#if UNREAL_TOURNAMENT_OLDUNREAL || UNREAL_GOLD_OLDUNREAL
-					switch (Info.Format) {
-					case TEXF_BGRA8:
-						guard(ConvertBGRA8);
-						(this->*pBind->pConvertBGRA8)(Mip, Level);
-						unguard;
-						break;
+//No guards, also used on the texture convert worker where unwinding must not touch the main thread's error history
+void UD3D9RenderDevice::ConvertTextureMip_NoGuard(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Format, INT Level) {
+	const FCachedTexture *pBind = ctx.pBind;
 
-					case TEXF_RGBA8_:
-						guard(ConvertRGBA8);
-						(this->*pBind->pConvertRGBA8)(Mip, Level);
-						unguard;
-						break;
+	//Texture data copy and potential conversion if necessary
+	switch (pBind->texType) {
+	case TEX_TYPE_COMPRESSED_DXT1:
+		ConvertDXT1_DXT1(ctx, Mip, Level);
+		break;
 
-					default:
-						guard(ConvertBGRA7777);
-						(this->*pBind->pConvertBGRA7777)(Mip, Level);
-						unguard;
-					}
-#elif BROTHER_BEAR
-					switch (Info.Format) {
-					case TEXF_RGBA8:
-						guard(ConvertBGRA8); // Seems to be BGR not RGB ??
-						(this->*pBind->pConvertBGRA8)(Mip, Level);
-						unguard;
-						break;
+	case TEX_TYPE_COMPRESSED_DXT1_TO_DXT3:
+		ConvertDXT1_DXT3(ctx, Mip, Level);
+		break;
 
-					default:
-						guard(ConvertBGRA7777);
-						(this->*pBind->pConvertBGRA7777)(Mip, Level);
-						unguard;
-					}
-#else
-					guard(ConvertBGRA7777);
-					(this->*pBind->pConvertBGRA7777)(Mip, Level);
-					unguard;
-#endif
-				}
+	case TEX_TYPE_COMPRESSED_DXT3:
+		ConvertDXT35_DXT35(ctx, Mip, Level);
+		break;
+
+	case TEX_TYPE_COMPRESSED_DXT5:
+		ConvertDXT35_DXT35(ctx, Mip, Level);
+		break;
 
-				DWORD texWidth, texHeight;
+	case TEX_TYPE_PALETTED:
+		//Not supported
+		break;
 
-				//Get current texture width and height
-				texWidth = m_texConvertCtx.texWidthPow2;
-				texHeight = m_texConvertCtx.texHeightPow2;
+	case TEX_TYPE_HAS_PALETTE:
+		switch (pBind->texFormat) {
+		case D3DFMT_R5G6B5:
+			if (ctx.stepBits == 0) {
+				ConvertP8_RGB565_NoStep(ctx, Mip, Palette, Level);
+			}
+			else {
+				ConvertP8_RGB565(ctx, Mip, Palette, Level);
+			}
+			break;
 
-				//Calculate and save next texture width and height
-				//Both are divided by two down to a floor of 1
-				//Texture width and height must be even powers of 2 for the following code to work
-				m_texConvertCtx.texWidthPow2 = (texWidth & 0x1) | (texWidth >> 1);
-				m_texConvertCtx.texHeightPow2 = (texHeight & 0x1) | (texHeight >> 1);
+		case D3DFMT_X1R5G5B5:
+		case D3DFMT_A1R5G5B5:
+			if (ctx.stepBits == 0) {
+				ConvertP8_RGBA5551_NoStep(ctx, Mip, Palette, Level);
+			}
+			else {
+				ConvertP8_RGBA5551(ctx, Mip, Palette, Level);
+			}
+			break;
 
-				//Unlock texture level
-				hResult = pBind->pTexObj->UnlockRect(Level);
-				if (FAILED(hResult)) {
-					appErrorf(TEXT("Texture unlock failed: %ls"), *ExplainResult(hResult));
-				}
+		default:
+			if (ctx.stepBits == 0) {
+				ConvertP8_RGBA8888_NoStep(ctx, Mip, Palette, Level);
+			}
+			else {
+				ConvertP8_RGBA8888(ctx, Mip, Palette, Level);
 			}
 		}
-		unguard;
+		break;
 
-		unclockFast(ImageCycles);
+	default:
+#if UNREAL_TOURNAMENT_OLDUNREAL || UNREAL_GOLD_OLDUNREAL
+		switch (Format) {
+		case TEXF_BGRA8:
+			(this->*pBind->pConvertBGRA8)(ctx, Mip, Level);
+			break;
 
-		//Restore palette index 0 for masked paletted textures
-		if (Info.Palette && (PolyFlags & PF_Masked)) {
-			Info.Palette[0] = paletteIndex0;
+		case TEXF_RGBA8_:
+			(this->*pBind->pConvertRGBA8)(ctx, Mip, Level);
+			break;
+
+		default:
+			(this->*pBind->pConvertBGRA7777)(ctx, Mip, Level);
 		}
+#elif BROTHER_BEAR
+		switch (Format) {
+		case TEXF_RGBA8: // Seems to be BGR not RGB ??
+			(this->*pBind->pConvertBGRA8)(ctx, Mip, Level);
+			break;
 
-		// Cleanup.
-#if !KLINGON_HONOR_GUARD
-		if (SupportsLazyTextures) {
-			Info.Unload();
+		default:
+			(this->*pBind->pConvertBGRA7777)(ctx, Mip, Level);
 		}
+#else
+		(this->*pBind->pConvertBGRA7777)(ctx, Mip, Level);
 #endif
 	}
-
-	//Set texture filter parameters
-	SetTexFilter(texNum, pBind->texParams.filter);
-
-	unguard;
 }
 
 void UD3D9RenderDevice::CacheTextureInfo(FCachedTexture *pBind, const FTextureInfo &Info, DWORD PolyFlags) {
@@ -4872,21 +6452,8 @@ void UD3D9RenderDevice::CacheTextureInfo(FCachedTexture *pBind, const FTextureIn
 	dout << L"utd3d9r: NumMips = " << Info.NumMips << std::endl;
 }
 {
-	unsigned int u;
-
-	dout << L"utd3d9r: ZPBindTree Size = ";
-	for (u = 0; u < NUM_CTTree_TREES; u++) {
-		dout << m_zeroPrefixBindTrees[u].calc_size();
-		if (u != (NUM_CTTree_TREES - 1)) dout << L", ";
-	}
-	dout << std::endl;
-
-	dout << L"utd3d9r: NZPBindTree Size = ";
-	for (u = 0; u < NUM_CTTree_TREES; u++) {
-		dout << m_nonZeroPrefixBindTrees[u].calc_size();
-		if (u != (NUM_CTTree_TREES - 1)) dout << L", ";
-	}
-	dout << std::endl;
+	dout << L"utd3d9r: ZPBindMap Size = " << m_zeroPrefixBindMap->size() << L" / " << m_zeroPrefixBindMap->capacity() << std::endl;
+	dout << L"utd3d9r: NZPBindMap Size = " << m_nonZeroPrefixBindMap->size() << L" / " << m_nonZeroPrefixBindMap->capacity() << std::endl;
 }
 #endif
 
@@ -5046,11 +6613,11 @@ void UD3D9RenderDevice::CacheTextureInfo(FCachedTexture *pBind, const FTextureIn
 }
 
 
-void UD3D9RenderDevice::ConvertDXT1_DXT1(const FMipmapBase *Mip, INT Level) {
+void UD3D9RenderDevice::ConvertDXT1_DXT1(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
 	const DWORD *pSrc = (DWORD *)Mip->DataPtr;
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	DWORD UBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level - 2);
-	DWORD VBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level - 2);
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	DWORD UBlocks = 1U << Max(0, (INT)ctx.pBind->UBits - Level - 2);
+	DWORD VBlocks = 1U << Max(0, (INT)ctx.pBind->VBits - Level - 2);
 
 	DWORD USet = Min((INT)UBlocks*4, (Mip->USize + 3) >> 2 << 2) >> 1;
 	DWORD UZero = UBlocks*2 - USet;
@@ -5065,7 +6632,7 @@ void UD3D9RenderDevice::ConvertDXT1_DXT1(const FMipmapBase *Mip, INT Level) {
 		}
 		if (UZero)
 			appMemzero(pDest, sizeof(DWORD)*UZero);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5076,11 +6643,11 @@ void UD3D9RenderDevice::ConvertDXT1_DXT1(const FMipmapBase *Mip, INT Level) {
 #endif
 }
 
-void UD3D9RenderDevice::ConvertDXT1_DXT3(const FMipmapBase *Mip, INT Level) {
+void UD3D9RenderDevice::ConvertDXT1_DXT3(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
 	const DWORD *pSrc = (DWORD *)Mip->DataPtr;
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	DWORD UBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level - 2);
-	DWORD VBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level - 2);
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	DWORD UBlocks = 1U << Max(0, (INT)ctx.pBind->UBits - Level - 2);
+	DWORD VBlocks = 1U << Max(0, (INT)ctx.pBind->VBits - Level - 2);
 
 	for (DWORD v = 0; v < VBlocks; v++) {
 		DWORD *pDest = pTex;
@@ -5097,7 +6664,7 @@ void UD3D9RenderDevice::ConvertDXT1_DXT3(const FMipmapBase *Mip, INT Level) {
 			}
 			pDest += 4;
 		}
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5108,11 +6675,11 @@ void UD3D9RenderDevice::ConvertDXT1_DXT3(const FMipmapBase *Mip, INT Level) {
 #endif
 }
 
-void UD3D9RenderDevice::ConvertDXT35_DXT35(const FMipmapBase *Mip, INT Level) {
+void UD3D9RenderDevice::ConvertDXT35_DXT35(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
 	const DWORD *pSrc = (DWORD *)Mip->DataPtr;
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	DWORD UBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level - 2);
-	DWORD VBlocks = 1U << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level - 2);
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	DWORD UBlocks = 1U << Max(0, (INT)ctx.pBind->UBits - Level - 2);
+	DWORD VBlocks = 1U << Max(0, (INT)ctx.pBind->VBits - Level - 2);
 
 	DWORD USet = Min((INT)UBlocks*4, (Mip->USize + 3) >> 2 << 2);
 	DWORD UZero = UBlocks*4 - USet;
@@ -5127,7 +6694,7 @@ void UD3D9RenderDevice::ConvertDXT35_DXT35(const FMipmapBase *Mip, INT Level) {
 		}
 		if (UZero)
 			appMemzero(pDest, sizeof(DWORD)*UZero);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5138,35 +6705,82 @@ void UD3D9RenderDevice::ConvertDXT35_DXT35(const FMipmapBase *Mip, INT Level) {
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGBA8888(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
-	DWORD UMask = (1U << Mip->UBits) - 1;
+//Converts the rows of an unstepped mip with a 32-bit row proc
+//Matches the per texel loops: U and V wrap on the mip mask, texels past USize or VSize are zero,
+//and texels past the clamp values repeat the last one inside them
+template <class SrcT, class RowProcT>
+static void ConvertRowsNoStep(const FMipmapBase *Mip, const D3DLOCKED_RECT &lockRect, INT i_stop, INT j_stop, DWORD VClampVal, DWORD UClampVal, RowProcT rowProc) {
+	unsigned int *pTex = (unsigned int *)lockRect.pBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
+	DWORD UPeriod = 1U << Mip->UBits;
+	DWORD USize = Mip->USize;
 	INT i = 0;
 	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		BYTE* Base = (BYTE*)Mip->DataPtr + VOff * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				BYTE& pIndex = Base[UOff];
-				DWORD dwColor = GET_COLOR_DWORD(Palette[pIndex]);
+		DWORD VOff = i & VMask;
+		if (VOff >= (DWORD)Mip->VSize) {
+			appMemzero(pTex, j_stop * sizeof(DWORD));
+		}
+		else {
+			const SrcT *Base = (const SrcT *)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * USize;
+			for (DWORD j = 0; j < (DWORD)j_stop; j += UPeriod) {
+				DWORD len = Min<DWORD>(UPeriod, j_stop - j);
+				DWORD numSet = Min<DWORD>(len, USize);
+				DWORD numCopy = (UClampVal < numSet) ? (UClampVal + 1) : numSet;
+				rowProc(pTex + j, Base, numCopy);
+				if (numCopy < numSet) {
+					unsigned int clampColor;
+					rowProc(&clampColor, Base + UClampVal, 1);
+					for (DWORD u = numCopy; u < numSet; u++) {
+						pTex[j + u] = clampColor;
+					}
+				}
+				if (numSet < len) {
+					appMemzero(pTex + j + numSet, (len - numSet) * sizeof(DWORD));
+				}
+			}
+		}
+		pTex = (unsigned int *)((BYTE *)pTex + lockRect.Pitch);
+	} while (++i < i_stop);
+}
+
+void UD3D9RenderDevice::ConvertP8_RGBA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
+	DWORD UMask = (1U << Mip->UBits) - 1;
+	DWORD VMask = (1U << Mip->VBits) - 1;
+	INT ij_inc = 1 << StepBits;
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		unsigned int palette[256];
+		BuildP8_RGBA8888Palette(Palette, palette);
+		CTexConv::palette_proc_t paletteProc = m_texConv.pPalette;
+		ConvertRowsNoStep<BYTE>(Mip, ctx.lockRect, i_stop, j_stop, MAXDWORD, MAXDWORD,
+			[&](unsigned int *pDst, const BYTE *pSrc, unsigned int count) { paletteProc(pDst, pSrc, palette, count); });
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			BYTE* Base = (BYTE*)Mip->DataPtr + VOff * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					BYTE& pIndex = Base[UOff];
+					DWORD dwColor = GET_COLOR_DWORD(Palette[pIndex]);
 #if !UTGLR_NO_PALETTE_ALPHA_FIX
-				if (pIndex != 0) dwColor |= 0xFF000000; // Set alpha to 1
+					if (pIndex != 0) dwColor |= 0xFF000000; // Set alpha to 1
 #endif
-				pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+					pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5176,33 +6790,14 @@ void UD3D9RenderDevice::ConvertP8_RGBA8888(const FMipmapBase *Mip, const FColor
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGBA8888_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	DWORD UMask = (1U << Mip->UBits) - 1;
-	DWORD VMask = (1U << Mip->VBits) - 1;
-	INT i_stop = m_texConvertCtx.texHeightPow2;
-	INT j_stop = m_texConvertCtx.texWidthPow2;
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		BYTE* Base = (BYTE*)Mip->DataPtr + VOff * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				BYTE& pIndex = Base[UOff];
-				DWORD dwColor = GET_COLOR_DWORD(Palette[pIndex]);
-#if !UTGLR_NO_PALETTE_ALPHA_FIX
-				if (pIndex != 0) dwColor |= 0xFF000000; // Set alpha to 1
-#endif
-				pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
-			}	
-		} while ((j += 1) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += 1) < i_stop);
+void UD3D9RenderDevice::ConvertP8_RGBA8888_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	INT i_stop = ctx.texHeightPow2;
+	INT j_stop = ctx.texWidthPow2;
+	unsigned int palette[256];
+	BuildP8_RGBA8888Palette(Palette, palette);
+	CTexConv::palette_proc_t paletteProc = m_texConv.pPalette;
+	ConvertRowsNoStep<BYTE>(Mip, ctx.lockRect, i_stop, j_stop, MAXDWORD, MAXDWORD,
+		[&](unsigned int *pDst, const BYTE *pSrc, unsigned int count) { paletteProc(pDst, pSrc, palette, count); });
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5212,14 +6807,14 @@ void UD3D9RenderDevice::ConvertP8_RGBA8888_NoStep(const FMipmapBase *Mip, const
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGB565(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	_WORD *pTex = (_WORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertP8_RGB565(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	_WORD *pTex = (_WORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	DWORD VMask = (1U << Mip->VBits) - 1;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
 	INT i = 0;
 	do { //i_stop always >= 1
 		INT VOff = i & VMask;
@@ -5235,7 +6830,7 @@ void UD3D9RenderDevice::ConvertP8_RGB565(const FMipmapBase *Mip, const FColor *P
 				pTex[j] = ((dwColor >> 19) & 0x001F) | ((dwColor >> 5) & 0x07E0) | ((dwColor << 8) & 0xF800);
 			}
 		} while ((j += ij_inc) < j_stop);
-		pTex = (WORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (WORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	} while ((i += ij_inc) < i_stop);
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5246,12 +6841,12 @@ void UD3D9RenderDevice::ConvertP8_RGB565(const FMipmapBase *Mip, const FColor *P
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGB565_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	_WORD *pTex = (_WORD *)m_texConvertCtx.lockRect.pBits;
+void UD3D9RenderDevice::ConvertP8_RGB565_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	_WORD *pTex = (_WORD *)ctx.lockRect.pBits;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	INT i_stop = m_texConvertCtx.texHeightPow2;
-	INT j_stop = m_texConvertCtx.texWidthPow2;
+	INT i_stop = ctx.texHeightPow2;
+	INT j_stop = ctx.texWidthPow2;
 	INT i = 0;
 	do { //i_stop always >= 1
 		INT VOff = i & VMask;
@@ -5267,7 +6862,7 @@ void UD3D9RenderDevice::ConvertP8_RGB565_NoStep(const FMipmapBase *Mip, const FC
 				pTex[j] = ((dwColor >> 19) & 0x001F) | ((dwColor >> 5) & 0x07E0) | ((dwColor << 8) & 0xF800);
 			}
 		} while ((j += 1) < j_stop);
-		pTex = (_WORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (_WORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	} while ((i += 1) < i_stop);
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5278,14 +6873,14 @@ void UD3D9RenderDevice::ConvertP8_RGB565_NoStep(const FMipmapBase *Mip, const FC
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGBA5551(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	_WORD *pTex = (_WORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertP8_RGBA5551(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	_WORD *pTex = (_WORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	DWORD VMask = (1U << Mip->VBits) - 1;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
 	INT i = 0;
 	do { //i_stop always >= 1
 		INT VOff = i & VMask;
@@ -5301,7 +6896,7 @@ void UD3D9RenderDevice::ConvertP8_RGBA5551(const FMipmapBase *Mip, const FColor
 				pTex[j] = ((dwColor >> 19) & 0x001F) | ((dwColor >> 6) & 0x03E0) | ((dwColor << 7) & 0x7C00) | ((dwColor >> 16) & 0x8000);
 			}
 		} while ((j += ij_inc) < j_stop);
-		pTex = (WORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (WORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	} while ((i += ij_inc) < i_stop);
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5312,12 +6907,12 @@ void UD3D9RenderDevice::ConvertP8_RGBA5551(const FMipmapBase *Mip, const FColor
 #endif
 }
 
-void UD3D9RenderDevice::ConvertP8_RGBA5551_NoStep(const FMipmapBase *Mip, const FColor *Palette, INT Level) {
-	_WORD *pTex = (_WORD *)m_texConvertCtx.lockRect.pBits;
+void UD3D9RenderDevice::ConvertP8_RGBA5551_NoStep(const FTexConvertCtx &ctx, const FMipmapBase *Mip, const FColor *Palette, INT Level) {
+	_WORD *pTex = (_WORD *)ctx.lockRect.pBits;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	INT i_stop = m_texConvertCtx.texHeightPow2;
-	INT j_stop = m_texConvertCtx.texWidthPow2;
+	INT i_stop = ctx.texHeightPow2;
+	INT j_stop = ctx.texWidthPow2;
 	INT i = 0;
 	do { //i_stop always >= 1
 		INT VOff = i & VMask;
@@ -5333,7 +6928,7 @@ void UD3D9RenderDevice::ConvertP8_RGBA5551_NoStep(const FMipmapBase *Mip, const
 				pTex[j] = ((dwColor >> 19) & 0x001F) | ((dwColor >> 6) & 0x03E0) | ((dwColor << 7) & 0x7C00) | ((dwColor >> 16) & 0x8000);
 			}
 		} while ((j += 1) < j_stop);
-		pTex = (_WORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
+		pTex = (_WORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
 	} while ((i += 1) < i_stop);
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
@@ -5344,33 +6939,38 @@ void UD3D9RenderDevice::ConvertP8_RGBA5551_NoStep(const FMipmapBase *Mip, const
 #endif
 }
 
-void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	DWORD VClampVal = m_texConvertCtx.pBind->VClampVal;
+	DWORD VClampVal = ctx.pBind->VClampVal;
 	DWORD UMask = (1U << Mip->UBits) - 1;
-	DWORD UClampVal = m_texConvertCtx.pBind->UClampVal;
+	DWORD UClampVal = ctx.pBind->UClampVal;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
-				pTex[j] = dwColor * 2; // because of 7777
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, VClampVal, UClampVal, m_texConv.pShl1);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
+					pTex[j] = dwColor * 2; // because of 7777
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5380,31 +6980,36 @@ void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888(const FMipmapBase *Mip, INT Lev
 #endif
 }
 
-void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
-				pTex[j] = dwColor * 2; // because of 7777
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, MAXDWORD, MAXDWORD, m_texConv.pShl1);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
+					pTex[j] = dwColor * 2; // because of 7777
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5414,33 +7019,38 @@ void UD3D9RenderDevice::ConvertBGRA7777_BGRA8888_NoClamp(const FMipmapBase *Mip,
 #endif
 }
 
-void UD3D9RenderDevice::ConvertBGRA8_BGRA8888(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertBGRA8_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	DWORD VClampVal = m_texConvertCtx.pBind->VClampVal;
+	DWORD VClampVal = ctx.pBind->VClampVal;
 	DWORD UMask = (1U << Mip->UBits) - 1;
-	DWORD UClampVal = m_texConvertCtx.pBind->UClampVal;
+	DWORD UClampVal = ctx.pBind->UClampVal;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
-				pTex[j] = dwColor;
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, VClampVal, UClampVal, m_texConv.pCopy);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
+					pTex[j] = dwColor;
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5450,31 +7060,36 @@ void UD3D9RenderDevice::ConvertBGRA8_BGRA8888(const FMipmapBase *Mip, INT Level)
 #endif
 }
 
-void UD3D9RenderDevice::ConvertBGRA8_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertBGRA8_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
-				pTex[j] = dwColor;
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, MAXDWORD, MAXDWORD, m_texConv.pCopy);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
+					pTex[j] = dwColor;
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5484,33 +7099,38 @@ void UD3D9RenderDevice::ConvertBGRA8_BGRA8888_NoClamp(const FMipmapBase *Mip, IN
 #endif
 }
 
-void UD3D9RenderDevice::ConvertRGBA8_BGRA8888(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertRGBA8_BGRA8888(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
-	DWORD VClampVal = m_texConvertCtx.pBind->VClampVal;
+	DWORD VClampVal = ctx.pBind->VClampVal;
 	DWORD UMask = (1U << Mip->UBits) - 1;
-	DWORD UClampVal = m_texConvertCtx.pBind->UClampVal;
+	DWORD UClampVal = ctx.pBind->UClampVal;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
-				pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, VClampVal, UClampVal, m_texConv.pSwapRB);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + Min<DWORD>(VOff, VClampVal) * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[Min<DWORD>(UOff, UClampVal)]);
+					pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5520,31 +7140,36 @@ void UD3D9RenderDevice::ConvertRGBA8_BGRA8888(const FMipmapBase *Mip, INT Level)
 #endif
 }
 
-void UD3D9RenderDevice::ConvertRGBA8_BGRA8888_NoClamp(const FMipmapBase *Mip, INT Level) {
-	DWORD *pTex = (DWORD *)m_texConvertCtx.lockRect.pBits;
-	INT StepBits = m_texConvertCtx.stepBits;
+void UD3D9RenderDevice::ConvertRGBA8_BGRA8888_NoClamp(const FTexConvertCtx &ctx, const FMipmapBase *Mip, INT Level) {
+	DWORD *pTex = (DWORD *)ctx.lockRect.pBits;
+	INT StepBits = ctx.stepBits;
 	DWORD VMask = (1U << Mip->VBits) - 1;
 	DWORD UMask = (1U << Mip->UBits) - 1;
 	INT ij_inc = 1 << StepBits;
-	INT i_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->VBits - Level + StepBits);
-	INT j_stop = 1 << Max(0, (INT)m_texConvertCtx.pBind->UBits - Level + StepBits);
-	INT i = 0;
-	do { //i_stop always >= 1
-		INT VOff = i & VMask;
-		FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
-		BOOL bZero = VOff >= Mip->VSize;
-		INT j = 0;
-		do { //j_stop always >= 1;
-			INT UOff = j & UMask;
-			if (bZero || UOff >= Mip->USize)
-				pTex[j] = 0;
-			else {
-				DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
-				pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
-			}
-		} while ((j += ij_inc) < j_stop);
-		pTex = (DWORD *)((BYTE *)pTex + m_texConvertCtx.lockRect.Pitch);
-	} while ((i += ij_inc) < i_stop);
+	INT i_stop = 1 << Max(0, (INT)ctx.pBind->VBits - Level + StepBits);
+	INT j_stop = 1 << Max(0, (INT)ctx.pBind->UBits - Level + StepBits);
+	if (StepBits == 0) {
+		ConvertRowsNoStep<unsigned int>(Mip, ctx.lockRect, i_stop, j_stop, MAXDWORD, MAXDWORD, m_texConv.pSwapRB);
+	}
+	else {
+		INT i = 0;
+		do { //i_stop always >= 1
+			INT VOff = i & VMask;
+			FColor* Base = (FColor*)Mip->DataPtr + VOff * Mip->USize;
+			BOOL bZero = VOff >= Mip->VSize;
+			INT j = 0;
+			do { //j_stop always >= 1;
+				INT UOff = j & UMask;
+				if (bZero || UOff >= Mip->USize)
+					pTex[j] = 0;
+				else {
+					DWORD dwColor = GET_COLOR_DWORD(Base[UOff]);
+					pTex[j] = (dwColor & 0xFF00FF00) | ((dwColor >> 16) & 0xFF) | ((dwColor << 16) & 0xFF0000);
+				}
+			} while ((j += ij_inc) < j_stop);
+			pTex = (DWORD *)((BYTE *)pTex + ctx.lockRect.Pitch);
+		} while ((i += ij_inc) < i_stop);
+	}
 
 #ifdef UTGLR_DEBUG_SHOW_TEX_CONVERT_COUNTS
 	{
@@ -5996,12 +7621,12 @@ void UD3D9RenderDevice::EndBufferingNoCheck(void) {
 		EndTileBufferingNoCheck();
 		break;
 
-	case BV_TYPE_LINES:
-		EndLineBufferingNoCheck();
+	case BV_TYPE_LINES_POINTS:
+		EndLinePointBufferingNoCheck();
 		break;
 
-	case BV_TYPE_POINTS:
-		EndPointBufferingNoCheck();
+	case BV_TYPE_INDEXED_TRIS:
+		EndIndexedTriBufferingNoCheck();
 		break;
 
 	default:
@@ -6009,6 +7634,7 @@ void UD3D9RenderDevice::EndBufferingNoCheck(void) {
 	}
 
 	m_bufferedVerts = 0;
+	m_bufferedIndices = 0;
 
 	return;
 }
@@ -6051,36 +7677,92 @@ void UD3D9RenderDevice::EndTileBufferingNoCheck(void) {
 
 	//Draw the quads (stored as triangles)
 	m_d3dDevice->DrawPrimitive(D3DPT_TRIANGLELIST, getVertBufferPos(m_bufferedVerts), m_bufferedVerts / 3);
+	TileBatches++;
 
 	unclockFast(TileCycles);
 }
 
-void UD3D9RenderDevice::EndLineBufferingNoCheck(void) {
-	//AA state set when start buffering
-	//Projection state set when start buffering
-	//Stream state set when start buffering
-	//Default texture state set when start buffering
+void UD3D9RenderDevice::EndLinePointBufferingNoCheck(void) {
+	//Lines and points all share the same state so it is only set when they are drawn
+	//Lines and points do not use PolyFlags2
+	const DWORD PolyFlags = PF_Highlighted | PF_Occlude;
 
-	//Unlock vertexColor and texCoord0 buffers
-	UnlockVertexColorBuffer();
-	UnlockTexCoordBuffer(0);
+	SetDefaultStreamState();
+	SetDefaultTextureState();
+
+	//Update current poly flags
+	m_curPolyFlags = PolyFlags;
+
+	//Set blending and no texture for lines and points
+	SetBlend(PolyFlags);
+	SetNoTexture(0);
 
-	//Draw the lines
-	m_d3dDevice->DrawPrimitive(D3DPT_LINELIST, getVertBufferPos(m_bufferedVerts), m_bufferedVerts / 2);
+	//Draw the runs of lines and points (stored as triangles) in the order they came in
+	const FGLVertexColor* verts = m_bufferedLinePointVerts.data();
+	for (const LinePointRun& run : m_bufferedLinePointRuns) {
+		DrawBufferedLinePointVerts(run.primType, verts, run.numVerts, (run.primType == D3DPT_LINELIST) ? 2 : 3);
+		verts += run.numVerts;
+	}
+	m_bufferedLinePointVerts.clear();
+	m_bufferedLinePointRuns.clear();
+}
+
+void FASTCALL UD3D9RenderDevice::DrawBufferedLinePointVerts(D3DPRIMITIVETYPE primType, const FGLVertexColor* verts, UINT totalVerts, UINT vertsPerPrim) {
+	//Keep each draw a whole number of lines and point triangles
+	const UINT maxVerts = ((VERTEX_BUFFER_SIZE - 1) / 6) * 6;
+
+	UINT vertPos = 0;
+	while (vertPos < totalVerts) {
+		UINT numVerts = Min(totalVerts - vertPos, maxVerts);
+
+		//Check if vertex buffer flush is required
+		if ((m_curVertexBufferPos + numVerts) >= VERTEX_BUFFER_SIZE) {
+			FlushVertexBuffers();
+		}
+
+		//Lock vertexColor and texCoord0 buffers
+		LockVertexColorBuffer(numVerts);
+		LockTexCoordBuffer(0, numVerts);
+
+		appMemcpy(m_pVertexColorArray, &verts[vertPos], numVerts * sizeof(FGLVertexColor));
+		//No texture is bound, the tex coords are unused
+		appMemzero(m_pTexCoordArray[0], numVerts * sizeof(FGLTexCoord));
+
+		//Unlock vertexColor and texCoord0 buffers
+		UnlockVertexColorBuffer();
+		UnlockTexCoordBuffer(0);
+
+		m_d3dDevice->DrawPrimitive(primType, getVertBufferPos(numVerts), numVerts / vertsPerPrim);
+
+		vertPos += numVerts;
+	}
 }
 
-void UD3D9RenderDevice::EndPointBufferingNoCheck(void) {
-	//AA state set when start buffering
-	//Projection state set when start buffering
+void UD3D9RenderDevice::EndIndexedTriBufferingNoCheck(void) {
 	//Stream state set when start buffering
 	//Default texture state set when start buffering
 
-	//Unlock vertexColor and texCoord0 buffers
+	clockFast(GouraudCycles);
+
+	//Unlock vertexColor, texCoord0 and index buffers
 	UnlockVertexColorBuffer();
 	UnlockTexCoordBuffer(0);
+	UnlockIndexBuffer();
 
-	//Draw the points (stored as triangles)
-	m_d3dDevice->DrawPrimitive(D3DPT_TRIANGLELIST, getVertBufferPos(m_bufferedVerts), m_bufferedVerts / 3);
+#ifdef UTGLR_DEBUG_ACTOR_WIREFRAME
+	m_d3dDevice->SetRenderState(D3DRS_FILLMODE, D3DFILL_WIREFRAME);
+#endif
+
+	//Draw the triangles, indices are relative to the first buffered vertex
+	UINT baseVertex = getVertBufferPos(m_bufferedVerts);
+	UINT startIndex = getIndexBufferPos(m_bufferedIndices);
+	m_d3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, baseVertex, 0, m_bufferedVerts, startIndex, m_bufferedIndices / 3);
+
+#ifdef UTGLR_DEBUG_ACTOR_WIREFRAME
+	m_d3dDevice->SetRenderState(D3DRS_FILLMODE, D3DFILL_SOLID);
+#endif
+
+	unclockFast(GouraudCycles);
 }
 
 void UD3D9RenderDevice::setProjection(float aspect, float fovAngle) {
@@ -0,0 +1,132 @@
+#include "RTXAnchors.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include <cmath>
+#include <limits>
+
+double floored_mod(double a, double b) {
+	return a - b * std::floor(a / b);
+}
+
+static inline void pushVector(std::vector<float>& arr, const FVector& vec) {
+	arr.push_back(vec.X);
+	arr.push_back(vec.Y);
+	arr.push_back(vec.Z);
+}
+
+size_t RTXAnchors::add(
+	const std::string& name,
+	const FVector& location,
+	const FVector& startRot,
+	const FVector& scale,
+	const FVector& rotationRate,
+	bool pausable
+) {
+	hashes.push_back(XXH32(name.c_str(), name.size(), 0));
+	pushVector(locations, location);
+	pushVector(rotations, startRot);
+	pushVector(scales, scale);
+	pushVector(angularVelocities, rotationRate);
+	this->pausable.push_back(pausable);
+	return hashes.size() - 1;
+}
+
+void RTXAnchors::addStatic(
+	const std::string& name,
+	const FVector& location,
+	const FVector& startRot,
+	const FVector& scale,
+	const FVector& rotationRate,
+	bool pausable
+) {
+	add(name, location, startRot, scale, rotationRate, pausable);
+}
+
+void RTXAnchors::addPath(
+	const std::string& name,
+	const FVector& startLoc,
+	const FVector& startRot,
+	const FVector& scale,
+	const FVector& rotationRate,
+	bool pausable,
+	const FVector& endLoc,
+	float speed,
+	bool pingPong
+) {
+	pathAnchors.push_back(add(name, startLoc, startRot, scale, rotationRate, pausable));
+	FVector pathDirection = endLoc - startLoc;
+	float pathLength = pathDirection.Size();
+	pathDirection.Normalize();
+	pushVector(pathStarts, startLoc);
+	pushVector(pathDirections, pathDirection);
+	pathLengths.push_back(pingPong ? pathLength * 2 : pathLength);
+	pathTurnPoints.push_back(pingPong ? pathLength : std::numeric_limits<float>::infinity());
+	pathSpeeds.push_back(speed);
+	pathLocations.push_back(0.0f);
+}
+
+void RTXAnchors::tick(float deltaTime, bool paused) {
+	const size_t numAnchors = hashes.size();
+
+	float* rot = rotations.data();
+	const float* rate = angularVelocities.data();
+	if (!paused) {
+		for (size_t i = 0; i < numAnchors * 3; i++) {
+			rot[i] += rate[i] * deltaTime;
+		}
+	}
+	else {
+		for (size_t i = 0; i < numAnchors; i++) {
+			if (pausable[i]) {
+				continue;
+			}
+			rot[i * 3] += rate[i * 3] * deltaTime;
+			rot[i * 3 + 1] += rate[i * 3 + 1] * deltaTime;
+			rot[i * 3 + 2] += rate[i * 3 + 2] * deltaTime;
+		}
+	}
+	for (size_t i = 0; i < numAnchors * 3; i++) {
+		if (rot[i] > 360.0f || rot[i] < 0.0f) {
+			rot[i] = floored_mod(rot[i], 360.0);
+		}
+	}
+
+	const size_t numPaths = pathAnchors.size();
+	float* loc = locations.data();
+	const float* start = pathStarts.data();
+	const float* dir = pathDirections.data();
+	for (size_t i = 0; i < numPaths; i++) {
+		const size_t anchor = pathAnchors[i];
+		if (paused && pausable[anchor]) {
+			continue;
+		}
+		float& pathLocation = pathLocations[i];
+		pathLocation += pathSpeeds[i] * deltaTime;
+		if (pathLocation > pathLengths[i] || pathLocation < 0) {
+			pathLocation = floored_mod(pathLocation, pathLengths[i]);
+		}
+		// Past the turn point it's on the way back
+		const float distance = pathLocation < pathTurnPoints[i] ? pathLocation : pathLengths[i] - pathLocation;
+		loc[anchor * 3] = start[i * 3] + dir[i * 3] * distance;
+		loc[anchor * 3 + 1] = start[i * 3 + 1] + dir[i * 3 + 1] * distance;
+		loc[anchor * 3 + 2] = start[i * 3 + 2] + dir[i * 3 + 2] * distance;
+	}
+}
+
+void RTXAnchors::clear() {
+	hashes.clear();
+	locations.clear();
+	rotations.clear();
+	scales.clear();
+	angularVelocities.clear();
+	pausable.clear();
+	pathAnchors.clear();
+	pathStarts.clear();
+	pathDirections.clear();
+	pathLengths.clear();
+	pathTurnPoints.clear();
+	pathSpeeds.clear();
+	pathLocations.clear();
+}
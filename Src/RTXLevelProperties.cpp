@@ -5,62 +5,11 @@
 #include "D3D9DebugUtils.h"
 #include "nlohmann/json.hpp"
 
-#define XXH_INLINE_ALL
-#include "xxhash.h"
-
 #include <cmath>
 #include <fstream>
 
 using json = nlohmann::json;
 
-double floored_mod(double a, double b) {
-	return a - b * std::floor(a / b);
-}
-
-RTXAnchor::RTXAnchor(
-	std::string name,
-	FVector location,
-	FVector startRot,
-	FVector scale,
-	FVector rotationRate,
-	bool pausable
-) : name(name),
-	location(location),
-	rotation(startRot),
-	scale(scale),
-	angularVelocity(rotationRate),
-	pausable(pausable)
-{
-	hash = XXH32(name.c_str(), name.size(), 0);
-}
-
-void RTXAnchor::Tick(float deltaTime) {
-	rotation += angularVelocity * deltaTime;
-	if (rotation.X > 360.0f || rotation.X < 0.0f) {
-		rotation.X = floored_mod(rotation.X, 360.0);
-	}
-	if (rotation.Y > 360.0f || rotation.Y < 0.0f) {
-		rotation.Y = floored_mod(rotation.Y, 360.0);
-	}
-	if (rotation.Z > 360.0f || rotation.Z < 0.0f) {
-		rotation.Z = floored_mod(rotation.Z, 360.0);
-	}
-}
-
-void RTXAnchorLinear::Tick(float deltaTime) {
-	RTXAnchor::Tick(deltaTime);
-	pathLocation += speed * deltaTime;
-	if (pathLocation > pathLength || pathLocation < 0) {
-		pathLocation = floored_mod(pathLocation, pathLength);
-	}
-	location = pathStart + pathDirection * pathLocation;
-}
-
-void RTXAnchorPingPong::Tick(float deltaTime) {
-	RTXAnchorLinear::Tick(deltaTime);
-	location = pathStart + pathDirection * (pathLocation < pathLengthReal ? pathLocation : pathLength - pathLocation);
-}
-
 std::wstring s2ws(const std::string& str) {
 	if (str.empty()) {
 		return L"";
@@ -175,7 +124,44 @@ std::string normalize_level_name(const std::string& input) {
 	return toLower(result);
 }
 
-void loadAnchorsArray(json& anchorsArr, const std::string& levelName, RTXAnchors& anchors) {
+// An anchor as read from the config, added to the level's RTXAnchors on load
+struct RTXAnchorDesc {
+	std::string name;
+	FVector startLoc;
+	FVector startRot;
+	FVector scale;
+	FVector rotationRate;
+	bool pausable;
+	bool isPath;
+	bool pingPong;
+	FVector endLoc;
+	float speed;
+};
+
+struct RTXLevelDesc {
+	// False if the level's properties weren't a json object
+	bool valid = false;
+	std::vector<RTXAnchorDesc> anchors;
+	RTXConfigVars configVars;
+};
+
+// Everything used from the config json, only rebuilt when the file changes
+struct RTXConfigIndex {
+	bool loaded = false;
+	ULONGLONG fileTime = 0;
+	bool hasLevelProperties = false;
+	// Keyed by lower case level name
+	std::unordered_map<std::string, RTXLevelDesc> levels;
+	bool hasDefaultLevel = false;
+	RTXLevelDesc defaultLevel;
+	std::unordered_set<std::wstring> hashTexBlacklist;
+};
+
+static RTXConfigIndex configIndex;
+// Bumped every time configIndex is rebuilt
+static unsigned int configGeneration = 0;
+
+void loadAnchorsArray(json& anchorsArr, const std::string& levelName, std::vector<RTXAnchorDesc>& anchors) {
 	for (json anchorObj : anchorsArr) {
 		if (!anchorObj.is_object()) {
 			debugf(NAME_D3D9DrvRTX, TEXT("Error RTXAnchor '%s' in level '%s' is not an object!"), to_app_str(anchorObj.dump()).c_str(), to_app_str(levelName).c_str());
@@ -214,7 +200,7 @@ void loadAnchorsArray(json& anchorsArr, const std::string& levelName, RTXAnchors
 
 		if (animType == "static") {
 			if (anchorError) continue;
-			anchors.push_back(std::make_unique<RTXAnchor>(name, startLoc, startRot, scale, rotationRate, pausable));
+			anchors.push_back({ name, startLoc, startRot, scale, rotationRate, pausable, false, false, FVector(0, 0, 0), 0.0f });
 		}
 		else if (animType == "linear" || animType == "ping-pong") {
 			FVector endLoc;
@@ -222,12 +208,7 @@ void loadAnchorsArray(json& anchorsArr, const std::string& levelName, RTXAnchors
 			float speed{ 0.0f };
 			GET_ANCHOR_MEMBER(speed, speed);
 			if (anchorError) continue;
-			if (animType == "ping-pong") {
-				anchors.push_back(std::make_unique<RTXAnchorPingPong>(name, startLoc, startRot, scale, rotationRate, pausable, endLoc, speed));
-			}
-			else {
-				anchors.push_back(std::make_unique<RTXAnchorLinear>(name, startLoc, startRot, scale, rotationRate, pausable, endLoc, speed));
-			}
+			anchors.push_back({ name, startLoc, startRot, scale, rotationRate, pausable, true, animType == "ping-pong", endLoc, speed });
 		}
 		else {
 			debugf(NAME_D3D9DrvRTX, TEXT("Unknown anim_type on RTXAnchor '%s' in level '%s': %s"), to_app_str(anchorObj.dump()).c_str(), to_app_str(levelName).c_str(), to_app_str(animType).c_str());
@@ -270,44 +251,20 @@ json loadConfigFile() {
 	}
 }
 
-void loadLevelJson(const TCHAR* rawLevelName, RTXAnchors& anchors, RTXConfigVars& remixConfigVariables) {
-	std::string levelName = normalize_level_name(from_app_str(rawLevelName));
-	json configJson = loadConfigFile();
-	if (configJson.is_null()) {
+void loadLevelDesc(json& levelObj, const std::string& levelName, RTXLevelDesc& level) {
+	if (!levelObj.is_object()) {
+		debugf(NAME_D3D9DrvRTX, TEXT("Level '%s' properties value is not a json object!"), to_app_str(levelName).c_str());
 		return;
 	}
+	level.valid = true;
 	try {
-		json& levelProperties = configJson["level_properties"];
-		if (!levelProperties.is_object()) {
-			debugf(NAME_D3D9DrvRTX, TEXT("No level_properties defined in config json."));
-			return;
-		}
-		json levelObj;
-		for (const auto& [key, val] : levelProperties.items()) {
-			if (toLower(key) == levelName) {
-				levelObj = val;
-				break;
-			}
-		}
-		if (levelObj.is_null()) {
-			debugf(NAME_D3D9DrvRTX, TEXT("Level '%s' was not found in level_properties, attempting to use 'level_properties_default'"), to_app_str(levelName).c_str());
-			levelObj = configJson["level_properties_default"];
-			if (levelObj.is_null()) {
-				debugf(NAME_D3D9DrvRTX, TEXT("No 'level_properties_default' was found."));
-				return;
-			}
-		}
-		if (!levelObj.is_object()) {
-			debugf(NAME_D3D9DrvRTX, TEXT("Level '%s' properties value is not a json object!"), to_app_str(levelName).c_str());
-			return;
-		}
 		json& anchorsArr = levelObj["anchors"];
 		if (anchorsArr.is_array()) {
-			loadAnchorsArray(anchorsArr, levelName, anchors);
+			loadAnchorsArray(anchorsArr, levelName, level.anchors);
 		}
 		json& configVars = levelObj["config_vars"];
 		if (configVars.is_object()) {
-			loadConfigVars(configVars, levelName, remixConfigVariables);
+			loadConfigVars(configVars, levelName, level.configVars);
 		}
 	}
 	catch (const json::exception& e) {
@@ -315,21 +272,16 @@ void loadLevelJson(const TCHAR* rawLevelName, RTXAnchors& anchors, RTXConfigVars
 	}
 }
 
-std::unordered_set<std::wstring> getHashTexBlacklist() {
-	json configJson = loadConfigFile();
-	std::unordered_set<std::wstring> blacklist{};
-	if (configJson.is_null()) {
-		return blacklist;
-	}
+void loadHashTexBlacklist(json& configJson, std::unordered_set<std::wstring>& blacklist) {
 	try {
 		json& blacklistArray= configJson["hash_tex_blacklist"];
 		if (blacklistArray.is_null()) {
 			debugf(NAME_D3D9DrvRTX, TEXT("hash_tex_blacklist was not found in json config."));
-			return blacklist;
+			return;
 		}
 		if (!blacklistArray.is_array()) {
 			debugf(NAME_D3D9DrvRTX, TEXT("hash_tex_blacklist json config was not an array type!"));
-			return blacklist;
+			return;
 		}
 		for (const std::string& item : blacklistArray) {
 			dout << item.c_str() << std::endl;
@@ -339,5 +291,95 @@ std::unordered_set<std::wstring> getHashTexBlacklist() {
 	catch (const json::exception& e) {
 		debugf(NAME_D3D9DrvRTX, TEXT("Error loading hash texture blacklist: %s"), to_app_str(e.what()).c_str());
 	}
-	return blacklist;
+}
+
+// Reparses the config into configIndex if the file has been modified since it was last read
+void updateConfigIndex() {
+	WIN32_FILE_ATTRIBUTE_DATA fileData;
+	ULONGLONG fileTime = 0;
+	if (GetFileAttributesExA(config_filename.c_str(), GetFileExInfoStandard, &fileData)) {
+		fileTime = ((ULONGLONG)fileData.ftLastWriteTime.dwHighDateTime << 32) | fileData.ftLastWriteTime.dwLowDateTime;
+	}
+	if (configIndex.loaded && configIndex.fileTime == fileTime) {
+		return;
+	}
+
+	configIndex = RTXConfigIndex();
+	configIndex.loaded = true;
+	configGeneration++;
+	configIndex.fileTime = fileTime;
+
+	json configJson = loadConfigFile();
+	if (configJson.is_null()) {
+		return;
+	}
+	try {
+		json& levelProperties = configJson["level_properties"];
+		if (levelProperties.is_object()) {
+			configIndex.hasLevelProperties = true;
+			for (auto it = levelProperties.begin(); it != levelProperties.end(); ++it) {
+				std::string levelName = toLower(it.key());
+				// First match wins, same as when levels were searched for by name
+				if (configIndex.levels.find(levelName) != configIndex.levels.end()) {
+					continue;
+				}
+				loadLevelDesc(it.value(), levelName, configIndex.levels[levelName]);
+			}
+		}
+		json& defaultObj = configJson["level_properties_default"];
+		if (!defaultObj.is_null()) {
+			configIndex.hasDefaultLevel = true;
+			loadLevelDesc(defaultObj, "level_properties_default", configIndex.defaultLevel);
+		}
+	}
+	catch (const json::exception& e) {
+		debugf(NAME_D3D9DrvRTX, TEXT("Error loading level properties: %s"), to_app_str(e.what()).c_str());
+	}
+	loadHashTexBlacklist(configJson, configIndex.hashTexBlacklist);
+}
+
+void loadLevelJson(const TCHAR* rawLevelName, RTXAnchors& anchors, RTXConfigVars& remixConfigVariables) {
+	std::string levelName = normalize_level_name(from_app_str(rawLevelName));
+	updateConfigIndex();
+	if (!configIndex.hasLevelProperties) {
+		debugf(NAME_D3D9DrvRTX, TEXT("No level_properties defined in config json."));
+		return;
+	}
+	const RTXLevelDesc* level;
+	auto levelIt = configIndex.levels.find(levelName);
+	if (levelIt != configIndex.levels.end()) {
+		level = &levelIt->second;
+	}
+	else {
+		debugf(NAME_D3D9DrvRTX, TEXT("Level '%s' was not found in level_properties, attempting to use 'level_properties_default'"), to_app_str(levelName).c_str());
+		if (!configIndex.hasDefaultLevel) {
+			debugf(NAME_D3D9DrvRTX, TEXT("No 'level_properties_default' was found."));
+			return;
+		}
+		level = &configIndex.defaultLevel;
+	}
+	if (!level->valid) {
+		return;
+	}
+	for (const RTXAnchorDesc& anchor : level->anchors) {
+		if (anchor.isPath) {
+			anchors.addPath(anchor.name, anchor.startLoc, anchor.startRot, anchor.scale, anchor.rotationRate, anchor.pausable, anchor.endLoc, anchor.speed, anchor.pingPong);
+		}
+		else {
+			anchors.addStatic(anchor.name, anchor.startLoc, anchor.startRot, anchor.scale, anchor.rotationRate, anchor.pausable);
+		}
+	}
+	for (const auto& [key, value] : level->configVars) {
+		remixConfigVariables[key] = value;
+	}
+}
+
+std::unordered_set<std::wstring> getHashTexBlacklist() {
+	updateConfigIndex();
+	return configIndex.hashTexBlacklist;
+}
+
+unsigned int getConfigGeneration() {
+	updateConfigIndex();
+	return configGeneration;
 }
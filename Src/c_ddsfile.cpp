@@ -0,0 +1,142 @@
+
+#include "c_ddsfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+enum {
+	DDS_MAGIC = 0x20534444, //'DDS '
+
+	DDSD_CAPS = 0x1,
+	DDSD_HEIGHT = 0x2,
+	DDSD_WIDTH = 0x4,
+	DDSD_PITCH = 0x8,
+	DDSD_PIXELFORMAT = 0x1000,
+	DDSD_LINEARSIZE = 0x80000,
+
+	DDPF_ALPHAPIXELS = 0x1,
+	DDPF_FOURCC = 0x4,
+	DDPF_RGB = 0x40,
+
+	DDSCAPS_TEXTURE = 0x1000
+};
+
+static inline unsigned int make_fourcc(char a, char b, char c, char d) {
+	return (unsigned int)(unsigned char)a | ((unsigned int)(unsigned char)b << 8) |
+		((unsigned int)(unsigned char)c << 16) | ((unsigned int)(unsigned char)d << 24);
+}
+
+static inline bool is_compressed(CDDSFile::format_t format) {
+	return (format == CDDSFile::FORMAT_DXT1) || (format == CDDSFile::FORMAT_DXT3) || (format == CDDSFile::FORMAT_DXT5);
+}
+
+
+static FILE *open_file(const wchar_t *pFileName) {
+#ifdef _WIN32
+	return _wfopen(pFileName, L"wb");
+#else
+	size_t len = wcstombs(0, pFileName, 0);
+	if (len == (size_t)-1) {
+		return 0;
+	}
+	std::string name(len, '\0');
+	wcstombs(&name[0], pFileName, len);
+	return fopen(name.c_str(), "wb");
+#endif
+}
+
+static void remove_file(const wchar_t *pFileName) {
+#ifdef _WIN32
+	_wremove(pFileName);
+#else
+	size_t len = wcstombs(0, pFileName, 0);
+	if (len == (size_t)-1) {
+		return;
+	}
+	std::string name(len, '\0');
+	wcstombs(&name[0], pFileName, len);
+	unlink(name.c_str());
+#endif
+}
+
+
+unsigned int CDDSFile::data_size(format_t format, unsigned int width, unsigned int height) {
+	if (!is_compressed(format)) {
+		return width * height * 4;
+	}
+	unsigned int blockBytes = (format == FORMAT_DXT1) ? 8 : 16;
+	return ((width + 3) >> 2) * ((height + 3) >> 2) * blockBytes;
+}
+
+bool CDDSFile::write(const wchar_t *pFileName, format_t format, unsigned int width, unsigned int height, const void *pData) {
+	header_t header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(header);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+	header.height = height;
+	header.width = width;
+	header.mipMapCount = 1;
+	header.pixelFormat.size = sizeof(header.pixelFormat);
+	header.caps = DDSCAPS_TEXTURE;
+
+	switch (format) {
+	case FORMAT_DXT1:
+		header.pixelFormat.fourCC = make_fourcc('D', 'X', 'T', '1');
+		break;
+	case FORMAT_DXT3:
+		header.pixelFormat.fourCC = make_fourcc('D', 'X', 'T', '3');
+		break;
+	case FORMAT_DXT5:
+		header.pixelFormat.fourCC = make_fourcc('D', 'X', 'T', '5');
+		break;
+	default:
+		header.pixelFormat.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		header.pixelFormat.rgbBitCount = 32;
+		header.pixelFormat.gBitMask = 0x0000FF00;
+		header.pixelFormat.aBitMask = 0xFF000000;
+		if (format == FORMAT_BGRA8) {
+			header.pixelFormat.rBitMask = 0x00FF0000;
+			header.pixelFormat.bBitMask = 0x000000FF;
+		}
+		else {
+			header.pixelFormat.rBitMask = 0x000000FF;
+			header.pixelFormat.bBitMask = 0x00FF0000;
+		}
+	}
+
+	unsigned int dataSize = data_size(format, width, height);
+	if (is_compressed(format)) {
+		header.flags |= DDSD_LINEARSIZE;
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.pitchOrLinearSize = dataSize;
+	}
+	else {
+		header.flags |= DDSD_PITCH;
+		header.pitchOrLinearSize = width * 4;
+	}
+
+	FILE *pFile = open_file(pFileName);
+	if (pFile == 0) {
+		return false;
+	}
+
+	unsigned int magic = DDS_MAGIC;
+	bool ok = (fwrite(&magic, sizeof(magic), 1, pFile) == 1) &&
+		(fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+		(fwrite(pData, dataSize, 1, pFile) == 1);
+	ok = (fclose(pFile) == 0) && ok;
+
+	//Don't leave a broken file for the next run to pick up
+	if (!ok) {
+		remove_file(pFileName);
+	}
+
+	return ok;
+}
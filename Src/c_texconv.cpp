@@ -0,0 +1,226 @@
+
+#include "c_texconv.h"
+
+#include <string.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TEXCONV_TARGET(x)
+#else
+#include <cpuid.h>
+#define TEXCONV_TARGET(x) __attribute__((target(x)))
+#endif
+
+
+static void cpuid_query(int info[4], int leaf, int subLeaf) {
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subLeaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subLeaf, a, b, c, d);
+	info[0] = (int)a;
+	info[1] = (int)b;
+	info[2] = (int)c;
+	info[3] = (int)d;
+#endif
+}
+
+static unsigned long long xgetbv_query(unsigned int index) {
+#if defined(_MSC_VER)
+	return _xgetbv(index);
+#else
+	unsigned int a, d;
+	__asm__ __volatile__("xgetbv" : "=a"(a), "=d"(d) : "c"(index));
+	return ((unsigned long long)d << 32) | a;
+#endif
+}
+
+
+static inline unsigned int swap_rb(unsigned int c) {
+	return (c & 0xFF00FF00) | ((c >> 16) & 0xFF) | ((c << 16) & 0xFF0000);
+}
+
+
+//Scalar versions
+static void copy_scalar(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	memcpy(pDst, pSrc, count * sizeof(unsigned int));
+}
+
+static void shl1_scalar(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	for (unsigned int u = 0; u < count; u++) {
+		pDst[u] = pSrc[u] * 2;
+	}
+}
+
+static void swap_rb_scalar(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	for (unsigned int u = 0; u < count; u++) {
+		pDst[u] = swap_rb(pSrc[u]);
+	}
+}
+
+static void palette_scalar(unsigned int *pDst, const unsigned char *pSrc, const unsigned int *pPalette, unsigned int count) {
+	unsigned int u = 0;
+	for (; (u + 4) <= count; u += 4) {
+		pDst[u + 0] = pPalette[pSrc[u + 0]];
+		pDst[u + 1] = pPalette[pSrc[u + 1]];
+		pDst[u + 2] = pPalette[pSrc[u + 2]];
+		pDst[u + 3] = pPalette[pSrc[u + 3]];
+	}
+	for (; u < count; u++) {
+		pDst[u] = pPalette[pSrc[u]];
+	}
+}
+
+
+//SSE2 versions
+TEXCONV_TARGET("sse2")
+static void shl1_sse2(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	unsigned int u = 0;
+	for (; (u + 4) <= count; u += 4) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(pSrc + u));
+		_mm_storeu_si128((__m128i *)(pDst + u), _mm_slli_epi32(c, 1));
+	}
+	shl1_scalar(pDst + u, pSrc + u, count - u);
+}
+
+TEXCONV_TARGET("sse2")
+static void swap_rb_sse2(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	const __m128i maskAG = _mm_set1_epi32(0xFF00FF00);
+	const __m128i maskB = _mm_set1_epi32(0x000000FF);
+	const __m128i maskR = _mm_set1_epi32(0x00FF0000);
+	unsigned int u = 0;
+	for (; (u + 4) <= count; u += 4) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(pSrc + u));
+		__m128i ag = _mm_and_si128(c, maskAG);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(c, 16), maskB);
+		__m128i r = _mm_and_si128(_mm_slli_epi32(c, 16), maskR);
+		_mm_storeu_si128((__m128i *)(pDst + u), _mm_or_si128(ag, _mm_or_si128(b, r)));
+	}
+	swap_rb_scalar(pDst + u, pSrc + u, count - u);
+}
+
+
+//SSSE3 versions
+TEXCONV_TARGET("ssse3")
+static void swap_rb_ssse3(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	unsigned int u = 0;
+	for (; (u + 4) <= count; u += 4) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(pSrc + u));
+		_mm_storeu_si128((__m128i *)(pDst + u), _mm_shuffle_epi8(c, shuffle));
+	}
+	swap_rb_scalar(pDst + u, pSrc + u, count - u);
+}
+
+
+//AVX2 versions
+TEXCONV_TARGET("avx2")
+static void shl1_avx2(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	unsigned int u = 0;
+	for (; (u + 8) <= count; u += 8) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)(pSrc + u));
+		_mm256_storeu_si256((__m256i *)(pDst + u), _mm256_slli_epi32(c, 1));
+	}
+	shl1_scalar(pDst + u, pSrc + u, count - u);
+}
+
+TEXCONV_TARGET("avx2")
+static void swap_rb_avx2(unsigned int *pDst, const unsigned int *pSrc, unsigned int count) {
+	const __m256i shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	unsigned int u = 0;
+	for (; (u + 8) <= count; u += 8) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)(pSrc + u));
+		_mm256_storeu_si256((__m256i *)(pDst + u), _mm256_shuffle_epi8(c, shuffle));
+	}
+	swap_rb_scalar(pDst + u, pSrc + u, count - u);
+}
+
+TEXCONV_TARGET("avx2")
+static void palette_avx2(unsigned int *pDst, const unsigned char *pSrc, const unsigned int *pPalette, unsigned int count) {
+	unsigned int u = 0;
+	for (; (u + 8) <= count; u += 8) {
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pSrc + u)));
+		__m256i c = _mm256_i32gather_epi32((const int *)pPalette, idx, 4);
+		_mm256_storeu_si256((__m256i *)(pDst + u), c);
+	}
+	palette_scalar(pDst + u, pSrc + u, pPalette, count - u);
+}
+
+
+CTexConv::CTexConv() {
+	set_simd_level(SIMD_AVX2);
+}
+
+CTexConv::~CTexConv() {
+}
+
+void CTexConv::set_simd_level(simd_level_t level) {
+	simd_level_t detectedLevel = detect_simd_level();
+	if (level > detectedLevel) {
+		level = detectedLevel;
+	}
+	m_simdLevel = level;
+
+	pCopy = copy_scalar;
+	pShl1 = shl1_scalar;
+	pSwapRB = swap_rb_scalar;
+	pPalette = palette_scalar;
+
+	if (level >= SIMD_SSE2) {
+		pShl1 = shl1_sse2;
+		pSwapRB = swap_rb_sse2;
+	}
+	if (level >= SIMD_SSSE3) {
+		pSwapRB = swap_rb_ssse3;
+	}
+	if (level >= SIMD_AVX2) {
+		pShl1 = shl1_avx2;
+		pSwapRB = swap_rb_avx2;
+		pPalette = palette_avx2;
+	}
+}
+
+CTexConv::simd_level_t CTexConv::detect_simd_level(void) {
+	int info[4];
+
+	cpuid_query(info, 0, 0);
+	int maxLeaf = info[0];
+	if (maxLeaf < 1) {
+		return SIMD_NONE;
+	}
+
+	cpuid_query(info, 1, 0);
+	bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+	bool hasSSSE3 = (info[2] & (1 << 9)) != 0;
+	bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	bool hasAVX = (info[2] & (1 << 28)) != 0;
+
+	if (!hasSSE2) {
+		return SIMD_NONE;
+	}
+	if (!hasSSSE3) {
+		return SIMD_SSE2;
+	}
+
+	//AVX2 also needs the OS to save the upper halves of the ymm registers
+	if (hasOSXSAVE && hasAVX && (maxLeaf >= 7) && ((xgetbv_query(0) & 0x6) == 0x6)) {
+		cpuid_query(info, 7, 0);
+		if (info[1] & (1 << 5)) {
+			return SIMD_AVX2;
+		}
+	}
+
+	return SIMD_SSSE3;
+}
+
+const char *CTexConv::simd_level_name(simd_level_t level) {
+	switch (level) {
+	case SIMD_SSE2: return "SSE2";
+	case SIMD_SSSE3: return "SSSE3";
+	case SIMD_AVX2: return "AVX2";
+	default: return "None";
+	}
+}
@@ -0,0 +1,332 @@
+
+#include "c_texdiskcache.h"
+
+#include <string.h>
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+static inline unsigned long long align_record(unsigned long long size) {
+	return (size + 15) & ~15ULL;
+}
+
+
+CTexDiskCache::CTexDiskCache() {
+	m_isOpen = false;
+	m_endOffset = 0;
+	m_maxFileSize = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+	m_mappingSize = 0;
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	m_viewGranularity = sysInfo.dwAllocationGranularity;
+#else
+	m_fd = -1;
+	m_viewGranularity = (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+	m_pView = 0;
+	m_viewSize = 0;
+}
+
+CTexDiskCache::~CTexDiskCache() {
+	close();
+}
+
+bool CTexDiskCache::open(const char *pFileName, unsigned long long maxFileSize) {
+	close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(pFileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+#else
+	m_fd = ::open(pFileName, O_RDWR | O_CREAT, 0644);
+	if (m_fd < 0) {
+		return false;
+	}
+#endif
+	m_isOpen = true;
+	m_maxFileSize = maxFileSize;
+
+	unsigned long long fileSize = query_file_size();
+
+	//Start over if the header is missing or from another version
+	pack_header_t header;
+	if ((fileSize < sizeof(header)) || !read_at(0, &header, sizeof(header)) ||
+		(header.magic != PACK_MAGIC) || (header.version != PACK_VERSION)) {
+
+		memset(&header, 0, sizeof(header));
+		header.magic = PACK_MAGIC;
+		header.version = PACK_VERSION;
+		if (!truncate(0) || !write_at(0, &header, sizeof(header))) {
+			close();
+			return false;
+		}
+		m_endOffset = sizeof(header);
+		return true;
+	}
+
+	//Build the index from the record headers
+	unsigned long long offset = sizeof(header);
+	for (;;) {
+		record_header_t recHeader;
+		if ((offset + sizeof(recHeader)) > fileSize) {
+			break;
+		}
+		if (!read_at(offset, &recHeader, sizeof(recHeader))) {
+			break;
+		}
+		//A torn write can leave the header unwritten, usually as a hole of zeros, with record data after it
+		if ((recHeader.magic != RECORD_MAGIC) || (recHeader.headerChecksum != calc_header_checksum(recHeader))) {
+			break;
+		}
+		unsigned long long recEnd = offset + align_record(sizeof(recHeader) + recHeader.size);
+		if (recEnd > fileSize) {
+			break;
+		}
+
+		entry_t entry;
+		entry.offset = offset + sizeof(recHeader);
+		entry.size = recHeader.size;
+		entry.checksum = recHeader.checksum;
+		m_index[recHeader.key] = entry;
+
+		offset = recEnd;
+	}
+	m_endOffset = offset;
+
+	//Cut off anything after the last complete record
+	if (fileSize != m_endOffset) {
+		if (!truncate(m_endOffset)) {
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CTexDiskCache::close(void) {
+	unmap_view();
+#ifdef _WIN32
+	if (m_hMapping != NULL) {
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	m_mappingSize = 0;
+	if (m_hFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+#endif
+	m_isOpen = false;
+	m_endOffset = 0;
+	m_index.clear();
+}
+
+const unsigned char *CTexDiskCache::lock(unsigned long long key, unsigned int size) {
+	std::unordered_map<unsigned long long, entry_t>::iterator it = m_index.find(key);
+	if (it == m_index.end()) {
+		return 0;
+	}
+	const entry_t &entry = it->second;
+	if (entry.size != size) {
+		return 0;
+	}
+
+	const unsigned char *pData = map_view(entry.offset, size);
+	if (pData == 0) {
+		return 0;
+	}
+
+	//Drop records that were damaged on disk
+	if (XXH32(pData, size, 0) != entry.checksum) {
+		unmap_view();
+		m_index.erase(it);
+		return 0;
+	}
+
+	return pData;
+}
+
+void CTexDiskCache::unlock(void) {
+	unmap_view();
+}
+
+bool CTexDiskCache::write(unsigned long long key, const void *pData, unsigned int size) {
+	if (!m_isOpen) {
+		return false;
+	}
+	if (contains(key)) {
+		return true;
+	}
+
+	unsigned long long recSize = align_record(sizeof(record_header_t) + size);
+	if ((m_endOffset + recSize) > m_maxFileSize) {
+		return false;
+	}
+
+	record_header_t recHeader;
+	recHeader.magic = RECORD_MAGIC;
+	recHeader.key = key;
+	recHeader.size = size;
+	recHeader.checksum = XXH32(pData, size, 0);
+	recHeader.headerChecksum = calc_header_checksum(recHeader);
+
+	//Data first, so a torn write never leaves a header pointing at missing data inside the file
+	unsigned long long dataOffset = m_endOffset + sizeof(recHeader);
+	unsigned int padSize = (unsigned int)(recSize - sizeof(recHeader) - size);
+	static const unsigned char pad[RECORD_ALIGN] = { 0 };
+	if (!write_at(dataOffset, pData, size) ||
+		((padSize != 0) && !write_at(dataOffset + size, pad, padSize)) ||
+		!write_at(m_endOffset, &recHeader, sizeof(recHeader))) {
+
+		//Leave the file as it was, the partial record is cut off on the next open
+		return false;
+	}
+
+	entry_t entry;
+	entry.offset = dataOffset;
+	entry.size = size;
+	entry.checksum = recHeader.checksum;
+	m_index[key] = entry;
+
+	m_endOffset += recSize;
+
+	return true;
+}
+
+unsigned int CTexDiskCache::calc_header_checksum(const record_header_t &recHeader) {
+	const unsigned char *pFields = (const unsigned char *)&recHeader.key;
+	return XXH32(pFields, sizeof(recHeader) - (pFields - (const unsigned char *)&recHeader), RECORD_MAGIC);
+}
+
+bool CTexDiskCache::read_at(unsigned long long offset, void *pData, unsigned int size) {
+#ifdef _WIN32
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD bytesRead = 0;
+	if (!ReadFile(m_hFile, pData, size, &bytesRead, &overlapped)) {
+		return false;
+	}
+	return bytesRead == size;
+#else
+	return pread(m_fd, pData, size, (off_t)offset) == (ssize_t)size;
+#endif
+}
+
+bool CTexDiskCache::write_at(unsigned long long offset, const void *pData, unsigned int size) {
+#ifdef _WIN32
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD bytesWritten = 0;
+	if (!WriteFile(m_hFile, pData, size, &bytesWritten, &overlapped)) {
+		return false;
+	}
+	return bytesWritten == size;
+#else
+	return pwrite(m_fd, pData, size, (off_t)offset) == (ssize_t)size;
+#endif
+}
+
+bool CTexDiskCache::truncate(unsigned long long size) {
+#ifdef _WIN32
+	LARGE_INTEGER pos;
+	pos.QuadPart = (LONGLONG)size;
+	if (!SetFilePointerEx(m_hFile, pos, NULL, FILE_BEGIN)) {
+		return false;
+	}
+	return SetEndOfFile(m_hFile) != 0;
+#else
+	return ftruncate(m_fd, (off_t)size) == 0;
+#endif
+}
+
+unsigned long long CTexDiskCache::query_file_size(void) {
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size)) {
+		return 0;
+	}
+	return (unsigned long long)size.QuadPart;
+#else
+	struct stat st;
+	if (fstat(m_fd, &st) != 0) {
+		return 0;
+	}
+	return (unsigned long long)st.st_size;
+#endif
+}
+
+const unsigned char *CTexDiskCache::map_view(unsigned long long offset, unsigned int size) {
+	unmap_view();
+
+	//Views must start on the allocation granularity
+	unsigned long long viewOffset = offset - (offset % m_viewGranularity);
+	unsigned long long viewSize = (offset - viewOffset) + size;
+
+#ifdef _WIN32
+	//The mapping only covers the file size it was created with, so recreate it after records are appended
+	if ((m_hMapping == NULL) || ((offset + size) > m_mappingSize)) {
+		if (m_hMapping != NULL) {
+			CloseHandle(m_hMapping);
+		}
+		m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMapping == NULL) {
+			m_mappingSize = 0;
+			return 0;
+		}
+		m_mappingSize = m_endOffset;
+	}
+
+	m_pView = MapViewOfFile(m_hMapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)viewOffset, (SIZE_T)viewSize);
+	if (m_pView == NULL) {
+		return 0;
+	}
+#else
+	void *pView = mmap(0, (size_t)viewSize, PROT_READ, MAP_SHARED, m_fd, (off_t)viewOffset);
+	if (pView == MAP_FAILED) {
+		return 0;
+	}
+	m_pView = pView;
+#endif
+	m_viewSize = viewSize;
+
+	return (const unsigned char *)m_pView + (offset - viewOffset);
+}
+
+void CTexDiskCache::unmap_view(void) {
+	if (m_pView == 0) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(m_pView);
+#else
+	munmap(m_pView, (size_t)m_viewSize);
+#endif
+	m_pView = 0;
+	m_viewSize = 0;
+}
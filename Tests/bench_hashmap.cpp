@@ -0,0 +1,197 @@
+//Texture cache lookups, the old forest of 16 red-black trees against ptr_hashmap
+//CacheIDs are shaped like the engine's: an 8-bit type in the low byte and an object index above it
+//Textures have a zero upper DWORD, lightmaps carry their surface's model index in it
+
+#include "test_common.h"
+#include "c_rbtree.h"
+#include "c_hashmap.h"
+
+#include <vector>
+
+typedef unsigned int DWORD;
+typedef unsigned long long QWORD;
+
+struct cached_t {
+	QWORD cacheID;
+	unsigned int lastUsed;
+};
+
+enum {
+	NUM_TREES = 16,
+	NUM_TEXTURES = 1500,
+	NUM_LIGHTMAPS = 6000,
+	TEXTURES_PER_FRAME = 600,
+	LIGHTMAPS_PER_FRAME = 2500,
+	NUM_FRAMES = 2000
+};
+
+static inline DWORD zero_prefix_tree_index(DWORD suffix) {
+	return (suffix >> 12) & (NUM_TREES - 1);
+}
+static inline DWORD non_zero_prefix_tree_index(DWORD suffix) {
+	return (suffix >> 20) & (NUM_TREES - 1);
+}
+
+static QWORD make_texture_id(unsigned int objectIndex) {
+	return 0xE0 | ((QWORD)objectIndex << 8);
+}
+static QWORD make_lightmap_id(unsigned int surfIndex, unsigned int modelIndex) {
+	return 0x84 | ((QWORD)surfIndex << 8) | ((QWORD)(modelIndex + 1) << 32);
+}
+
+//The same stream of lookups is replayed against both caches
+//Misses are lightmaps that were evicted, they are put back in place of another one
+struct lookup_t {
+	QWORD cacheID;
+	QWORD evictID;
+};
+
+static std::vector<lookup_t> make_lookups(void) {
+	test_rng rng(2024);
+	std::vector<QWORD> textures(NUM_TEXTURES);
+	for (unsigned int i = 0; i < NUM_TEXTURES; i++) {
+		textures[i] = make_texture_id(2000 + i * 7 + rng.below(7));
+	}
+	std::vector<QWORD> lightmaps(NUM_LIGHTMAPS);
+	for (unsigned int i = 0; i < NUM_LIGHTMAPS; i++) {
+		lightmaps[i] = make_lightmap_id(i, rng.below(4));
+	}
+
+	std::vector<lookup_t> lookups;
+	lookups.reserve((size_t)NUM_FRAMES * (TEXTURES_PER_FRAME + LIGHTMAPS_PER_FRAME));
+	unsigned int nextSurf = NUM_LIGHTMAPS;
+	for (unsigned int frame = 0; frame < NUM_FRAMES; frame++) {
+		//Views move slowly, so each frame sees a window of the level
+		unsigned int texBase = (frame * 3) % NUM_TEXTURES;
+		for (unsigned int i = 0; i < TEXTURES_PER_FRAME; i++) {
+			lookup_t lookup = { textures[(texBase + rng.below(TEXTURES_PER_FRAME * 2)) % NUM_TEXTURES], 0 };
+			lookups.push_back(lookup);
+		}
+		unsigned int lmBase = (frame * 11) % NUM_LIGHTMAPS;
+		for (unsigned int i = 0; i < LIGHTMAPS_PER_FRAME; i++) {
+			unsigned int slot = (lmBase + rng.below(LIGHTMAPS_PER_FRAME * 2)) % NUM_LIGHTMAPS;
+			lookup_t lookup = { lightmaps[slot], 0 };
+			if (rng.below(100) == 0) {
+				lookup.evictID = lightmaps[slot];
+				lightmaps[slot] = make_lightmap_id(nextSurf++, rng.below(4));
+				lookup.cacheID = lightmaps[slot];
+			}
+			lookups.push_back(lookup);
+		}
+	}
+	return lookups;
+}
+
+typedef rbtree<DWORD, cached_t> dword_tree_t;
+typedef rbtree<QWORD, cached_t> qword_tree_t;
+
+static double run_rbtree(const std::vector<lookup_t> &lookups, unsigned long long &checksum) {
+	rbtree_allocator<dword_tree_t> dwordAllocator;
+	rbtree_allocator<qword_tree_t> qwordAllocator;
+	dword_tree_t zeroPrefixTrees[NUM_TREES];
+	qword_tree_t nonZeroPrefixTrees[NUM_TREES];
+
+	double startTime = bench_now();
+	unsigned int tick = 0;
+	for (const lookup_t &lookup : lookups) {
+		DWORD suffix = (DWORD)lookup.cacheID;
+		cached_t *pCached;
+		if ((lookup.cacheID >> 32) == 0) {
+			dword_tree_t &tree = zeroPrefixTrees[zero_prefix_tree_index(suffix)];
+			dword_tree_t::node_t *pNode = tree.find(suffix);
+			if (pNode == 0) {
+				pNode = dwordAllocator.alloc_node();
+				pNode->key = suffix;
+				pNode->data.cacheID = lookup.cacheID;
+				tree.insert(pNode);
+			}
+			pCached = &pNode->data;
+		}
+		else {
+			if (lookup.evictID) {
+				qword_tree_t &evictTree = nonZeroPrefixTrees[non_zero_prefix_tree_index((DWORD)lookup.evictID)];
+				qword_tree_t::node_t *pEvict = evictTree.find(lookup.evictID);
+				if (pEvict) {
+					evictTree.remove(pEvict);
+					qwordAllocator.free_node(pEvict);
+				}
+			}
+			qword_tree_t &tree = nonZeroPrefixTrees[non_zero_prefix_tree_index(suffix)];
+			qword_tree_t::node_t *pNode = tree.find(lookup.cacheID);
+			if (pNode == 0) {
+				pNode = qwordAllocator.alloc_node();
+				pNode->key = lookup.cacheID;
+				pNode->data.cacheID = lookup.cacheID;
+				tree.insert(pNode);
+			}
+			pCached = &pNode->data;
+		}
+		pCached->lastUsed = tick++;
+		checksum += pCached->cacheID;
+	}
+	double elapsed = bench_now() - startTime;
+
+	for (unsigned int u = 0; u < NUM_TREES; u++) {
+		zeroPrefixTrees[u].clear(&dwordAllocator);
+		nonZeroPrefixTrees[u].clear(&qwordAllocator);
+	}
+	return elapsed;
+}
+
+static double run_hashmap(const std::vector<lookup_t> &lookups, unsigned long long &checksum) {
+	ptr_hashmap<DWORD, cached_t> zeroPrefixMap;
+	ptr_hashmap<QWORD, cached_t> nonZeroPrefixMap;
+
+	double startTime = bench_now();
+	unsigned int tick = 0;
+	for (const lookup_t &lookup : lookups) {
+		cached_t *pCached;
+		if ((lookup.cacheID >> 32) == 0) {
+			DWORD suffix = (DWORD)lookup.cacheID;
+			pCached = zeroPrefixMap.find(suffix);
+			if (pCached == 0) {
+				pCached = new cached_t;
+				pCached->cacheID = lookup.cacheID;
+				zeroPrefixMap.insert(suffix, pCached);
+			}
+		}
+		else {
+			if (lookup.evictID) {
+				delete nonZeroPrefixMap.remove(lookup.evictID);
+			}
+			pCached = nonZeroPrefixMap.find(lookup.cacheID);
+			if (pCached == 0) {
+				pCached = new cached_t;
+				pCached->cacheID = lookup.cacheID;
+				nonZeroPrefixMap.insert(lookup.cacheID, pCached);
+			}
+		}
+		pCached->lastUsed = tick++;
+		checksum += pCached->cacheID;
+	}
+	double elapsed = bench_now() - startTime;
+
+	zeroPrefixMap.for_each([](DWORD, cached_t *pCached) { delete pCached; });
+	nonZeroPrefixMap.for_each([](QWORD, cached_t *pCached) { delete pCached; });
+	return elapsed;
+}
+
+int main() {
+	std::vector<lookup_t> lookups = make_lookups();
+
+	unsigned long long treeChecksum = 0, mapChecksum = 0;
+	double treeTime = run_rbtree(lookups, treeChecksum);
+	double mapTime = run_hashmap(lookups, mapChecksum);
+
+	double numLookups = (double)lookups.size();
+	printf("%u frames, %.0f lookups\n", (unsigned int)NUM_FRAMES, numLookups);
+	printf("rbtree forest: %7.2f ns/lookup\n", treeTime * 1e9 / numLookups);
+	printf("ptr_hashmap:   %7.2f ns/lookup\n", mapTime * 1e9 / numLookups);
+	printf("speedup:       %7.2fx\n", treeTime / mapTime);
+
+	if (treeChecksum != mapChecksum) {
+		fprintf(stderr, "Lookup results differ\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,42 @@
+//Ticking a level's anchors, the RTXAnchors arrays against the old per-anchor objects with a virtual Tick
+
+#include "test_common.h"
+#include "rtxanchor_scene.h"
+
+enum {
+	NUM_ANCHORS = 10000,
+	NUM_TICKS = 2000
+};
+
+int main() {
+	anchor_scene_t scene;
+	test_rng rng(10000);
+	scene.add_random(rng, NUM_ANCHORS);
+	const float deltaTime = 1.0f / 60.0f;
+
+	double startTime = bench_now();
+	for (unsigned int tick = 0; tick < NUM_TICKS; tick++) {
+		scene.tick_reference(deltaTime, false);
+	}
+	double refTime = bench_now() - startTime;
+
+	startTime = bench_now();
+	for (unsigned int tick = 0; tick < NUM_TICKS; tick++) {
+		scene.anchors.tick(deltaTime, false);
+	}
+	double arrayTime = bench_now() - startTime;
+
+	double numAnchorTicks = (double)NUM_ANCHORS * NUM_TICKS;
+	printf("%u anchors, %u ticks\n", (unsigned int)NUM_ANCHORS, (unsigned int)NUM_TICKS);
+	printf("old classes:  %7.2f ns/anchor, %7.1f us/tick\n", refTime * 1e9 / numAnchorTicks, refTime * 1e6 / NUM_TICKS);
+	printf("RTXAnchors:   %7.2f ns/anchor, %7.1f us/tick\n", arrayTime * 1e9 / numAnchorTicks, arrayTime * 1e6 / NUM_TICKS);
+	printf("speedup:      %7.2fx\n", refTime / arrayTime);
+
+	for (size_t i = 0; i < scene.anchors.size(); i++) {
+		if (!scene.matches(i)) {
+			fprintf(stderr, "Anchor %u differs from the old classes\n", (unsigned int)i);
+			return 1;
+		}
+	}
+	return 0;
+}
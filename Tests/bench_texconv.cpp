@@ -0,0 +1,69 @@
+//Throughput of each row converter at every SIMD level the CPU supports
+
+#include "test_common.h"
+#include "c_texconv.h"
+
+#include <vector>
+
+enum {
+	ROW_TEXELS = 256,
+	NUM_ROWS = 256,
+	NUM_PASSES = 200
+};
+
+static volatile unsigned int g_sink;
+
+template <class FuncT> static double time_rows(FuncT func) {
+	double startTime = bench_now();
+	for (unsigned int pass = 0; pass < NUM_PASSES; pass++) {
+		for (unsigned int row = 0; row < NUM_ROWS; row++) {
+			func(row);
+		}
+	}
+	return bench_now() - startTime;
+}
+
+int main() {
+	test_rng rng(7);
+	std::vector<unsigned int> src(ROW_TEXELS * NUM_ROWS);
+	for (unsigned int &texel : src) {
+		texel = rng.next() ^ (rng.next() << 16);
+	}
+	std::vector<unsigned char> srcP8(ROW_TEXELS * NUM_ROWS);
+	for (unsigned char &index : srcP8) {
+		index = (unsigned char)rng.next();
+	}
+	std::vector<unsigned int> palette(256);
+	for (unsigned int &color : palette) {
+		color = rng.next();
+	}
+	std::vector<unsigned int> dst(ROW_TEXELS * NUM_ROWS);
+
+	double mtexels = (double)ROW_TEXELS * NUM_ROWS * NUM_PASSES / 1e6;
+	printf("%u x %u texels, %u passes, Mtexels/s\n", (unsigned int)ROW_TEXELS, (unsigned int)NUM_ROWS, (unsigned int)NUM_PASSES);
+	printf("%-6s %10s %10s %10s %10s\n", "level", "copy", "BGRA7777", "swapRB", "P8");
+
+	CTexConv::simd_level_t detected = CTexConv::detect_simd_level();
+	for (int level = CTexConv::SIMD_NONE; level <= detected; level++) {
+		CTexConv conv;
+		conv.set_simd_level((CTexConv::simd_level_t)level);
+
+		double copyTime = time_rows([&](unsigned int row) {
+			conv.pCopy(&dst[row * ROW_TEXELS], &src[row * ROW_TEXELS], ROW_TEXELS);
+		});
+		double shl1Time = time_rows([&](unsigned int row) {
+			conv.pShl1(&dst[row * ROW_TEXELS], &src[row * ROW_TEXELS], ROW_TEXELS);
+		});
+		double swapTime = time_rows([&](unsigned int row) {
+			conv.pSwapRB(&dst[row * ROW_TEXELS], &src[row * ROW_TEXELS], ROW_TEXELS);
+		});
+		double paletteTime = time_rows([&](unsigned int row) {
+			conv.pPalette(&dst[row * ROW_TEXELS], &srcP8[row * ROW_TEXELS], &palette[0], ROW_TEXELS);
+		});
+		g_sink = dst[rng.below(ROW_TEXELS * NUM_ROWS)];
+
+		printf("%-6s %10.0f %10.0f %10.0f %10.0f\n", CTexConv::simd_level_name(conv.get_simd_level()),
+			mtexels / copyTime, mtexels / shl1Time, mtexels / swapTime, mtexels / paletteTime);
+	}
+	return 0;
+}
@@ -1,3 +1,5 @@
+//The texture cache's red-black tree from before it moved to ptr_hashmap
+//Only kept as the baseline for bench_hashmap
 
 #ifndef _C_RBTREE_
 #define _C_RBTREE_
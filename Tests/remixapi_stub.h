@@ -0,0 +1,178 @@
+#ifndef _REMIXAPI_STUB_
+#define _REMIXAPI_STUB_
+
+//Stands in for the Remix runtime behind a remixapi_Interface
+//Handles are counted up from 1 and every call is checked against the handles that are alive
+
+#include "remixapi/bridge_remix_api.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct remix_stub_t {
+	uintptr_t nextHandle;
+	//Calls with a handle that was never created or already destroyed
+	unsigned int numBadCalls;
+
+	//Light hash of each live light handle
+	std::unordered_map<remixapi_LightHandle, uint64_t> lights;
+	unsigned int numLightsCreated;
+	unsigned int numLightsDestroyed;
+	//Lights drawn since the last end_frame
+	std::vector<remixapi_LightHandle> drawnLights;
+	//CreateLight fails while this is set
+	bool failCreateLight;
+
+	std::unordered_map<remixapi_MaterialHandle, uint64_t> materials;
+	unsigned int numMaterialsCreated;
+	unsigned int numMaterialsDestroyed;
+
+	struct mesh_t {
+		uint64_t hash;
+		remixapi_MaterialHandle material;
+		uint64_t numVertices;
+		uint64_t numIndices;
+	};
+	std::unordered_map<remixapi_MeshHandle, mesh_t> meshes;
+	unsigned int numMeshesCreated;
+	unsigned int numMeshesDestroyed;
+	//Instances drawn since the last end_frame
+	std::vector<remixapi_InstanceInfo> drawnInstances;
+	//CreateMesh fails while this is set
+	bool failCreateMesh;
+
+	void reset(void) {
+		*this = remix_stub_t();
+	}
+	void end_frame(void) {
+		drawnLights.clear();
+		drawnInstances.clear();
+	}
+	uintptr_t new_handle(void) {
+		return ++nextHandle;
+	}
+};
+
+inline remix_stub_t g_remixStub = remix_stub_t();
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_CreateLight(const remixapi_LightInfo *info, remixapi_LightHandle *out_handle) {
+	if (info == 0 || out_handle == 0 || info->sType != REMIXAPI_STRUCT_TYPE_LIGHT_INFO) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	if (g_remixStub.failCreateLight) {
+		return REMIXAPI_ERROR_CODE_GENERAL_FAILURE;
+	}
+	remixapi_LightHandle handle = (remixapi_LightHandle)g_remixStub.new_handle();
+	g_remixStub.lights[handle] = info->hash;
+	g_remixStub.numLightsCreated++;
+	*out_handle = handle;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_DestroyLight(remixapi_LightHandle handle) {
+	if (g_remixStub.lights.erase(handle) == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	g_remixStub.numLightsDestroyed++;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_DrawLightInstance(remixapi_LightHandle handle) {
+	if (g_remixStub.lights.count(handle) == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	g_remixStub.drawnLights.push_back(handle);
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_CreateMaterial(const remixapi_MaterialInfo *info, remixapi_MaterialHandle *out_handle) {
+	if (info == 0 || out_handle == 0 || info->sType != REMIXAPI_STRUCT_TYPE_MATERIAL_INFO) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	remixapi_MaterialHandle handle = (remixapi_MaterialHandle)g_remixStub.new_handle();
+	g_remixStub.materials[handle] = info->hash;
+	g_remixStub.numMaterialsCreated++;
+	*out_handle = handle;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_DestroyMaterial(remixapi_MaterialHandle handle) {
+	//A material can't go while a mesh is still drawn with it
+	for (const auto &entry : g_remixStub.meshes) {
+		if (entry.second.material == handle) {
+			g_remixStub.numBadCalls++;
+		}
+	}
+	if (g_remixStub.materials.erase(handle) == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	g_remixStub.numMaterialsDestroyed++;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_CreateMesh(const remixapi_MeshInfo *info, remixapi_MeshHandle *out_handle) {
+	if (info == 0 || out_handle == 0 || info->sType != REMIXAPI_STRUCT_TYPE_MESH_INFO || info->surfaces_count != 1 || info->surfaces_values == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	const remixapi_MeshInfoSurfaceTriangles &surface = info->surfaces_values[0];
+	bool valid = (surface.indices_count % 3) == 0 && (surface.vertices_count > 0) &&
+		(surface.material == 0 || g_remixStub.materials.count(surface.material) != 0);
+	for (uint64_t u = 0; u < surface.indices_count; u++) {
+		valid = valid && (surface.indices_values[u] < surface.vertices_count);
+	}
+	if (!valid) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	if (g_remixStub.failCreateMesh) {
+		return REMIXAPI_ERROR_CODE_GENERAL_FAILURE;
+	}
+	remixapi_MeshHandle handle = (remixapi_MeshHandle)g_remixStub.new_handle();
+	remix_stub_t::mesh_t mesh = { info->hash, surface.material, surface.vertices_count, surface.indices_count };
+	g_remixStub.meshes[handle] = mesh;
+	g_remixStub.numMeshesCreated++;
+	*out_handle = handle;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_DestroyMesh(remixapi_MeshHandle handle) {
+	if (g_remixStub.meshes.erase(handle) == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	g_remixStub.numMeshesDestroyed++;
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+static remixapi_ErrorCode REMIXAPI_CALL stub_DrawInstance(const remixapi_InstanceInfo *info) {
+	if (info == 0 || info->sType != REMIXAPI_STRUCT_TYPE_INSTANCE_INFO || g_remixStub.meshes.count(info->mesh) == 0) {
+		g_remixStub.numBadCalls++;
+		return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
+	}
+	g_remixStub.drawnInstances.push_back(*info);
+	return REMIXAPI_ERROR_CODE_SUCCESS;
+}
+
+//Only the function pointers the renderer calls are filled in
+static inline remixapi_Interface make_remix_stub(void) {
+	g_remixStub.reset();
+	remixapi_Interface remix = {};
+	remix.CreateLight = stub_CreateLight;
+	remix.DestroyLight = stub_DestroyLight;
+	remix.DrawLightInstance = stub_DrawLightInstance;
+	remix.CreateMaterial = stub_CreateMaterial;
+	remix.DestroyMaterial = stub_DestroyMaterial;
+	remix.CreateMesh = stub_CreateMesh;
+	remix.DestroyMesh = stub_DestroyMesh;
+	remix.DrawInstance = stub_DrawInstance;
+	return remix;
+}
+
+#endif //_REMIXAPI_STUB_
@@ -0,0 +1,173 @@
+//The level anchors from before they moved to the RTXAnchors arrays, one object per anchor with a virtual Tick
+//Only kept as the baseline for test_rtxanchors and bench_rtxanchors
+
+#ifndef _RTXANCHOR_REFERENCE_
+#define _RTXANCHOR_REFERENCE_
+
+#include "Engine.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reference {
+
+inline double floored_mod(double a, double b) {
+	return a - b * std::floor(a / b);
+}
+
+class RTXAnchor {
+protected:
+	std::string name;
+	uint32_t hash;
+	FVector location;
+	FVector rotation;
+	FVector scale;
+	FVector angularVelocity;
+	bool pausable;
+
+public:
+	RTXAnchor(
+		std::string name,
+		FVector location,
+		FVector startRot,
+		FVector scale,
+		FVector rotationRate,
+		bool pausable
+	);
+
+	virtual void Tick(float deltaTime);
+
+	const FVector& getLocation() const {
+		return location;
+	}
+	const FVector& getRotation() const {
+		return rotation;
+	}
+	const FVector& getScale() const {
+		return scale;
+	}
+	uint32_t getHash() const {
+		return hash;
+	}
+	bool isPausable() const {
+		return pausable;
+	}
+};
+
+class RTXAnchorLinear : public RTXAnchor {
+protected:
+	FVector pathStart;
+	FVector pathDirection;
+	float pathLength;
+	float speed;
+	float pathLocation = 0;
+public:
+	RTXAnchorLinear(
+		std::string name,
+		FVector startLoc,
+		FVector startRot,
+		FVector scale,
+		FVector rotationRate,
+		bool pausable,
+		FVector endLoc,
+		float speed
+	) : RTXAnchor(
+		name,
+		startLoc,
+		startRot,
+		scale,
+		rotationRate,
+		pausable
+	), pathStart(startLoc), pathDirection(endLoc - startLoc), speed(speed) {
+		pathLength = pathDirection.Size();
+		pathDirection.Normalize();
+	}
+	using RTXAnchor::RTXAnchor;
+
+	void Tick(float deltaTime) override;
+};
+
+class RTXAnchorPingPong : public RTXAnchorLinear {
+protected:
+	float pathLengthReal;
+
+public:
+	RTXAnchorPingPong(
+		std::string name,
+		FVector startLoc,
+		FVector startRot,
+		FVector scale,
+		FVector rotationRate,
+		bool pausable,
+		FVector endLoc,
+		float speed
+	) : RTXAnchorLinear(
+		name,
+		startLoc,
+		startRot,
+		scale,
+		rotationRate,
+		pausable,
+		endLoc,
+		speed
+	), pathLengthReal(pathLength){
+		pathLength = pathLength * 2;
+	}
+
+	void Tick(float deltaTime) override;
+};
+
+typedef std::vector<std::unique_ptr<RTXAnchor>> RTXAnchors;
+
+inline RTXAnchor::RTXAnchor(
+	std::string name,
+	FVector location,
+	FVector startRot,
+	FVector scale,
+	FVector rotationRate,
+	bool pausable
+) : name(name),
+	location(location),
+	rotation(startRot),
+	scale(scale),
+	angularVelocity(rotationRate),
+	pausable(pausable)
+{
+	hash = XXH32(name.c_str(), name.size(), 0);
+}
+
+inline void RTXAnchor::Tick(float deltaTime) {
+	rotation += angularVelocity * deltaTime;
+	if (rotation.X > 360.0f || rotation.X < 0.0f) {
+		rotation.X = floored_mod(rotation.X, 360.0);
+	}
+	if (rotation.Y > 360.0f || rotation.Y < 0.0f) {
+		rotation.Y = floored_mod(rotation.Y, 360.0);
+	}
+	if (rotation.Z > 360.0f || rotation.Z < 0.0f) {
+		rotation.Z = floored_mod(rotation.Z, 360.0);
+	}
+}
+
+inline void RTXAnchorLinear::Tick(float deltaTime) {
+	RTXAnchor::Tick(deltaTime);
+	pathLocation += speed * deltaTime;
+	if (pathLocation > pathLength || pathLocation < 0) {
+		pathLocation = floored_mod(pathLocation, pathLength);
+	}
+	location = pathStart + pathDirection * pathLocation;
+}
+
+inline void RTXAnchorPingPong::Tick(float deltaTime) {
+	RTXAnchorLinear::Tick(deltaTime);
+	location = pathStart + pathDirection * (pathLocation < pathLengthReal ? pathLocation : pathLength - pathLocation);
+}
+
+} //namespace reference
+
+#endif //_RTXANCHOR_REFERENCE_
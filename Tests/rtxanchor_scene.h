@@ -0,0 +1,74 @@
+#ifndef _RTXANCHOR_SCENE_
+#define _RTXANCHOR_SCENE_
+
+//Random level anchors added to both the RTXAnchors arrays and the old per-anchor objects
+
+#include "test_common.h"
+#include "RTXAnchors.h"
+#include "rtxanchor_reference.h"
+
+#include <string.h>
+#include <string>
+
+struct anchor_scene_t {
+	RTXAnchors anchors;
+	reference::RTXAnchors refAnchors;
+
+	void add_random(test_rng &rng, unsigned int numAnchors) {
+		for (unsigned int i = 0; i < numAnchors; i++) {
+			std::string name = "Anchor" + std::to_string(anchors.size());
+			FVector location = random_vector(rng, 4096.0f);
+			FVector startRot = random_vector(rng, 360.0f);
+			FVector scale(1.0f, 1.0f, 1.0f);
+			//Some spin backwards, so rotations wrap below 0 as well as past 360
+			FVector rotationRate = random_vector(rng, 180.0f) - FVector(90.0f, 90.0f, 90.0f);
+			bool pausable = rng.below(2) != 0;
+			unsigned int type = rng.below(3);
+			if (type == 0) {
+				anchors.addStatic(name, location, startRot, scale, rotationRate, pausable);
+				refAnchors.emplace_back(new reference::RTXAnchor(name, location, startRot, scale, rotationRate, pausable));
+				continue;
+			}
+			FVector endLoc = location + random_vector(rng, 1024.0f) - FVector(512.0f, 512.0f, 512.0f);
+			float speed = (float)(rng.below(4000) + 1) / 10.0f;
+			if (type == 1) {
+				anchors.addPath(name, location, startRot, scale, rotationRate, pausable, endLoc, speed, false);
+				refAnchors.emplace_back(new reference::RTXAnchorLinear(name, location, startRot, scale, rotationRate, pausable, endLoc, speed));
+			}
+			else {
+				anchors.addPath(name, location, startRot, scale, rotationRate, pausable, endLoc, speed, true);
+				refAnchors.emplace_back(new reference::RTXAnchorPingPong(name, location, startRot, scale, rotationRate, pausable, endLoc, speed));
+			}
+		}
+	}
+
+	//How UD3D9Render ticked the old anchors
+	void tick_reference(float deltaTime, bool paused) {
+		for (auto &anchor : refAnchors) {
+			if (!anchor->isPausable() || !paused) {
+				anchor->Tick(deltaTime);
+			}
+		}
+	}
+
+	//Bit for bit, so the NaNs of a zero length path match too
+	bool matches(size_t index) const {
+		const reference::RTXAnchor &refAnchor = *refAnchors[index];
+		FVector location = anchors.getLocation(index);
+		FVector rotation = anchors.getRotation(index);
+		FVector scale = anchors.getScale(index);
+		return memcmp(&location, &refAnchor.getLocation(), sizeof(FVector)) == 0 &&
+			memcmp(&rotation, &refAnchor.getRotation(), sizeof(FVector)) == 0 &&
+			memcmp(&scale, &refAnchor.getScale(), sizeof(FVector)) == 0 &&
+			anchors.getHash(index) == refAnchor.getHash();
+	}
+
+	static FVector random_vector(test_rng &rng, float range) {
+		return FVector(random_float(rng, range), random_float(rng, range), random_float(rng, range));
+	}
+	static float random_float(test_rng &rng, float range) {
+		return (float)rng.below(1 << 20) * (range / (float)(1 << 20));
+	}
+};
+
+#endif //_RTXANCHOR_SCENE_
@@ -0,0 +1,90 @@
+#ifndef _STUB_CORE_
+#define _STUB_CORE_
+
+//The few engine types the Linux tests need, laid out like Core's so the renderer code builds unchanged
+
+#include <math.h>
+#include <stdarg.h>
+#include <wchar.h>
+
+typedef unsigned char BYTE;
+typedef unsigned short _WORD;
+typedef unsigned int DWORD;
+typedef unsigned long long QWORD;
+typedef int INT;
+typedef DWORD UBOOL;
+typedef float FLOAT;
+typedef wchar_t TCHAR;
+
+#define TEXT(s) L##s
+
+enum EName {
+	NAME_None,
+	NAME_Log
+};
+
+//Log lines are dropped
+inline void debugf(EName, const TCHAR *, ...) {
+}
+
+template<class T> inline T Min(const T a, const T b) {
+	return (a <= b) ? a : b;
+}
+template<class T> inline T Max(const T a, const T b) {
+	return (a >= b) ? a : b;
+}
+
+inline INT appStrlen(const TCHAR *str) {
+	return (INT)wcslen(str);
+}
+
+class FVector {
+public:
+	FLOAT X, Y, Z;
+
+	FVector() {
+	}
+	FVector(FLOAT InX, FLOAT InY, FLOAT InZ) : X(InX), Y(InY), Z(InZ) {
+	}
+
+	FVector operator+(const FVector &V) const {
+		return FVector(X + V.X, Y + V.Y, Z + V.Z);
+	}
+	FVector operator-(const FVector &V) const {
+		return FVector(X - V.X, Y - V.Y, Z - V.Z);
+	}
+	FVector operator*(FLOAT Scale) const {
+		return FVector(X * Scale, Y * Scale, Z * Scale);
+	}
+	FVector operator+=(const FVector &V) {
+		X += V.X;
+		Y += V.Y;
+		Z += V.Z;
+		return *this;
+	}
+	UBOOL operator==(const FVector &V) const {
+		return X == V.X && Y == V.Y && Z == V.Z;
+	}
+	UBOOL operator!=(const FVector &V) const {
+		return X != V.X || Y != V.Y || Z != V.Z;
+	}
+	FLOAT Size() const {
+		return (FLOAT)sqrt(X * X + Y * Y + Z * Z);
+	}
+	FLOAT SizeSquared() const {
+		return X * X + Y * Y + Z * Z;
+	}
+	UBOOL Normalize() {
+		FLOAT SquareSum = X * X + Y * Y + Z * Z;
+		if (SquareSum >= 1.e-8f) {
+			FLOAT Scale = 1.0f / (FLOAT)sqrt(SquareSum);
+			X *= Scale;
+			Y *= Scale;
+			Z *= Scale;
+			return 1;
+		}
+		return 0;
+	}
+};
+
+#endif //_STUB_CORE_
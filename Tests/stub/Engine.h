@@ -0,0 +1,29 @@
+#ifndef _STUB_ENGINE_
+#define _STUB_ENGINE_
+
+#include "Core.h"
+
+enum ELightType {
+	LT_None,
+	LT_Steady,
+	LT_Pulse,
+	LT_Blink,
+	LT_Flicker,
+	LT_Strobe
+};
+
+class FBspNode {
+public:
+	enum {
+		MAX_ZONES = 64
+	};
+};
+
+//Light code only keys on actor pointers
+class AActor {
+public:
+	BYTE LightType;
+	FLOAT LightRadius;
+};
+
+#endif //_STUB_ENGINE_
@@ -0,0 +1,5 @@
+//Log names the renderer sources refer to
+
+#include "D3D9DrvRTX.h"
+
+EName NAME_D3D9DrvRTX = NAME_Log;
@@ -0,0 +1,32 @@
+#ifndef _STUB_WINDOWS_
+#define _STUB_WINDOWS_
+
+//Just enough of windows.h for the Remix API headers, their loader functions are never called
+
+#include <stddef.h>
+#include <wchar.h>
+
+#define __stdcall
+#define __cdecl
+#define __declspec(x)
+
+#define MAX_PATH 260
+#define LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR 0x00000100
+#define LOAD_LIBRARY_SEARCH_DEFAULT_DIRS 0x00001000
+
+typedef int BOOL;
+typedef unsigned int DWORD;
+typedef struct HINSTANCE__ *HMODULE;
+typedef struct HWND__ *HWND;
+typedef int (*PROC)(void);
+
+HMODULE LoadLibraryW(const wchar_t *lpLibFileName);
+HMODULE LoadLibraryExW(const wchar_t *lpLibFileName, void *hFile, DWORD dwFlags);
+HMODULE GetModuleHandleA(const char *lpModuleName);
+PROC GetProcAddress(HMODULE hModule, const char *lpProcName);
+BOOL FreeLibrary(HMODULE hLibModule);
+DWORD GetFullPathNameW(const wchar_t *lpFileName, DWORD nBufferLength, wchar_t *lpBuffer, wchar_t **lpFilePart);
+DWORD GetDllDirectoryW(DWORD nBufferLength, wchar_t *lpBuffer);
+BOOL SetDllDirectoryW(const wchar_t *lpPathName);
+
+#endif //_STUB_WINDOWS_
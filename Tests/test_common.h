@@ -0,0 +1,50 @@
+#ifndef _TEST_COMMON_
+#define _TEST_COMMON_
+
+//Minimal checks for the Linux tests, the renderer itself is only built with MSVC
+
+#include <stdio.h>
+#include <chrono>
+
+inline int g_numFailed = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			g_numFailed++; \
+		} \
+	} while (0)
+
+#define RUN_TEST(func) \
+	do { \
+		int numFailedBefore = g_numFailed; \
+		func(); \
+		printf("%s %s\n", (g_numFailed == numFailedBefore) ? "PASS" : "FAIL", #func); \
+	} while (0)
+
+#define TEST_EXIT_CODE() ((g_numFailed == 0) ? 0 : 1)
+
+//Seconds since some fixed point, for the benchmarks
+static inline double bench_now(void) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Small deterministic generator so runs are repeatable
+struct test_rng {
+	unsigned long long state;
+
+	explicit test_rng(unsigned long long seed) : state(seed) {
+	}
+	unsigned int next(void) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return (unsigned int)(state >> 16);
+	}
+	unsigned int below(unsigned int n) {
+		return next() % n;
+	}
+};
+
+#endif //_TEST_COMMON_
@@ -0,0 +1,150 @@
+#include "test_common.h"
+#include "c_hashmap.h"
+
+#include <unordered_map>
+#include <vector>
+
+struct record_t {
+	unsigned long long key;
+};
+
+static void test_empty(void) {
+	ptr_hashmap<unsigned long long, record_t> map;
+	CHECK(map.size() == 0);
+	CHECK(map.capacity() == 0);
+	CHECK(map.find(1) == 0);
+	CHECK(map.remove(1) == 0);
+	map.clear();
+	int numVisited = 0;
+	map.for_each([&numVisited](unsigned long long, record_t *) { numVisited++; });
+	CHECK(numVisited == 0);
+}
+
+static void test_insert_find_remove(void) {
+	ptr_hashmap<unsigned long long, record_t> map;
+	record_t a = { 10 }, b = { 20 }, c = { 30 };
+
+	CHECK(map.insert(a.key, &a));
+	CHECK(map.insert(b.key, &b));
+	CHECK(map.size() == 2);
+	CHECK(map.find(10) == &a);
+	CHECK(map.find(20) == &b);
+	CHECK(map.find(30) == 0);
+
+	//An existing key has its pointer replaced
+	CHECK(!map.insert(10, &c));
+	CHECK(map.size() == 2);
+	CHECK(map.find(10) == &c);
+
+	CHECK(map.remove(10) == &c);
+	CHECK(map.remove(10) == 0);
+	CHECK(map.find(10) == 0);
+	CHECK(map.find(20) == &b);
+	CHECK(map.size() == 1);
+}
+
+static void test_grow(void) {
+	ptr_hashmap<unsigned int, record_t> map;
+	std::vector<record_t> records(10000);
+	for (unsigned int i = 0; i < records.size(); i++) {
+		records[i].key = i * 256;
+		CHECK(map.insert(i * 256, &records[i]));
+	}
+	CHECK(map.size() == records.size());
+	//Power of 2 with the load factor at or below 3/4
+	CHECK((map.capacity() & (map.capacity() - 1)) == 0);
+	CHECK(map.size() * 4 <= map.capacity() * 3);
+	for (unsigned int i = 0; i < records.size(); i++) {
+		CHECK(map.find(i * 256) == &records[i]);
+	}
+	CHECK(map.find(1) == 0);
+}
+
+static void test_clear_keeps_capacity(void) {
+	ptr_hashmap<unsigned int, record_t> map;
+	record_t rec = { 0 };
+	for (unsigned int i = 1; i <= 500; i++) {
+		map.insert(i, &rec);
+	}
+	unsigned int capacity = map.capacity();
+	map.clear();
+	CHECK(map.size() == 0);
+	CHECK(map.capacity() == capacity);
+	CHECK(map.find(7) == 0);
+	CHECK(map.insert(7, &rec));
+	CHECK(map.find(7) == &rec);
+}
+
+static void test_for_each(void) {
+	ptr_hashmap<unsigned int, record_t> map;
+	std::vector<record_t> records(300);
+	for (unsigned int i = 0; i < records.size(); i++) {
+		records[i].key = i + 1;
+		map.insert(i + 1, &records[i]);
+	}
+	unsigned long long keySum = 0;
+	unsigned int numVisited = 0;
+	map.for_each([&](unsigned int key, record_t *pRec) {
+		CHECK(pRec->key == key);
+		keySum += key;
+		numVisited++;
+	});
+	CHECK(numVisited == records.size());
+	CHECK(keySum == (300ULL * 301ULL) / 2);
+}
+
+//Random inserts and removes checked against std::unordered_map
+//Keys are drawn from a small range so probe runs collide and wrap, which exercises the backward shift
+static void test_random_against_reference(void) {
+	ptr_hashmap<unsigned long long, record_t> map;
+	std::unordered_map<unsigned long long, record_t *> ref;
+	std::vector<record_t> records(2048);
+	for (unsigned int i = 0; i < records.size(); i++) {
+		records[i].key = i;
+	}
+
+	test_rng rng(12345);
+	for (unsigned int op = 0; op < 200000; op++) {
+		unsigned int idx = rng.below((unsigned int)records.size());
+		unsigned long long key = (unsigned long long)idx << 32;
+		switch (rng.below(3)) {
+		case 0: {
+			bool inserted = map.insert(key, &records[idx]);
+			bool refInserted = ref.insert(std::make_pair(key, &records[idx])).second;
+			CHECK(inserted == refInserted);
+			break;
+		}
+		case 1: {
+			auto it = ref.find(key);
+			record_t *pExpected = (it != ref.end()) ? it->second : 0;
+			CHECK(map.remove(key) == pExpected);
+			if (it != ref.end()) {
+				ref.erase(it);
+			}
+			break;
+		}
+		default: {
+			auto it = ref.find(key);
+			record_t *pExpected = (it != ref.end()) ? it->second : 0;
+			CHECK(map.find(key) == pExpected);
+		}
+		}
+		if (g_numFailed) {
+			return;
+		}
+	}
+	CHECK(map.size() == ref.size());
+	for (const auto &entry : ref) {
+		CHECK(map.find(entry.first) == entry.second);
+	}
+}
+
+int main() {
+	RUN_TEST(test_empty);
+	RUN_TEST(test_insert_find_remove);
+	RUN_TEST(test_grow);
+	RUN_TEST(test_clear_keeps_capacity);
+	RUN_TEST(test_for_each);
+	RUN_TEST(test_random_against_reference);
+	return TEST_EXIT_CODE();
+}
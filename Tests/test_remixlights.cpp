@@ -0,0 +1,280 @@
+#include "test_common.h"
+#include "remixapi_stub.h"
+#include "D3D9LightSlots.h"
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+//Light actors and the state each one is drawn with this frame
+struct scene_t {
+	std::vector<AActor> actors;
+	std::unordered_map<AActor *, LightSlots::LightState> states;
+
+	explicit scene_t(unsigned int numActors) : actors(numActors) {
+		for (unsigned int i = 0; i < numActors; i++) {
+			LightSlots::LightState state = {};
+			state.location = FVector((FLOAT)i * 64.0f, 0.0f, 128.0f);
+			state.brightness = 64;
+			state.radius = 32;
+			state.type = LT_Steady;
+			state.clusterScale = 1.0f;
+			states[&actors[i]] = state;
+		}
+	}
+	std::vector<AActor *> pick(const std::vector<unsigned int> &indices) {
+		std::vector<AActor *> lights;
+		for (unsigned int index : indices) {
+			lights.push_back(&actors[index]);
+		}
+		return lights;
+	}
+};
+
+//A frame of UD3D9RenderDevice::renderLights, the light hash is the actor so handles can be traced back to it
+static remixapi_ErrorCode render_frame(LightSlots &slots, const remixapi_Interface &remix, scene_t &scene, const std::vector<AActor *> &lights) {
+	g_remixStub.end_frame();
+	slots.updateActors(lights);
+	return slots.submitRemixLights(remix,
+		[&scene](AActor *pActor) {
+			return scene.states[pActor];
+		},
+		[](AActor *pActor, const LightSlots::LightState &state, remixapi_LightInfoSphereEXT &sphereInfo, remixapi_LightInfo &lightInfo) {
+			CHECK(lightInfo.pNext == &sphereInfo);
+			sphereInfo.position = remixapi_Float3D{ state.location.X, state.location.Y, state.location.Z };
+			sphereInfo.radius = state.radius;
+			lightInfo.hash = (uint64_t)(uintptr_t)pActor;
+		}
+	);
+}
+
+static remixapi_LightHandle handle_of(LightSlots &slots, AActor *pActor) {
+	for (int slot : slots.activeSlots()) {
+		if (slots.getSlot(slot).actor == pActor) {
+			return slots.getSlot(slot).remixHandle;
+		}
+	}
+	return nullptr;
+}
+
+//Every light in the list has a live handle of its own that was drawn once this frame
+static void check_frame(LightSlots &slots, const std::vector<AActor *> &lights) {
+	CHECK(g_remixStub.numBadCalls == 0);
+	CHECK(g_remixStub.lights.size() == lights.size());
+	CHECK(g_remixStub.drawnLights.size() == lights.size());
+	std::set<remixapi_LightHandle> drawn(g_remixStub.drawnLights.begin(), g_remixStub.drawnLights.end());
+	CHECK(drawn.size() == lights.size());
+	for (AActor *pActor : lights) {
+		remixapi_LightHandle handle = handle_of(slots, pActor);
+		CHECK(handle != nullptr);
+		CHECK(drawn.count(handle) == 1);
+		auto it = g_remixStub.lights.find(handle);
+		CHECK(it != g_remixStub.lights.end() && it->second == (uint64_t)(uintptr_t)pActor);
+	}
+}
+
+static void test_create_and_keep(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(3);
+	std::vector<AActor *> lights = scene.pick({ 0, 1, 2 });
+
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+	CHECK(g_remixStub.numLightsCreated == 3);
+	remixapi_LightHandle handle = handle_of(slots, lights[1]);
+
+	//Steady lights that didn't change keep their handles and are only drawn again
+	for (unsigned int frame = 0; frame < 10; frame++) {
+		render_frame(slots, remix, scene, lights);
+		check_frame(slots, lights);
+	}
+	CHECK(g_remixStub.numLightsCreated == 3);
+	CHECK(g_remixStub.numLightsDestroyed == 0);
+	CHECK(handle_of(slots, lights[1]) == handle);
+}
+
+static void test_removed_and_added(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(4);
+	render_frame(slots, remix, scene, scene.pick({ 0, 1, 2 }));
+	remixapi_LightHandle handle0 = handle_of(slots, &scene.actors[0]);
+	remixapi_LightHandle handle1 = handle_of(slots, &scene.actors[1]);
+
+	//A light that leaves has its handle destroyed
+	std::vector<AActor *> lights = scene.pick({ 0, 2 });
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+	CHECK(g_remixStub.numLightsDestroyed == 1);
+	CHECK(g_remixStub.lights.count(handle1) == 0);
+	CHECK(handle_of(slots, &scene.actors[0]) == handle0);
+
+	//One leaving and one joining in the same frame, the new light takes the freed slot
+	render_frame(slots, remix, scene, scene.pick({ 0, 1, 2 }));
+	lights = scene.pick({ 0, 1, 3 });
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+	CHECK(g_remixStub.numLightsCreated == 5);
+	CHECK(g_remixStub.numLightsDestroyed == 2);
+
+	//Everything leaves
+	render_frame(slots, remix, scene, std::vector<AActor *>());
+	check_frame(slots, std::vector<AActor *>());
+	CHECK(g_remixStub.numLightsDestroyed == 5);
+}
+
+static void test_changed_lights(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(3);
+	std::vector<AActor *> lights = scene.pick({ 0, 1, 2 });
+	render_frame(slots, remix, scene, lights);
+	remixapi_LightHandle handle0 = handle_of(slots, lights[0]);
+	remixapi_LightHandle handle1 = handle_of(slots, lights[1]);
+
+	//Remix lights can't be changed, a moved light gets a new handle in place of the old one
+	scene.states[lights[1]].location.Z += 16.0f;
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+	CHECK(handle_of(slots, lights[0]) == handle0);
+	CHECK(handle_of(slots, lights[1]) != handle1);
+	CHECK(g_remixStub.lights.count(handle1) == 0);
+	CHECK(g_remixStub.numLightsCreated == 4);
+	CHECK(g_remixStub.numLightsDestroyed == 1);
+
+	//Anything but a steady light is animated, so it is sent again every frame
+	scene.states[lights[2]].type = LT_Pulse;
+	for (unsigned int frame = 0; frame < 5; frame++) {
+		render_frame(slots, remix, scene, lights);
+		check_frame(slots, lights);
+	}
+	CHECK(g_remixStub.numLightsCreated == 9);
+	CHECK(g_remixStub.numLightsDestroyed == 6);
+	CHECK(handle_of(slots, lights[0]) == handle0);
+
+	//Invalidating sends every light again without leaking the old handles
+	scene.states[lights[2]].type = LT_Steady;
+	render_frame(slots, remix, scene, lights);
+	unsigned int numCreated = g_remixStub.numLightsCreated;
+	slots.invalidate();
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+	CHECK(g_remixStub.numLightsCreated == numCreated + 3);
+	CHECK(handle_of(slots, lights[0]) != handle0);
+}
+
+static void test_create_failure(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(2);
+	std::vector<AActor *> lights = scene.pick({ 0, 1 });
+
+	//Lights that couldn't be created are not drawn, and are tried again next frame
+	g_remixStub.failCreateLight = true;
+	CHECK(render_frame(slots, remix, scene, lights) == REMIXAPI_ERROR_CODE_GENERAL_FAILURE);
+	CHECK(g_remixStub.numBadCalls == 0);
+	CHECK(g_remixStub.lights.empty());
+	CHECK(g_remixStub.drawnLights.empty());
+	CHECK(handle_of(slots, lights[0]) == nullptr);
+
+	g_remixStub.failCreateLight = false;
+	CHECK(render_frame(slots, remix, scene, lights) == REMIXAPI_ERROR_CODE_SUCCESS);
+	check_frame(slots, lights);
+
+	//A failed replacement leaves no handle behind either
+	scene.states[lights[0]].brightness = 200;
+	g_remixStub.failCreateLight = true;
+	render_frame(slots, remix, scene, lights);
+	CHECK(g_remixStub.numBadCalls == 0);
+	CHECK(g_remixStub.lights.size() == 1);
+	CHECK(handle_of(slots, lights[0]) == nullptr);
+	g_remixStub.failCreateLight = false;
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+}
+
+static void test_destroy_all(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(5);
+	render_frame(slots, remix, scene, scene.pick({ 0, 1, 2, 3, 4 }));
+	slots.destroyRemixLights(remix);
+	CHECK(g_remixStub.lights.empty());
+	CHECK(g_remixStub.numLightsDestroyed == 5);
+	CHECK(slots.activeSlots().empty());
+
+	//Nothing is destroyed twice, and the slots can be filled again
+	slots.destroyRemixLights(remix);
+	CHECK(g_remixStub.numBadCalls == 0);
+	std::vector<AActor *> lights = scene.pick({ 3, 4 });
+	render_frame(slots, remix, scene, lights);
+	check_frame(slots, lights);
+}
+
+//Random light lists from frame to frame, like lights coming in and out of view
+static void test_random_frames(void) {
+	remixapi_Interface remix = make_remix_stub();
+	LightSlots slots(0xFFFFFFFF);
+	scene_t scene(200);
+	test_rng rng(45);
+	std::vector<unsigned int> visible;
+	std::unordered_map<AActor *, remixapi_LightHandle> lastHandles;
+	for (unsigned int frame = 0; frame < 500; frame++) {
+		//Some lights leave, some join and a few move
+		std::vector<unsigned int> next;
+		for (unsigned int index : visible) {
+			if (rng.below(10) != 0) {
+				next.push_back(index);
+			}
+		}
+		unsigned int numJoining = rng.below(12);
+		for (unsigned int i = 0; i < numJoining; i++) {
+			unsigned int index = rng.below((unsigned int)scene.actors.size());
+			if (std::find(next.begin(), next.end(), index) == next.end()) {
+				next.push_back(index);
+			}
+		}
+		std::set<AActor *> moved;
+		for (unsigned int index : next) {
+			if (rng.below(20) == 0) {
+				scene.states[&scene.actors[index]].location.X += 1.0f;
+				moved.insert(&scene.actors[index]);
+			}
+		}
+		visible = next;
+
+		std::vector<AActor *> lights = scene.pick(visible);
+		render_frame(slots, remix, scene, lights);
+		check_frame(slots, lights);
+
+		//Lights that stayed and didn't move kept their handle
+		std::unordered_map<AActor *, remixapi_LightHandle> handles;
+		for (AActor *pActor : lights) {
+			handles[pActor] = handle_of(slots, pActor);
+			auto it = lastHandles.find(pActor);
+			if (it != lastHandles.end() && moved.count(pActor) == 0) {
+				CHECK(it->second == handles[pActor]);
+			}
+		}
+		lastHandles = handles;
+		if (g_numFailed) {
+			return;
+		}
+	}
+	slots.destroyRemixLights(remix);
+	CHECK(g_remixStub.lights.empty());
+	CHECK(g_remixStub.numLightsCreated == g_remixStub.numLightsDestroyed);
+	CHECK(g_remixStub.numBadCalls == 0);
+}
+
+int main() {
+	RUN_TEST(test_create_and_keep);
+	RUN_TEST(test_removed_and_added);
+	RUN_TEST(test_changed_lights);
+	RUN_TEST(test_create_failure);
+	RUN_TEST(test_destroy_all);
+	RUN_TEST(test_random_frames);
+	return TEST_EXIT_CODE();
+}
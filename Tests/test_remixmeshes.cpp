@@ -0,0 +1,205 @@
+#include "test_common.h"
+#include "remixapi_stub.h"
+#include "D3D9RemixLevelMeshes.h"
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+//The triangles of a bucket of quads, fanned from the first point as createRemixLevelMesh does
+struct bucket_t {
+	std::vector<remixapi_HardcodedVertex> vertices;
+	std::vector<uint32_t> indices;
+
+	explicit bucket_t(unsigned int numQuads) {
+		for (unsigned int quad = 0; quad < numQuads; quad++) {
+			uint32_t hubIndex = (uint32_t)vertices.size();
+			for (unsigned int i = 0; i < 4; i++) {
+				remixapi_HardcodedVertex vert = {};
+				vert.position[0] = (float)(quad * 128 + ((i == 1 || i == 2) ? 128 : 0));
+				vert.position[1] = (float)((i >= 2) ? 128 : 0);
+				vert.normal[2] = 1.0f;
+				vert.color = 0xFFFFFFFF;
+				vertices.push_back(vert);
+			}
+			for (uint32_t i = 2; i < 4; i++) {
+				indices.push_back(hubIndex);
+				indices.push_back(hubIndex + i - 1);
+				indices.push_back(hubIndex + i);
+			}
+		}
+	}
+};
+
+static remixapi_MaterialHandle make_material(const remixapi_Interface &remix, uint64_t hash) {
+	remixapi_MaterialInfo materialInfo = {};
+	materialInfo.sType = REMIXAPI_STRUCT_TYPE_MATERIAL_INFO;
+	materialInfo.hash = hash;
+	remixapi_MaterialHandle handle = nullptr;
+	CHECK(remix.CreateMaterial(&materialInfo, &handle) == REMIXAPI_ERROR_CODE_SUCCESS);
+	return handle;
+}
+
+//Meshes drawn since the last end_frame, checking each instance is drawn as world space level geometry
+static std::multiset<remixapi_MeshHandle> drawn_meshes(void) {
+	std::multiset<remixapi_MeshHandle> meshes;
+	for (const remixapi_InstanceInfo &instance : g_remixStub.drawnInstances) {
+		const float (*matrix)[4] = instance.transform.matrix;
+		for (int row = 0; row < 3; row++) {
+			for (int col = 0; col < 4; col++) {
+				CHECK(matrix[row][col] == ((row == col) ? 1.0f : 0.0f));
+			}
+		}
+		CHECK(instance.doubleSided);
+		meshes.insert(instance.mesh);
+	}
+	return meshes;
+}
+
+static void test_register_buckets(void) {
+	remixapi_Interface remix = make_remix_stub();
+	RemixLevelMeshes levelMeshes;
+	remixapi_MaterialHandle material = make_material(remix, 7);
+	bucket_t bucket(5);
+
+	for (int zone = 0; zone < FBspNode::MAX_ZONES; zone++) {
+		CHECK(levelMeshes.empty((BYTE)zone));
+	}
+	CHECK(levelMeshes.add(remix, 3, 0x1234, bucket.vertices, bucket.indices, material, 0xE0, REMIX_MATERIAL_MASKED) == REMIXAPI_ERROR_CODE_SUCCESS);
+	CHECK(g_remixStub.numBadCalls == 0);
+	CHECK(g_remixStub.numMeshesCreated == 1);
+	CHECK(!levelMeshes.empty(3));
+	CHECK(levelMeshes.empty(2));
+
+	//The mesh holds the bucket's triangles and material under the hash it was given
+	const RemixLevelMeshes::LevelMesh &levelMesh = levelMeshes.getMeshes(3)[0];
+	auto it = g_remixStub.meshes.find(levelMesh.mesh);
+	CHECK(it != g_remixStub.meshes.end());
+	if (it != g_remixStub.meshes.end()) {
+		CHECK(it->second.hash == 0x1234);
+		CHECK(it->second.material == material);
+		CHECK(it->second.numVertices == 20);
+		CHECK(it->second.numIndices == 30);
+	}
+	CHECK(levelMesh.materialCacheID == 0xE0);
+	CHECK(levelMesh.materialClass == REMIX_MATERIAL_MASKED);
+
+	//Registering doesn't draw anything
+	CHECK(g_remixStub.drawnInstances.empty());
+}
+
+static void test_draw_zones(void) {
+	remixapi_Interface remix = make_remix_stub();
+	RemixLevelMeshes levelMeshes;
+	remixapi_MaterialHandle materials[2] = { make_material(remix, 1), make_material(remix, 2) };
+	const BYTE zones[] = { 0, 5, 5, 5, 17, FBspNode::MAX_ZONES - 1 };
+	for (unsigned int i = 0; i < sizeof(zones); i++) {
+		bucket_t bucket(i + 1);
+		CHECK(levelMeshes.add(remix, zones[i], i, bucket.vertices, bucket.indices, materials[i & 1], i, REMIX_MATERIAL_OPAQUE) == REMIXAPI_ERROR_CODE_SUCCESS);
+	}
+	CHECK(levelMeshes.getMeshes(5).size() == 3);
+
+	//Each zone draws exactly its own meshes
+	for (int zone = 0; zone < FBspNode::MAX_ZONES; zone++) {
+		g_remixStub.end_frame();
+		levelMeshes.draw(remix, (BYTE)zone);
+		std::multiset<remixapi_MeshHandle> drawn = drawn_meshes();
+		std::multiset<remixapi_MeshHandle> expected;
+		for (const RemixLevelMeshes::LevelMesh &levelMesh : levelMeshes.getMeshes((BYTE)zone)) {
+			expected.insert(levelMesh.mesh);
+		}
+		CHECK(drawn == expected);
+	}
+
+	//Frames draw the visible zones again every time, nothing is created or destroyed
+	for (unsigned int frame = 0; frame < 10; frame++) {
+		g_remixStub.end_frame();
+		for (BYTE zone : { 5, 17 }) {
+			if (!levelMeshes.empty(zone)) {
+				levelMeshes.draw(remix, zone);
+			}
+		}
+		std::multiset<remixapi_MeshHandle> drawn = drawn_meshes();
+		CHECK(drawn.size() == 4);
+		CHECK(std::set<remixapi_MeshHandle>(drawn.begin(), drawn.end()).size() == 4);
+	}
+	CHECK(g_remixStub.numMeshesCreated == sizeof(zones));
+	CHECK(g_remixStub.numMeshesDestroyed == 0);
+	CHECK(g_remixStub.numBadCalls == 0);
+}
+
+static void test_create_failure(void) {
+	remixapi_Interface remix = make_remix_stub();
+	RemixLevelMeshes levelMeshes;
+	remixapi_MaterialHandle material = make_material(remix, 1);
+	bucket_t bucket(2);
+
+	//A mesh Remix didn't create is not kept, so the zone goes through D3D
+	g_remixStub.failCreateMesh = true;
+	CHECK(levelMeshes.add(remix, 4, 1, bucket.vertices, bucket.indices, material, 1, REMIX_MATERIAL_OPAQUE) == REMIXAPI_ERROR_CODE_GENERAL_FAILURE);
+	CHECK(levelMeshes.empty(4));
+	levelMeshes.draw(remix, 4);
+	CHECK(g_remixStub.drawnInstances.empty());
+
+	g_remixStub.failCreateMesh = false;
+	CHECK(levelMeshes.add(remix, 4, 1, bucket.vertices, bucket.indices, material, 1, REMIX_MATERIAL_OPAQUE) == REMIXAPI_ERROR_CODE_SUCCESS);
+	levelMeshes.draw(remix, 4);
+	CHECK(g_remixStub.drawnInstances.size() == 1);
+	CHECK(g_remixStub.numBadCalls == 0);
+}
+
+static void test_destroy_all(void) {
+	remixapi_Interface remix = make_remix_stub();
+	RemixLevelMeshes levelMeshes;
+	remixapi_MaterialHandle materials[3] = { make_material(remix, 1), make_material(remix, 2), make_material(remix, 3) };
+	std::map<std::pair<QWORD, int>, unsigned int> expectedReleases;
+	for (unsigned int i = 0; i < 12; i++) {
+		bucket_t bucket(3);
+		RemixMaterialClass materialClass = (RemixMaterialClass)(i % REMIX_MATERIAL_CLASS_MAX);
+		CHECK(levelMeshes.add(remix, (BYTE)(i % 4), i, bucket.vertices, bucket.indices, materials[i % 3], i % 3, materialClass) == REMIXAPI_ERROR_CODE_SUCCESS);
+		expectedReleases[std::make_pair((QWORD)(i % 3), (int)materialClass)]++;
+	}
+
+	//Each mesh is gone before its reference to the material is given back
+	std::map<std::pair<QWORD, int>, unsigned int> releases;
+	unsigned int materialRefs[3] = { 4, 4, 4 };
+	levelMeshes.destroyAll(remix, [&](QWORD cacheID, RemixMaterialClass materialClass) {
+		releases[std::make_pair(cacheID, (int)materialClass)]++;
+		materialRefs[cacheID]--;
+		unsigned int numLive = 0;
+		for (const auto &entry : g_remixStub.meshes) {
+			numLive += (entry.second.material == materials[cacheID]) ? 1 : 0;
+		}
+		CHECK(numLive == materialRefs[cacheID]);
+	});
+	CHECK(releases == expectedReleases);
+	CHECK(g_remixStub.meshes.empty());
+	CHECK(g_remixStub.numMeshesDestroyed == 12);
+	for (int zone = 0; zone < FBspNode::MAX_ZONES; zone++) {
+		CHECK(levelMeshes.empty((BYTE)zone));
+	}
+
+	//The materials can then be destroyed, and the next level registers from scratch
+	for (remixapi_MaterialHandle material : materials) {
+		remix.DestroyMaterial(material);
+	}
+	levelMeshes.destroyAll(remix, [](QWORD, RemixMaterialClass) {
+		CHECK(false);
+	});
+	remixapi_MaterialHandle material = make_material(remix, 4);
+	bucket_t bucket(1);
+	CHECK(levelMeshes.add(remix, 2, 99, bucket.vertices, bucket.indices, material, 4, REMIX_MATERIAL_UNLIT) == REMIXAPI_ERROR_CODE_SUCCESS);
+	g_remixStub.end_frame();
+	levelMeshes.draw(remix, 2);
+	CHECK(g_remixStub.drawnInstances.size() == 1);
+	CHECK(g_remixStub.numBadCalls == 0);
+}
+
+int main() {
+	RUN_TEST(test_register_buckets);
+	RUN_TEST(test_draw_zones);
+	RUN_TEST(test_create_failure);
+	RUN_TEST(test_destroy_all);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,90 @@
+#include "test_common.h"
+#include "rtxanchor_scene.h"
+
+static bool all_match(const anchor_scene_t &scene) {
+	if (scene.anchors.size() != scene.refAnchors.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < scene.anchors.size(); i++) {
+		if (!scene.matches(i)) {
+			fprintf(stderr, "Anchor %u differs from the old classes\n", (unsigned int)i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_path_ends(void) {
+	RTXAnchors anchors;
+	FVector zero(0.0f, 0.0f, 0.0f);
+	FVector one(1.0f, 1.0f, 1.0f);
+	anchors.addPath("Linear", zero, zero, one, zero, false, FVector(100.0f, 0.0f, 0.0f), 50.0f, false);
+	anchors.addPath("PingPong", zero, zero, one, zero, false, FVector(100.0f, 0.0f, 0.0f), 50.0f, true);
+	CHECK(anchors.size() == 2);
+	CHECK(anchors.getLocation(1) == zero);
+
+	anchors.tick(1.0f, false);
+	CHECK(anchors.getLocation(0) == FVector(50.0f, 0.0f, 0.0f));
+	CHECK(anchors.getLocation(1) == FVector(50.0f, 0.0f, 0.0f));
+
+	//Past the end linear paths jump back to the start, ping-pong ones turn around
+	anchors.tick(1.5f, false);
+	CHECK(anchors.getLocation(0) == FVector(25.0f, 0.0f, 0.0f));
+	CHECK(anchors.getLocation(1) == FVector(75.0f, 0.0f, 0.0f));
+	anchors.tick(2.0f, false);
+	CHECK(anchors.getLocation(0) == FVector(25.0f, 0.0f, 0.0f));
+	CHECK(anchors.getLocation(1) == FVector(25.0f, 0.0f, 0.0f));
+
+	anchors.clear();
+	CHECK(anchors.size() == 0);
+}
+
+static void test_rotation_wrap(void) {
+	RTXAnchors anchors;
+	FVector zero(0.0f, 0.0f, 0.0f);
+	anchors.addStatic("Spinner", zero, FVector(350.0f, 10.0f, 0.0f), FVector(1.0f, 1.0f, 1.0f), FVector(20.0f, -20.0f, 0.0f), true);
+	anchors.tick(1.0f, false);
+	CHECK(anchors.getRotation(0) == FVector(10.0f, 350.0f, 0.0f));
+
+	//Paused pausable anchors don't move
+	anchors.tick(1.0f, true);
+	CHECK(anchors.getRotation(0) == FVector(10.0f, 350.0f, 0.0f));
+}
+
+//The arrays tick exactly as the old RTXAnchor, RTXAnchorLinear and RTXAnchorPingPong did
+static void test_matches_old_classes(void) {
+	anchor_scene_t scene;
+	test_rng rng(49);
+	scene.add_random(rng, 3000);
+	//Start and end in the same place
+	FVector loc(10.0f, 20.0f, 30.0f);
+	FVector one(1.0f, 1.0f, 1.0f);
+	scene.anchors.addPath("Still", loc, loc, one, one, false, loc, 10.0f, true);
+	scene.refAnchors.emplace_back(new reference::RTXAnchorPingPong("Still", loc, loc, one, one, false, loc, 10.0f));
+	CHECK(all_match(scene));
+
+	for (unsigned int frame = 0; frame < 2000; frame++) {
+		float deltaTime = (float)(rng.below(50) + 1) / 1000.0f;
+		bool paused = rng.below(10) == 0;
+		scene.anchors.tick(deltaTime, paused);
+		scene.tick_reference(deltaTime, paused);
+		if (!all_match(scene)) {
+			CHECK(false);
+			return;
+		}
+	}
+
+	//Long frames wrap paths several times over
+	for (unsigned int frame = 0; frame < 20; frame++) {
+		scene.anchors.tick(37.5f, false);
+		scene.tick_reference(37.5f, false);
+	}
+	CHECK(all_match(scene));
+}
+
+int main() {
+	RUN_TEST(test_path_ends);
+	RUN_TEST(test_rotation_wrap);
+	RUN_TEST(test_matches_old_classes);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,147 @@
+#include "test_common.h"
+#include "c_slaballoc.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+struct record_t {
+	unsigned long long key;
+	double value;
+	void *pNext;
+};
+
+typedef slab_allocator<record_t, 16> allocator_t;
+
+static void test_counts(void) {
+	allocator_t allocator;
+	CHECK(allocator.allocated() == 0);
+	CHECK(allocator.used() == 0);
+	CHECK(allocator.peak() == 0);
+
+	record_t *pA = allocator.alloc();
+	CHECK(pA != 0);
+	CHECK(allocator.allocated() == 16);
+	CHECK(allocator.used() == 1);
+	CHECK(allocator.peak() == 1);
+
+	record_t *pB = allocator.alloc();
+	CHECK(pB != pA);
+	CHECK(allocator.used() == 2);
+	CHECK(allocator.peak() == 2);
+
+	allocator.free(pA);
+	CHECK(allocator.used() == 1);
+	CHECK(allocator.peak() == 2);
+	allocator.free(pB);
+	CHECK(allocator.used() == 0);
+	CHECK(allocator.peak() == 2);
+	//Slabs are kept until release_all
+	CHECK(allocator.allocated() == 16);
+}
+
+static void test_new_slabs(void) {
+	allocator_t allocator;
+	std::vector<record_t *> records;
+	for (unsigned int i = 0; i < 40; i++) {
+		records.push_back(allocator.alloc());
+	}
+	CHECK(allocator.allocated() == 48);
+	CHECK(allocator.used() == 40);
+
+	//Every record is distinct, aligned and writable
+	std::set<record_t *> unique(records.begin(), records.end());
+	CHECK(unique.size() == records.size());
+	for (unsigned int i = 0; i < records.size(); i++) {
+		CHECK(((uintptr_t)records[i] % alignof(record_t)) == 0);
+		records[i]->key = i;
+		records[i]->value = i * 0.5;
+		records[i]->pNext = records[i];
+	}
+	for (unsigned int i = 0; i < records.size(); i++) {
+		CHECK(records[i]->key == i);
+		CHECK(records[i]->value == i * 0.5);
+		CHECK(records[i]->pNext == records[i]);
+	}
+}
+
+static void test_free_list_reuse(void) {
+	allocator_t allocator;
+	std::vector<record_t *> records;
+	for (unsigned int i = 0; i < 16; i++) {
+		records.push_back(allocator.alloc());
+	}
+	allocator.free(records[3]);
+	allocator.free(records[9]);
+
+	//Freed records come back last in first out before any new slab is started
+	CHECK(allocator.alloc() == records[9]);
+	CHECK(allocator.alloc() == records[3]);
+	CHECK(allocator.allocated() == 16);
+
+	record_t *pNew = allocator.alloc();
+	CHECK(allocator.allocated() == 32);
+	CHECK(std::find(records.begin(), records.end(), pNew) == records.end());
+	CHECK(allocator.used() == 17);
+	CHECK(allocator.peak() == 17);
+}
+
+static void test_release_all(void) {
+	allocator_t allocator;
+	for (unsigned int i = 0; i < 50; i++) {
+		allocator.alloc();
+	}
+	CHECK(allocator.peak() == 50);
+	allocator.release_all();
+	CHECK(allocator.allocated() == 0);
+	CHECK(allocator.used() == 0);
+	//The peak is kept across releases
+	CHECK(allocator.peak() == 50);
+
+	//The allocator is usable again afterwards
+	record_t *pRec = allocator.alloc();
+	CHECK(pRec != 0);
+	pRec->key = 1;
+	CHECK(allocator.allocated() == 16);
+	CHECK(allocator.used() == 1);
+	CHECK(allocator.peak() == 50);
+}
+
+static void test_random_churn(void) {
+	allocator_t allocator;
+	std::vector<record_t *> live;
+	test_rng rng(99);
+	unsigned int peak = 0;
+	for (unsigned int op = 0; op < 100000; op++) {
+		if (live.empty() || rng.below(3) != 0) {
+			record_t *pRec = allocator.alloc();
+			pRec->key = (unsigned long long)(uintptr_t)pRec;
+			live.push_back(pRec);
+		}
+		else {
+			unsigned int idx = rng.below((unsigned int)live.size());
+			//Nothing else wrote over the record while it was handed out
+			CHECK(live[idx]->key == (unsigned long long)(uintptr_t)live[idx]);
+			allocator.free(live[idx]);
+			live[idx] = live.back();
+			live.pop_back();
+		}
+		if (live.size() > peak) {
+			peak = (unsigned int)live.size();
+		}
+	}
+	CHECK(allocator.used() == live.size());
+	CHECK(allocator.peak() == peak);
+	//Slabs are only added when the free list is empty
+	CHECK(allocator.allocated() == ((peak + 15) / 16) * 16);
+}
+
+int main() {
+	RUN_TEST(test_counts);
+	RUN_TEST(test_new_slabs);
+	RUN_TEST(test_free_list_reuse);
+	RUN_TEST(test_release_all);
+	RUN_TEST(test_random_churn);
+	return TEST_EXIT_CODE();
+}
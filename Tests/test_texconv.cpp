@@ -0,0 +1,131 @@
+#include "test_common.h"
+#include "c_texconv.h"
+
+#include <vector>
+
+//Every SIMD level the CPU supports must give the same bits as the scalar procs
+//Counts cover the vector loops and every tail length, offsets cover unaligned rows
+
+enum {
+	MAX_COUNT = 4096 + 37,
+	MAX_OFFSET = 3
+};
+
+static std::vector<unsigned int> make_texels(unsigned int num, unsigned long long seed) {
+	test_rng rng(seed);
+	std::vector<unsigned int> texels(num);
+	for (unsigned int u = 0; u < num; u++) {
+		texels[u] = rng.next() ^ (rng.next() << 16);
+	}
+	return texels;
+}
+
+static void check_pixel_proc(CTexConv::pixel_proc_t pProc, CTexConv::pixel_proc_t pRefProc) {
+	std::vector<unsigned int> src = make_texels(MAX_COUNT + MAX_OFFSET, 1);
+	std::vector<unsigned int> dst(MAX_COUNT + MAX_OFFSET + 1);
+	std::vector<unsigned int> ref(MAX_COUNT + MAX_OFFSET + 1);
+
+	for (unsigned int offset = 0; offset <= MAX_OFFSET; offset++) {
+		for (unsigned int count = 0; count < MAX_COUNT; count = (count < 80) ? (count + 1) : (count * 3 + 1)) {
+			//Guard value past the end checks nothing is written beyond count
+			dst.assign(dst.size(), 0xDEADBEEF);
+			ref.assign(ref.size(), 0xDEADBEEF);
+			pProc(&dst[offset], &src[offset], count);
+			pRefProc(&ref[offset], &src[offset], count);
+			CHECK(dst == ref);
+			if (dst != ref) {
+				return;
+			}
+		}
+	}
+}
+
+static void check_palette_proc(CTexConv::palette_proc_t pProc, CTexConv::palette_proc_t pRefProc) {
+	std::vector<unsigned int> palette = make_texels(256, 2);
+	test_rng rng(3);
+	std::vector<unsigned char> src(MAX_COUNT + MAX_OFFSET);
+	for (unsigned char &index : src) {
+		index = (unsigned char)rng.next();
+	}
+	std::vector<unsigned int> dst(MAX_COUNT + MAX_OFFSET + 1);
+	std::vector<unsigned int> ref(MAX_COUNT + MAX_OFFSET + 1);
+
+	for (unsigned int offset = 0; offset <= MAX_OFFSET; offset++) {
+		for (unsigned int count = 0; count < MAX_COUNT; count = (count < 80) ? (count + 1) : (count * 3 + 1)) {
+			dst.assign(dst.size(), 0xDEADBEEF);
+			ref.assign(ref.size(), 0xDEADBEEF);
+			pProc(&dst[0], &src[offset], &palette[0], count);
+			pRefProc(&ref[0], &src[offset], &palette[0], count);
+			CHECK(dst == ref);
+			if (dst != ref) {
+				return;
+			}
+		}
+	}
+}
+
+//The scalar procs against the formats they convert
+static void test_scalar_reference(void) {
+	CTexConv conv;
+	conv.set_simd_level(CTexConv::SIMD_NONE);
+	CHECK(conv.get_simd_level() == CTexConv::SIMD_NONE);
+
+	//BGRA7777 to BGRA8888 doubles each channel
+	unsigned int bgra7777[2] = { 0x7F7F7F7F, 0x01020340 };
+	unsigned int out[2];
+	conv.pShl1(out, bgra7777, 2);
+	CHECK(out[0] == 0xFEFEFEFE);
+	CHECK(out[1] == 0x02040680);
+
+	//RGBA8 to BGRA8 swaps the red and blue bytes
+	unsigned int rgba8[2] = { 0x11223344, 0xAABBCCDD };
+	conv.pSwapRB(out, rgba8, 2);
+	CHECK(out[0] == 0x11443322);
+	CHECK(out[1] == 0xAADDCCBB);
+
+	conv.pCopy(out, rgba8, 2);
+	CHECK(out[0] == rgba8[0]);
+	CHECK(out[1] == rgba8[1]);
+
+	unsigned int palette[256];
+	for (unsigned int u = 0; u < 256; u++) {
+		palette[u] = u * 0x01010101;
+	}
+	unsigned char p8[2] = { 5, 250 };
+	conv.pPalette(out, p8, palette, 2);
+	CHECK(out[0] == 0x05050505);
+	CHECK(out[1] == 0xFAFAFAFA);
+}
+
+static void test_simd_levels_match_scalar(void) {
+	CTexConv scalar;
+	scalar.set_simd_level(CTexConv::SIMD_NONE);
+
+	CTexConv::simd_level_t detected = CTexConv::detect_simd_level();
+	printf("Detected SIMD level: %s\n", CTexConv::simd_level_name(detected));
+	for (int level = CTexConv::SIMD_SSE2; level <= detected; level++) {
+		CTexConv conv;
+		conv.set_simd_level((CTexConv::simd_level_t)level);
+		CHECK(conv.get_simd_level() == level);
+		printf("Checking %s\n", CTexConv::simd_level_name(conv.get_simd_level()));
+
+		check_pixel_proc(conv.pCopy, scalar.pCopy);
+		check_pixel_proc(conv.pShl1, scalar.pShl1);
+		check_pixel_proc(conv.pSwapRB, scalar.pSwapRB);
+		check_palette_proc(conv.pPalette, scalar.pPalette);
+	}
+}
+
+static void test_level_capped_to_cpu(void) {
+	CTexConv conv;
+	CHECK(conv.get_simd_level() == CTexConv::detect_simd_level());
+	conv.set_simd_level(CTexConv::SIMD_AVX2);
+	CHECK(conv.get_simd_level() <= CTexConv::detect_simd_level());
+}
+
+int main() {
+	RUN_TEST(test_scalar_reference);
+	RUN_TEST(test_simd_levels_match_scalar);
+	RUN_TEST(test_level_capped_to_cpu);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,250 @@
+#include "test_common.h"
+#include "c_texdiskcache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const char *g_fileName = "test_texdiskcache.bin";
+
+enum {
+	PACK_HEADER_SIZE = 16,
+	RECORD_HEADER_SIZE = 24,
+	MAX_FILE_SIZE = 1 << 20
+};
+
+static std::vector<unsigned char> make_data(unsigned int size, unsigned long long seed) {
+	test_rng rng(seed);
+	std::vector<unsigned char> data(size);
+	for (unsigned char &byte : data) {
+		byte = (unsigned char)rng.next();
+	}
+	return data;
+}
+
+static long file_size(void) {
+	FILE *pFile = fopen(g_fileName, "rb");
+	if (pFile == 0) {
+		return -1;
+	}
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fclose(pFile);
+	return size;
+}
+
+static void write_file_at(long offset, const void *pData, size_t size) {
+	FILE *pFile = fopen(g_fileName, "r+b");
+	CHECK(pFile != 0);
+	if (pFile == 0) {
+		return;
+	}
+	fseek(pFile, offset, SEEK_SET);
+	CHECK(fwrite(pData, size, 1, pFile) == 1);
+	fclose(pFile);
+}
+
+static bool record_matches(CTexDiskCache &cache, unsigned long long key, const std::vector<unsigned char> &data) {
+	const unsigned char *pData = cache.lock(key, (unsigned int)data.size());
+	bool matches = (pData != 0) && (data.empty() || (memcmp(pData, &data[0], data.size()) == 0));
+	cache.unlock();
+	return matches;
+}
+
+//Keys and sizes of the records most tests start from, sizes cover the padding to 16 bytes
+static const unsigned int g_sizes[] = { 1, 15, 16, 17, 100, 4096, 65536 + 3 };
+static const unsigned int NUM_RECORDS = sizeof(g_sizes) / sizeof(g_sizes[0]);
+
+static void write_records(CTexDiskCache &cache) {
+	for (unsigned int i = 0; i < NUM_RECORDS; i++) {
+		std::vector<unsigned char> data = make_data(g_sizes[i], i);
+		CHECK(cache.write(1000 + i, &data[0], g_sizes[i]));
+	}
+}
+
+static void check_records(CTexDiskCache &cache) {
+	CHECK(cache.num_records() == NUM_RECORDS);
+	for (unsigned int i = 0; i < NUM_RECORDS; i++) {
+		CHECK(cache.contains(1000 + i));
+		CHECK(record_matches(cache, 1000 + i, make_data(g_sizes[i], i)));
+	}
+}
+
+static void test_round_trip(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.is_open());
+	CHECK(cache.num_records() == 0);
+	CHECK(cache.file_size() == PACK_HEADER_SIZE);
+
+	write_records(cache);
+	check_records(cache);
+	unsigned long long writtenSize = cache.file_size();
+	CHECK((writtenSize % 16) == 0);
+	cache.close();
+	CHECK(!cache.is_open());
+	CHECK(file_size() == (long)writtenSize);
+
+	//Reopening rebuilds the same index from the record headers
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	check_records(cache);
+	CHECK(cache.file_size() == writtenSize);
+
+	//Records written after reopening go after the existing ones
+	std::vector<unsigned char> extra = make_data(300, 77);
+	CHECK(cache.write(77, &extra[0], 300));
+	cache.close();
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.num_records() == NUM_RECORDS + 1);
+	CHECK(record_matches(cache, 77, extra));
+	cache.close();
+}
+
+static void test_lookups(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	write_records(cache);
+
+	//Unknown keys and mismatched sizes miss
+	CHECK(!cache.contains(5));
+	CHECK(cache.lock(5, 16) == 0);
+	CHECK(cache.lock(1000, g_sizes[0] + 1) == 0);
+
+	//An existing key counts as written and is not replaced
+	unsigned long long sizeBefore = cache.file_size();
+	std::vector<unsigned char> other = make_data(g_sizes[0], 99);
+	CHECK(cache.write(1000, &other[0], g_sizes[0]));
+	CHECK(cache.file_size() == sizeBefore);
+	CHECK(record_matches(cache, 1000, make_data(g_sizes[0], 0)));
+	cache.close();
+}
+
+static void test_max_file_size(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, 4096));
+	std::vector<unsigned char> data = make_data(3000, 1);
+	CHECK(cache.write(1, &data[0], 3000));
+	CHECK(!cache.write(2, &data[0], 3000));
+	CHECK(cache.num_records() == 1);
+	CHECK(cache.file_size() <= 4096);
+	cache.close();
+}
+
+//Data written but the header not, the header slot is a hole of zeros
+static void test_torn_header_hole(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	write_records(cache);
+	long goodSize = (long)cache.file_size();
+	cache.close();
+
+	//Data that itself looks like record headers must not be picked up either
+	std::vector<unsigned char> tornData(256, 0);
+	for (unsigned int u = 0; u < tornData.size(); u += RECORD_HEADER_SIZE) {
+		tornData[u] = 0x44;
+		tornData[u + 1] = 0x54;
+		tornData[u + 2] = 0x43;
+		tornData[u + 3] = 0x52;
+	}
+	write_file_at(goodSize + RECORD_HEADER_SIZE, &tornData[0], tornData.size());
+	CHECK(file_size() > goodSize);
+
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	check_records(cache);
+	CHECK(cache.file_size() == (unsigned long long)goodSize);
+	CHECK(file_size() == goodSize);
+
+	//The cache carries on from the cut
+	std::vector<unsigned char> data = make_data(500, 5);
+	CHECK(cache.write(5, &data[0], 500));
+	cache.close();
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.num_records() == NUM_RECORDS + 1);
+	CHECK(record_matches(cache, 5, data));
+	cache.close();
+}
+
+//A header with the right magic but damaged fields fails its checksum
+static void test_damaged_header(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	write_records(cache);
+	long goodSize = (long)cache.file_size();
+	std::vector<unsigned char> data = make_data(64, 8);
+	CHECK(cache.write(8, &data[0], 64));
+	cache.close();
+
+	//Change the size field of the last record
+	unsigned int badSize = 16;
+	write_file_at(goodSize + 16, &badSize, sizeof(badSize));
+
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	check_records(cache);
+	CHECK(!cache.contains(8));
+	CHECK(file_size() == goodSize);
+	cache.close();
+}
+
+//Damaged record data is found by the data checksum when it is locked
+static void test_damaged_data(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	std::vector<unsigned char> data = make_data(64, 3);
+	CHECK(cache.write(3, &data[0], 64));
+	cache.close();
+
+	unsigned char flipped = (unsigned char)(data[10] ^ 0xFF);
+	write_file_at(PACK_HEADER_SIZE + RECORD_HEADER_SIZE + 10, &flipped, 1);
+
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.contains(3));
+	CHECK(cache.lock(3, 64) == 0);
+	CHECK(!cache.contains(3));
+	cache.close();
+}
+
+static void test_bad_pack_header(void) {
+	remove(g_fileName);
+	CTexDiskCache cache;
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	write_records(cache);
+	cache.close();
+
+	//Files from another version are started over
+	unsigned int oldVersion = 1;
+	write_file_at(4, &oldVersion, sizeof(oldVersion));
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.num_records() == 0);
+	CHECK(file_size() == PACK_HEADER_SIZE);
+	cache.close();
+
+	//As are files that aren't a pack at all
+	FILE *pFile = fopen(g_fileName, "wb");
+	fputs("not a texture cache", pFile);
+	fclose(pFile);
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	CHECK(cache.num_records() == 0);
+	write_records(cache);
+	cache.close();
+	CHECK(cache.open(g_fileName, MAX_FILE_SIZE));
+	check_records(cache);
+	cache.close();
+}
+
+int main() {
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_lookups);
+	RUN_TEST(test_max_file_size);
+	RUN_TEST(test_torn_header_hole);
+	RUN_TEST(test_damaged_header);
+	RUN_TEST(test_damaged_data);
+	RUN_TEST(test_bad_pack_header);
+	remove(g_fileName);
+	return TEST_EXIT_CODE();
+}
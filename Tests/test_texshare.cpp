@@ -0,0 +1,156 @@
+#include "test_common.h"
+#include "c_texshare.h"
+
+#include <vector>
+
+//Reference counted like a D3D texture object, with contents to check what each bind sees
+struct tex_obj_t {
+	unsigned int refCount;
+	std::vector<unsigned int> texels;
+
+	explicit tex_obj_t(unsigned int value) : refCount(1), texels(16, value) {
+	}
+	unsigned long AddRef(void) {
+		return ++refCount;
+	}
+	unsigned long Release(void) {
+		return --refCount;
+	}
+};
+
+typedef tex_share_map<tex_obj_t> share_map_t;
+
+//The parts of FCachedTexture the sharing works with
+struct bind_t {
+	unsigned long long contentHash;
+	tex_obj_t *pTexObj;
+};
+
+//New bind the way BindTexture and the upload do it, objects made here are kept in owned
+static bind_t new_bind(share_map_t &shareMap, std::vector<tex_obj_t *> &owned, unsigned long long hash, unsigned int value) {
+	bind_t bind;
+	bind.contentHash = hash;
+	bind.pTexObj = shareMap.acquire(hash);
+	if (!bind.pTexObj) {
+		bind.pTexObj = new tex_obj_t(value);
+		owned.push_back(bind.pTexObj);
+		if (!shareMap.publish(hash, bind.pTexObj)) {
+			bind.contentHash = 0;
+		}
+	}
+	return bind;
+}
+
+//A realtime change the way SetTextureNoCheck uploads it, a shared object is swapped for a new one first
+static void change_bind(share_map_t &shareMap, std::vector<tex_obj_t *> &owned, bind_t &bind, unsigned int value) {
+	unsigned long long hash = bind.contentHash;
+	bind.contentHash = 0;
+	if (hash && shareMap.release(hash, bind.pTexObj)) {
+		bind.pTexObj = new tex_obj_t(0);
+		owned.push_back(bind.pTexObj);
+	}
+	for (unsigned int &texel : bind.pTexObj->texels) {
+		texel = value;
+	}
+}
+
+static void free_all(std::vector<tex_obj_t *> &owned) {
+	for (tex_obj_t *pTexObj : owned) {
+		delete pTexObj;
+	}
+	owned.clear();
+}
+
+static void test_share(void) {
+	share_map_t shareMap;
+	std::vector<tex_obj_t *> owned;
+
+	bind_t a = new_bind(shareMap, owned, 0x10, 7);
+	CHECK(!shareMap.is_shared(a.contentHash, a.pTexObj));
+	bind_t b = new_bind(shareMap, owned, 0x10, 7);
+	CHECK(b.pTexObj == a.pTexObj);
+	CHECK(a.pTexObj->refCount == 2);
+	CHECK(shareMap.is_shared(0x10, a.pTexObj));
+	CHECK(owned.size() == 1);
+
+	//Different contents get their own object
+	bind_t c = new_bind(shareMap, owned, 0x20, 9);
+	CHECK(c.pTexObj != a.pTexObj);
+	CHECK(shareMap.size() == 2);
+
+	//An object that lost the race to publish stays private
+	tex_obj_t other(7);
+	CHECK(!shareMap.publish(0x10, &other));
+	CHECK(shareMap.publish(0x10, a.pTexObj));
+	free_all(owned);
+}
+
+static void test_change_shared(void) {
+	share_map_t shareMap;
+	std::vector<tex_obj_t *> owned;
+	bind_t a = new_bind(shareMap, owned, 0x10, 7);
+	bind_t b = new_bind(shareMap, owned, 0x10, 7);
+	tex_obj_t *pShared = a.pTexObj;
+
+	//Changing one of two sharing binds leaves the other one's contents alone
+	change_bind(shareMap, owned, a, 3);
+	CHECK(a.pTexObj != pShared);
+	CHECK(a.pTexObj->texels[0] == 3);
+	CHECK(b.pTexObj == pShared);
+	CHECK(b.pTexObj->texels[0] == 7);
+	CHECK(b.pTexObj->texels[15] == 7);
+	CHECK(pShared->refCount == 1);
+	CHECK(!shareMap.is_shared(0x10, pShared));
+
+	//The unchanged object can still be shared by new identical binds
+	bind_t c = new_bind(shareMap, owned, 0x10, 7);
+	CHECK(c.pTexObj == pShared);
+	CHECK(c.pTexObj->texels[0] == 7);
+
+	//The last user of an object writes to it in place, and identical binds no longer find it
+	change_bind(shareMap, owned, c, 4);
+	CHECK(c.pTexObj != pShared);
+	change_bind(shareMap, owned, b, 5);
+	CHECK(b.pTexObj == pShared);
+	CHECK(pShared->refCount == 1);
+	CHECK(shareMap.size() == 0);
+	bind_t d = new_bind(shareMap, owned, 0x10, 7);
+	CHECK(d.pTexObj != pShared);
+	CHECK(d.pTexObj->texels[0] == 7);
+	CHECK(a.pTexObj->texels[0] == 3);
+	CHECK(c.pTexObj->texels[0] == 4);
+	free_all(owned);
+}
+
+static void test_release(void) {
+	share_map_t shareMap;
+	std::vector<tex_obj_t *> owned;
+	bind_t binds[3];
+	for (bind_t &bind : binds) {
+		bind = new_bind(shareMap, owned, 0x30, 1);
+	}
+	tex_obj_t *pShared = binds[0].pTexObj;
+	CHECK(pShared->refCount == 3);
+
+	//Every user but the last drops its own reference, the last one frees the object itself
+	CHECK(shareMap.release(0x30, pShared));
+	CHECK(pShared->refCount == 2);
+	CHECK(shareMap.release(0x30, pShared));
+	CHECK(!shareMap.is_shared(0x30, pShared));
+	CHECK(!shareMap.release(0x30, pShared));
+	CHECK(pShared->refCount == 1);
+	CHECK(shareMap.acquire(0x30) == 0);
+
+	//Objects that were never published are left to the caller
+	tex_obj_t other(1);
+	CHECK(!shareMap.release(0x30, &other));
+	CHECK(other.refCount == 1);
+	free_all(owned);
+}
+
+int main() {
+	RUN_TEST(test_share);
+	RUN_TEST(test_change_shared);
+	RUN_TEST(test_release);
+	return TEST_EXIT_CODE();
+}